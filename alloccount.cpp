@@ -0,0 +1,83 @@
+// Replacement operator new and delete that count every allocation in
+// allocationCounters (see memstats.h). Link this file into a program to
+// count its allocations; it must not be part of a library, or every
+// program using the library would pay for counting.
+//
+// Sizes are the allocator's usable size of each block, so frees can be
+// counted without storing a header; where that is unknown, bytes freed
+// are not counted.
+
+#include <cstdlib>
+#include <new>
+
+#include "memstats.h"
+
+#if defined(__GLIBC__)
+#include <malloc.h>
+#define LMS_USABLE_SIZE(p) malloc_usable_size(p)
+#elif defined(_WIN32)
+#include <malloc.h>
+#define LMS_USABLE_SIZE(p) _msize(p)
+#elif defined(__APPLE__)
+#include <malloc/malloc.h>
+#define LMS_USABLE_SIZE(p) malloc_size(p)
+#endif
+
+namespace {
+
+const bool linked = (allocationCounters.linked.store(true), true);
+
+void* allocate(std::size_t size)
+{
+    void* p;
+    while ((p = std::malloc(size ? size : 1)) == nullptr) {
+        std::new_handler handler = std::get_new_handler();
+        if (!handler)
+            throw std::bad_alloc();
+        handler();
+    }
+    if (allocationCounters.on.load(std::memory_order_relaxed)) {
+        allocationCounters.allocations.fetch_add(1, std::memory_order_relaxed);
+#ifdef LMS_USABLE_SIZE
+        size = LMS_USABLE_SIZE(p);
+#endif
+        allocationCounters.bytesAllocated.fetch_add(size, std::memory_order_relaxed);
+    }
+    return p;
+}
+
+void release(void* p)
+{
+    if (!p)
+        return;
+    if (allocationCounters.on.load(std::memory_order_relaxed)) {
+        allocationCounters.frees.fetch_add(1, std::memory_order_relaxed);
+#ifdef LMS_USABLE_SIZE
+        allocationCounters.bytesFreed.fetch_add(LMS_USABLE_SIZE(p), std::memory_order_relaxed);
+#endif
+    }
+    std::free(p);
+}
+
+} // namespace
+
+void* operator new(std::size_t size) { return allocate(size); }
+void* operator new[](std::size_t size) { return allocate(size); }
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+    try {
+        return allocate(size);
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t& tag) noexcept { return operator new(size, tag); }
+
+void operator delete(void* p) noexcept { release(p); }
+void operator delete[](void* p) noexcept { release(p); }
+void operator delete(void* p, std::size_t) noexcept { release(p); }
+void operator delete[](void* p, std::size_t) noexcept { release(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { release(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { release(p); }
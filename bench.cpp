@@ -0,0 +1,523 @@
+// Micro-benchmarks for the catalog hot paths.
+//
+// Usage: sem_project_focp_bench [bench...] [--sizes N,N,...] [--min-time S]
+//                               [--baseline FILE [--tolerance X]]
+//
+// Every benchmark runs once per catalog size (default 10000,100000,1000000)
+// and is repeated until it has run for at least --min-time seconds (default
+// 0.2). Results go to stdout, one JSON object per line:
+//
+//   {"bench":"countByGenre/columns","n":100000,"iterations":5321,"nsPerOp":37512.4,
+//    "allocsPerOp":0,"bytesPerOp":0}
+//
+// The allocation figures come from one extra run with every operator new
+// counted (alloccount.cpp); the timed runs count nothing.
+//
+// except memory/catalog, which reports the heap held per book instead. The
+// first line describes the build and machine ({"context":{...}}), so two
+// result files can be told apart and diffed line by line.
+//
+// A name of the form "group/variant" runs a single benchmark; "group" runs
+// every variant in it. With no names, everything runs.
+//
+// With --baseline, each result is also checked against the line for the
+// same benchmark and size in FILE, which is this program's own output from
+// an earlier run (bench_baseline.jsonl; refresh it by running the same
+// command without --baseline and saving stdout). A benchmark fails when its
+// nsPerOp exceeds the baseline's by more than the tolerance (a fraction:
+// 1.0 allows twice as slow; --tolerance, default 1.0, or a "tolerance"
+// member on the baseline line), or when it allocates more than 10% (plus
+// two) above the baseline, since allocation counts hardly vary between runs
+// or machines. Any failure makes the exit status 1; a build without NDEBUG
+// skips the check with status 77 (CTest's SKIP_RETURN_CODE), as the
+// baselines are for optimized builds.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "catalog.h"
+#include "catalog_gen.h"
+#include "database.h"
+#include "library.h"
+#include "memstats.h"
+#include "protocol.h"
+
+
+namespace {
+
+struct Options {
+    std::vector<size_t> sizes = {10000, 100000, 1000000};
+    double minTime = 0.2;
+    std::string baselinePath;
+    double tolerance = 1.0;
+};
+
+// The catalog every benchmark at size n runs against (see catalog_gen.h):
+// n books, a third of them on loan, and n members so member search scales too
+CatalogSpec benchSpec(size_t n)
+{
+    CatalogSpec spec;
+    spec.books = n;
+    spec.members = n;
+    return spec;
+}
+
+// Heap cost of holding n books in a Catalog, text included
+void reportCatalogBytes(size_t n)
+{
+    size_t before = heapTotals().inUse;
+    std::size_t perBook = 0;
+    {
+        CatalogSpec spec = benchSpec(n);
+        spec.members = 0;
+        Catalog catalog;
+        catalog.books.assign(generateCatalog(spec).books);
+        catalog.seal();
+        perBook = (heapTotals().inUse - before) / n;
+    }
+    std::cout << "{\"bench\":\"memory/catalog\",\"n\":" << n
+              << ",\"bytesPerBook\":" << perBook
+              << ",\"sizeofBook\":" << sizeof(book) << "}" << std::endl;
+}
+
+// Keeps results observable so the measured work is not optimized away
+volatile size_t sink;
+
+struct Benchmark {
+    std::string name;
+    std::function<size_t()> run;    // one operation; returns something to sink
+    size_t rows = 0;                // rows one operation processes, for rowsPerSec
+    long maxIterations = 0;         // cap for operations with lasting side effects
+};
+
+// What one benchmark measured at one size
+struct Result {
+    double nsPerOp = 0;
+    double allocsPerOp = 0;
+    double tolerance = -1;      // baseline lines only: overrides --tolerance
+};
+
+void report(const Benchmark& b, size_t n, long iterations, double seconds, const AllocationCounts& perOp)
+{
+    std::ostringstream line;
+    line << "{\"bench\":\"" << b.name << "\",\"n\":" << n
+         << ",\"iterations\":" << iterations
+         << ",\"nsPerOp\":" << seconds * 1e9 / static_cast<double>(iterations);
+    if (b.rows)
+        line << ",\"rowsPerSec\":" << static_cast<double>(b.rows) * static_cast<double>(iterations) / seconds;
+    line << ",\"allocsPerOp\":" << perOp.allocations << ",\"bytesPerOp\":" << perOp.bytesAllocated << "}";
+    std::cout << line.str() << std::endl;
+}
+
+Result measure(const Benchmark& b, size_t n, const Options& opt)
+{
+    using clock = std::chrono::steady_clock;
+    sink = b.run();     // warm caches before timing
+
+    // One more run with allocation counting on; off while timing
+    AllocationCounts before = allocationCounts();
+    allocationCounters.on.store(true);
+    sink = b.run();
+    allocationCounters.on.store(false);
+    AllocationCounts after = allocationCounts();
+    AllocationCounts perOp;
+    perOp.allocations = after.allocations - before.allocations;
+    perOp.bytesAllocated = after.bytesAllocated - before.bytesAllocated;
+
+    long iterations = 0;
+    double elapsed = 0;
+    auto start = clock::now();
+    do {
+        sink = b.run();
+        ++iterations;
+        elapsed = std::chrono::duration<double>(clock::now() - start).count();
+    } while (elapsed < opt.minTime && (b.maxIterations == 0 || iterations < b.maxIterations));
+    report(b, n, iterations, elapsed, perOp);
+
+    Result r;
+    r.nsPerOp = elapsed * 1e9 / static_cast<double>(iterations);
+    r.allocsPerOp = static_cast<double>(perOp.allocations);
+    return r;
+}
+
+// Baseline results by benchmark name and size
+using Baselines = std::map<std::pair<std::string, size_t>, Result>;
+
+// The number after "key": on a line of bench output; `fallback` if absent
+double numberField(const std::string& line, const char* key, double fallback)
+{
+    std::string quoted = std::string("\"") + key + "\":";
+    size_t at = line.find(quoted);
+    if (at == std::string::npos)
+        return fallback;
+    return std::strtod(line.c_str() + at + quoted.size(), nullptr);
+}
+
+bool loadBaselines(const std::string& path, Baselines& out)
+{
+    std::ifstream file(path);
+    if (!file) {
+        std::cerr << "Cannot read baselines from " << path << std::endl;
+        return false;
+    }
+    std::string line;
+    while (std::getline(file, line)) {
+        std::string name = SimpleParser(line).getString("bench");
+        if (name.empty() || line.find("\"nsPerOp\":") == std::string::npos)
+            continue;   // the context line, memory/catalog
+        Result r;
+        r.nsPerOp = numberField(line, "nsPerOp", 0);
+        r.allocsPerOp = numberField(line, "allocsPerOp", 0);
+        r.tolerance = numberField(line, "tolerance", -1);
+        out[{name, static_cast<size_t>(numberField(line, "n", 0))}] = r;
+    }
+    return true;
+}
+
+// False, with the reason on stderr, if `r` regressed past the baseline
+bool withinBaseline(const std::string& name, size_t n, const Result& r, const Baselines& baselines,
+                    const Options& opt)
+{
+    auto it = baselines.find({name, n});
+    if (it == baselines.end()) {
+        std::cerr << "No baseline for " << name << " at n=" << n << std::endl;
+        return true;
+    }
+    const Result& base = it->second;
+    double tolerance = base.tolerance >= 0 ? base.tolerance : opt.tolerance;
+    bool ok = true;
+    if (r.nsPerOp > base.nsPerOp * (1 + tolerance)) {
+        std::fprintf(stderr, "REGRESSION %s n=%zu: %.0f ns/op against a baseline of %.0f (%+.0f%%, tolerance %.0f%%)\n",
+                     name.c_str(), n, r.nsPerOp, base.nsPerOp, (r.nsPerOp / base.nsPerOp - 1) * 100, tolerance * 100);
+        ok = false;
+    }
+    if (r.allocsPerOp > base.allocsPerOp * 1.1 + 2) {
+        std::fprintf(stderr, "REGRESSION %s n=%zu: %.0f allocations/op against a baseline of %.0f\n",
+                     name.c_str(), n, r.allocsPerOp, base.allocsPerOp);
+        ok = false;
+    }
+    return ok;
+}
+
+bool selected(const std::vector<std::string>& names, const std::string& bench)
+{
+    if (names.empty()) return true;
+    for (const auto& name : names) {
+        if (bench == name || bench.compare(0, name.size() + 1, name + "/") == 0)
+            return true;
+    }
+    return false;
+}
+
+// Scans over the hot fields: the plain row vector (what the catalog held
+// before it grew a column store) against the Catalog's columns
+std::vector<Benchmark> columnBenchmarks(const std::vector<book>& rows, const Catalog& catalog)
+{
+    return {
+        {"countByGenre/rows", [&] {
+            size_t count = 0;
+            for (const auto& b : rows)
+                if (b.getGenre() == Genre::mystery) ++count;
+            return count;
+        }},
+        {"countByGenre/columns", [&] {
+            return static_cast<size_t>(catalog.countBooksByGenre(Genre::mystery));
+        }},
+        {"countAvailable/rows", [&] {
+            size_t count = 0;
+            for (const auto& b : rows)
+                if (!b.getBorrowStatus()) ++count;
+            return count;
+        }},
+        {"countAvailable/columns", [&] {
+            return static_cast<size_t>(catalog.countAvailableBooks());
+        }},
+        {"filterAvailableByGenre/rows", [&] {
+            std::vector<const book*> results;
+            for (const auto& b : rows)
+                if (b.getGenre() == Genre::science && !b.getBorrowStatus())
+                    results.push_back(&b);
+            return results.size();
+        }},
+        {"filterAvailableByGenre/columns", [&] {
+            return catalog.filterBooks(Genre::science, true).size();
+        }},
+    };
+}
+
+// Text scans: case-insensitive substring search over title, author, ISBN,
+// and over member names and addresses (searchMember by query); by ID is a lookup
+std::vector<Benchmark> searchBenchmarks(const Catalog& catalog)
+{
+    size_t members = catalog.members.size();
+    return {
+        {"searchBooks/title", [&] { return catalog.searchBooks("silent harbor").size(); }},
+        {"searchBooks/author", [&] { return catalog.searchBooks("farah b. tanaka").size(); }},
+        {"searchBooks/isbn", [&] { return catalog.searchBooks("978000000042").size(); }},
+        {"searchMember/name", [&] { return catalog.searchMembers("farah novak").size(); }},
+        {"searchMember/address", [&] { return catalog.searchMembers("harbor street").size(); }},
+        {"searchMember/id", [&catalog, members, next = 0u]() mutable {
+            next = next * 1103515245u + 12345u;
+            return catalog.findMember(static_cast<int>(next % members + 1)) ? size_t(1) : size_t(0);
+        }},
+    };
+}
+
+// The request loop's side of the protocol: listBooks encoded as cli.cpp
+// sends it, and SimpleParser reading one request line per record
+std::vector<Benchmark> protocolBenchmarks(const Catalog& catalog, const std::string& requests, size_t lines)
+{
+    return {
+        {"listBooks/json", [&catalog] {
+            JsonEncoder enc;
+            enc.beginObject(3);
+            enc.key("id");      enc.value(1);
+            enc.key("success"); enc.value(true);
+            enc.key("data");
+            beginBookTable(enc, catalog.books.size());
+            for (const auto& b : catalog.books)
+                writeBook(enc, b);
+            enc.endTable();
+            enc.endObject();
+            return enc.out.size();
+        }, catalog.books.size()},
+        {"simpleParser/requests", [&requests] {
+            size_t offset = 0, sum = 0;
+            std::string line;
+            while (nextRequest(requests, offset, WireMode::json, line)) {
+                SimpleParser parser(line);
+                sum += parser.getString("method").size();
+                sum += static_cast<size_t>(parser.getInt("id") + parser.getInt("bookID") + parser.getInt("memberID"));
+            }
+            return sum;
+        }, lines},
+    };
+}
+
+// One request line per record, the way the Electron client writes them
+std::string makeRequests(size_t n)
+{
+    std::string out;
+    for (size_t i = 0; i < n; ++i) {
+        int id = static_cast<int>(i + 1);
+        if (i % 4 == 3)
+            out += "{\"id\":" + std::to_string(id) + ",\"method\":\"searchBooks\",\"query\":\"harbor " + std::to_string(i) + "\"}\n";
+        else
+            out += "{\"id\":" + std::to_string(id) + ",\"method\":\"checkoutBook\",\"bookID\":" + std::to_string(i % 50000 + 1) +
+                   ",\"memberID\":" + std::to_string(i % 5000 + 1) + "}\n";
+    }
+    return out;
+}
+
+// Circulation: one operation checks a book out and returns it again, each
+// step persisted as the server does (synchronously, or with write-behind)
+std::vector<Benchmark> circulationBenchmarks(library& sync, library& behind)
+{
+    auto pair = [](library& lib) {
+        auto snap = lib.snapshot();
+        std::vector<int> shelf;
+        for (const auto& b : snap->books)
+            if (!b.getBorrowStatus()) shelf.push_back(b.getID());
+        int members = static_cast<int>(snap->members.size());
+        size_t next = 0;
+        return [&lib, shelf, members, next]() mutable {
+            int bookID = shelf[next % shelf.size()];
+            int memberID = static_cast<int>(next % static_cast<size_t>(members)) + 1;
+            ++next;
+            return static_cast<size_t>(lib.checkOutBook(bookID, memberID)) +
+                   static_cast<size_t>(lib.returnBook(bookID, memberID));
+        };
+    };
+    return {
+        {"checkoutReturn/sync", pair(sync)},
+        {"checkoutReturn/writeBehind", pair(behind)},
+    };
+}
+
+// Startup load: SELECT every row and build the records, as library::open does
+std::vector<Benchmark> loadBenchmarks(sqlite3* db, size_t books, size_t members)
+{
+    return {
+        {"load/books", [db] {
+            std::vector<book> rows;
+            loadBooks(db, rows);
+            return rows.size();
+        }, books},
+        {"load/members", [db] {
+            std::vector<member> rows;
+            loadMembers(db, rows);
+            return rows.size();
+        }, members},
+    };
+}
+
+// A fresh database at `path` holding the generated catalog
+sqlite3* makeDatabase(const GeneratedCatalog& data, const std::string& path = ":memory:")
+{
+    sqlite3* db = nullptr;
+    std::remove(path.c_str());
+    openDatabase(db, path);
+    writeCatalog(db, data);
+    return db;
+}
+
+// Opening a library: SQLite load against mapping the snapshot file.
+// Each run keeps its text (the snapshot case its mapping) for the life of
+// the process, so the runs are capped.
+std::vector<Benchmark> startupBenchmarks(const std::string& dbPath, size_t books)
+{
+    return {
+        {"startup/database", [dbPath] {
+            // Hide the snapshot file so the library has to read SQLite
+            std::string snap = dbPath + ".snap";
+            std::rename(snap.c_str(), (snap + ".off").c_str());
+            size_t loaded = library(dbPath).snapshot()->books.size();
+            std::rename((snap + ".off").c_str(), snap.c_str());
+            return loaded;
+        }, books, 3},
+        {"startup/snapshot", [dbPath] {
+            library lib(dbPath);
+            return lib.snapshot()->books.size();
+        }, books, 10},
+    };
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    allocationCounters.on.store(false);     // see measure()
+    Options opt;
+    std::vector<std::string> names;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--sizes" && i + 1 < argc) {
+            opt.sizes.clear();
+            std::stringstream list(argv[++i]);
+            std::string item;
+            while (std::getline(list, item, ','))
+                opt.sizes.push_back(std::stoul(item));
+        }
+        else if (arg == "--min-time" && i + 1 < argc) opt.minTime = std::stod(argv[++i]);
+        else if (arg == "--baseline" && i + 1 < argc) opt.baselinePath = argv[++i];
+        else if (arg == "--tolerance" && i + 1 < argc) opt.tolerance = std::stod(argv[++i]);
+        else if (arg.rfind("--", 0) == 0) {
+            std::cerr << "Unknown argument: " << arg << std::endl;
+            return 2;
+        }
+        else names.push_back(arg);
+    }
+
+    Baselines baselines;
+    if (!opt.baselinePath.empty()) {
+#ifndef NDEBUG
+        std::cerr << "Not an optimized build: skipping the baseline check" << std::endl;
+        return 77;
+#endif
+        if (!loadBaselines(opt.baselinePath, baselines))
+            return 2;
+    }
+    int regressions = 0;
+
+    std::cout << "{\"context\":{\"compiler\":\""
+#if defined(__clang__)
+              << "clang " << __clang_major__ << "." << __clang_minor__
+#elif defined(__GNUC__)
+              << "gcc " << __GNUC__ << "." << __GNUC_MINOR__
+#elif defined(_MSC_VER)
+              << "msvc " << _MSC_VER
+#endif
+              << "\",\"optimized\":"
+#ifdef NDEBUG
+              << "true"
+#else
+              << "false"
+#endif
+              << ",\"cpus\":" << std::thread::hardware_concurrency()
+              << ",\"minTime\":" << opt.minTime << "}}" << std::endl;
+
+    for (size_t n : opt.sizes) {
+        if (selected(names, "memory/catalog"))
+            reportCatalogBytes(n);
+
+        GeneratedCatalog data = generateCatalog(benchSpec(n));
+        const std::vector<book>& rows = data.books;
+        Catalog catalog;
+        catalog.books.assign(rows);
+        catalog.members.assign(data.members);
+        catalog.seal();
+        std::string requests = makeRequests(n);
+
+        std::vector<Benchmark> all = columnBenchmarks(rows, catalog);
+        for (auto& b : searchBenchmarks(catalog))
+            all.push_back(std::move(b));
+        for (auto& b : protocolBenchmarks(catalog, requests, n))
+            all.push_back(std::move(b));
+
+        sqlite3* db = nullptr;
+        if (selected(names, "load/books") || selected(names, "load/members")) {
+            db = makeDatabase(data);
+            for (auto& b : loadBenchmarks(db, rows.size(), data.members.size()))
+                all.push_back(std::move(b));
+        }
+
+        std::string startupPath;
+        if (selected(names, "startup/database") || selected(names, "startup/snapshot")) {
+            startupPath = "bench_startup_" + std::to_string(n) + ".db";
+            closeDatabase(makeDatabase(data, startupPath));
+            library(startupPath).saveSnapshot();    // for startup/snapshot
+            for (auto& b : startupBenchmarks(startupPath, rows.size()))
+                all.push_back(std::move(b));
+        }
+
+        // File databases, so every commit is a real one
+        std::vector<std::string> circulationPaths;
+        std::unique_ptr<library> syncLib, behindLib;
+        if (selected(names, "checkoutReturn/sync") || selected(names, "checkoutReturn/writeBehind")) {
+            for (const char* mode : {"sync", "behind"}) {
+                circulationPaths.push_back("bench_circulation_" + std::string(mode) + "_" + std::to_string(n) + ".db");
+                closeDatabase(makeDatabase(data, circulationPaths.back()));
+            }
+            syncLib.reset(new library(circulationPaths[0]));
+            behindLib.reset(new library(circulationPaths[1]));
+            behindLib->enableWriteBehind(WriteBehindOptions());
+            for (auto& b : circulationBenchmarks(*syncLib, *behindLib))
+                all.push_back(std::move(b));
+        }
+
+        for (const auto& b : all) {
+            if (!selected(names, b.name))
+                continue;
+            Result r = measure(b, n, opt);
+            if (!opt.baselinePath.empty() && !withinBaseline(b.name, n, r, baselines, opt))
+                ++regressions;
+        }
+        if (db)
+            closeDatabase(db);
+        syncLib.reset();
+        behindLib.reset();
+        for (const auto& path : circulationPaths)
+            for (const char* suffix : {"", ".loans", ".snap"})
+                std::remove((path + suffix).c_str());
+        if (!startupPath.empty())
+            for (const char* suffix : {"", ".loans", ".snap"})
+                std::remove((startupPath + suffix).c_str());
+    }
+    if (regressions) {
+        std::cerr << regressions << " benchmark(s) regressed past the baseline" << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -3,6 +3,7 @@
 
 #include "library.h"
 #include "member.h"
+#include "stringpool.h"
 
 int book::nextID=1000;
 
@@ -31,31 +32,58 @@ std::string book::genretoString(Genre genre)
     }
 }
 
-Genre book::stringtoGenre(std::string genreString)
+Genre book::stringtoGenre(std::string_view genreString)
 {
-    for (char &c : genreString) c = static_cast<char>(std::tolower(c));
+    // Case-insensitive, without copying the input
+    auto is = [genreString](std::string_view name) {
+        if (genreString.size() != name.size()) return false;
+        for (size_t i = 0; i < name.size(); ++i)
+            if (std::tolower(static_cast<unsigned char>(genreString[i])) != name[i]) return false;
+        return true;
+    };
 
-    if (genreString=="fiction") return Genre::fiction;
-    if (genreString=="nonfiction") return Genre::nonfiction;
-    if (genreString=="mystery") return Genre::mystery;
-    if (genreString=="adventure") return Genre::adventure;
-    if (genreString=="romance") return Genre::romance;
-    if (genreString=="science") return Genre::science;
-    if (genreString=="history") return Genre::history;
-    if (genreString=="fantasy") return Genre::fantasy;
+    if (is("fiction")) return Genre::fiction;
+    if (is("nonfiction")) return Genre::nonfiction;
+    if (is("mystery")) return Genre::mystery;
+    if (is("adventure")) return Genre::adventure;
+    if (is("romance")) return Genre::romance;
+    if (is("science")) return Genre::science;
+    if (is("history")) return Genre::history;
+    if (is("fantasy")) return Genre::fantasy;
     else
         return Genre::unknown;
 }
 
-book::book(const std::string& title, const std::string& ISBN, const std::string& author,
+book::book(std::string_view title, std::string_view ISBN, std::string_view author,
            Genre genre, int issuedTo)
-    : title(title), author(author), ISBN(ISBN),
-      genre(genre), // Convert string to enum
+    : title(StringPool::global().store(title)),
+      ISBN(StringPool::global().store(ISBN)),
+      author(StringPool::global().intern(author)),   // authors repeat across books
+      genre(genre),
       borrowStatus(false), issuedTo(issuedTo)
 {
     this->ID = book::nextID++;
 }
 
+book::book(int id, std::string_view title, std::string_view ISBN, std::string_view author,
+           Genre genre, std::string_view coverUrl, bool borrowStatus, int issuedTo)
+    : ID(id),
+      title(StringPool::global().store(title)),
+      ISBN(StringPool::global().store(ISBN)),
+      author(StringPool::global().intern(author)),
+      genre(genre),
+      cover_url(StringPool::global().store(coverUrl)),
+      borrowStatus(borrowStatus), issuedTo(issuedTo)
+{
+}
+
+book::book(PooledText, int id, std::string_view title, std::string_view ISBN, std::string_view author,
+           Genre genre, std::string_view coverUrl, bool borrowStatus, int issuedTo)
+    : ID(id), title(title), ISBN(ISBN), author(author), genre(genre), cover_url(coverUrl),
+      borrowStatus(borrowStatus), issuedTo(issuedTo)
+{
+}
+
 void book::setID(int id) {
     ID = id;
 }
@@ -63,15 +91,15 @@ int book::getID() const
 {
     return this -> ID;
 }
-std::string book::getTitle() const
+std::string_view book::getTitle() const
 {
     return this-> title;
 }
-std::string book::getAuthor() const
+std::string_view book::getAuthor() const
 {
     return this-> author;
 }
-std::string book::getISBN() const
+std::string_view book::getISBN() const
 {
     return this-> ISBN;
 }
@@ -80,14 +108,14 @@ Genre book::getGenre() const
     return this-> genre;
 }
 
-std::string book::getCoverUrl() const
+std::string_view book::getCoverUrl() const
 {
     return this->cover_url;
 }
 
-void book::setCoverUrl(const std::string& url)
+void book::setCoverUrl(std::string_view url)
 {
-    this->cover_url = url;
+    this->cover_url = StringPool::global().store(url);
 }
 
 bool book::getBorrowStatus() const
@@ -1,6 +1,9 @@
 #pragma once
 
 #include <string>
+#include <string_view>
+
+#include "stringpool.h"
 enum class Genre {
     fiction,
     nonfiction,
@@ -16,13 +19,14 @@ class book
 {
     private:
 
+    // Text lives in StringPool::global(); authors are interned
     int ID;
-    std::string title;
-    std::string ISBN;
-    std::string author;
+    std::string_view title;
+    std::string_view ISBN;
+    std::string_view author;
 
     Genre genre;
-    std::string cover_url;
+    std::string_view cover_url;
 
     bool borrowStatus;
     int issuedTo;
@@ -32,23 +36,29 @@ class book
 
     public:
     // Book Constructor
-    book (const std::string& title, const std::string& ISBN, const std::string& author, Genre genre, int issuedTo);
+    book (std::string_view title, std::string_view ISBN, std::string_view author, Genre genre, int issuedTo);
+    // Restores a stored book under its own ID (used by the bulk loader)
+    book (int id, std::string_view title, std::string_view ISBN, std::string_view author, Genre genre,
+          std::string_view coverUrl, bool borrowStatus, int issuedTo);
+    // As above, for text that is already pooled (e.g. a mapped snapshot file)
+    book (PooledText, int id, std::string_view title, std::string_view ISBN, std::string_view author,
+          Genre genre, std::string_view coverUrl, bool borrowStatus, int issuedTo);
     void setID(int id);
 
     // Data Fetchers:
     int getID() const;
-    std::string getTitle() const;
-    std::string getAuthor() const;
-    std::string getISBN() const;
+    std::string_view getTitle() const;
+    std::string_view getAuthor() const;
+    std::string_view getISBN() const;
     Genre getGenre() const;
-    std::string getCoverUrl() const;
+    std::string_view getCoverUrl() const;
     bool getBorrowStatus() const;
     int getIssuedTo() const;
 
     void modifyBorrowStatus(bool status);
     void setIssuedTo(int memberID);
-    void setCoverUrl(const std::string& url);
+    void setCoverUrl(std::string_view url);
 
-    static Genre stringtoGenre(std::string genreString);
+    static Genre stringtoGenre(std::string_view genreString);
     static std::string genretoString(Genre genre);
 };
@@ -0,0 +1,76 @@
+#include "bookstate.h"
+
+BookStateTable::BookStateTable()
+    : segments(new std::atomic<Segment*>[SEGMENTS]())
+{
+}
+
+BookStateTable::~BookStateTable()
+{
+    for (size_t i = 0; i < SEGMENTS; ++i)
+        delete segments[i].load(std::memory_order_relaxed);
+}
+
+std::atomic<uint64_t>& BookStateTable::word(int bookID)
+{
+    size_t id = static_cast<size_t>(bookID);
+    std::atomic<Segment*>& slot = segments[id >> SEGMENT_BITS];
+    Segment* seg = slot.load(std::memory_order_acquire);
+    if (!seg) {
+        // Racing threads may both allocate; one installs its segment
+        Segment* fresh = new Segment();
+        if (slot.compare_exchange_strong(seg, fresh, std::memory_order_acq_rel))
+            seg = fresh;
+        else
+            delete fresh;
+    }
+    return seg->words[id & (SEGMENT_SIZE - 1)];
+}
+
+bool BookStateTable::begin(int bookID, int from, int to)
+{
+    if (bookID <= 0)
+        return false;
+    uint64_t expected = static_cast<uint32_t>(from);
+    return word(bookID).compare_exchange_strong(expected, BUSY | static_cast<uint32_t>(to),
+                                                std::memory_order_acq_rel);
+}
+
+void BookStateTable::finish(int bookID, int holder)
+{
+    word(bookID).store(static_cast<uint32_t>(holder), std::memory_order_release);
+}
+
+void BookStateTable::reset(int bookID, int holder)
+{
+    if (bookID <= 0)
+        return;
+    std::atomic<uint64_t>& w = word(bookID);
+    uint64_t current = w.load(std::memory_order_relaxed);
+    while (!(current & BUSY) &&
+           !w.compare_exchange_weak(current, static_cast<uint32_t>(holder), std::memory_order_acq_rel)) {
+    }
+}
+
+int BookStateTable::holder(int bookID)
+{
+    if (bookID <= 0)
+        return 0;
+    uint64_t w = word(bookID).load(std::memory_order_acquire);
+    return (w & BUSY) ? 0 : static_cast<int>(static_cast<uint32_t>(w));
+}
+
+MemoryItem BookStateTable::memoryUsage() const
+{
+    MemoryItem m;
+    m.name = "bookStates";
+    m.reserved = SEGMENTS * sizeof(std::atomic<Segment*>);
+    for (size_t i = 0; i < SEGMENTS; ++i) {
+        if (segments[i].load(std::memory_order_acquire)) {
+            m.count += SEGMENT_SIZE;
+            m.reserved += sizeof(Segment);
+        }
+    }
+    m.used = m.reserved;
+    return m;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "memstats.h"
+
+// Who holds each book, one atomic word per book ID, shared by every
+// thread and every catalog version.
+//
+// Word layout: bits 0-31 the holder's member ID (0 = on the shelf), bit 32
+// set while a checkout or return of the book is being applied. Checkout
+// and return claim a book with one compare-and-swap from a settled state
+// to a busy one, so of two desks issuing the same copy exactly one wins,
+// and the other is turned away without waiting on anything. Books have
+// separate words, so transitions of different books never retry against
+// each other.
+//
+// The winner applies the transition to the catalog and then settles the
+// word (finish). The catalog stays the record; the table only decides
+// who may change a book next.
+class BookStateTable
+{
+    private:
+
+    static const uint64_t BUSY = uint64_t(1) << 32;
+    static const size_t SEGMENT_BITS = 16;     // 65536 books (512 KB) per segment
+    static const size_t SEGMENT_SIZE = size_t(1) << SEGMENT_BITS;
+    static const size_t SEGMENTS = (size_t(1) << 31) >> SEGMENT_BITS;
+
+    struct Segment {
+        std::atomic<uint64_t> words[SEGMENT_SIZE];
+    };
+
+    // Allocated on first use and never moved, so lookups need no lock
+    std::unique_ptr<std::atomic<Segment*>[]> segments;
+
+    std::atomic<uint64_t>& word(int bookID);
+
+    public:
+
+    BookStateTable();
+    ~BookStateTable();
+
+    BookStateTable(const BookStateTable&) = delete;
+    BookStateTable& operator=(const BookStateTable&) = delete;
+
+    // Claims the book if `from` holds it and nobody else is changing it,
+    // marking it busy with `to` as the holder. IDs must be positive.
+    bool begin(int bookID, int from, int to);
+
+    // Settles a book claimed with begin() on its holder per the catalog
+    void finish(int bookID, int holder);
+
+    // Sets the holder outside a transition (loading, deleting). A book that
+    // is busy is left to the thread applying its transition, which settles
+    // it from the catalog when done.
+    void reset(int bookID, int holder);
+
+    // Segments allocated so far and the directory; count is book IDs covered
+    MemoryItem memoryUsage() const;
+
+    // Current holder, 0 if on the shelf (or mid-checkout)
+    int holder(int bookID);
+};
@@ -0,0 +1,86 @@
+#include "capture.h"
+
+#include <iostream>
+#include <iterator>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// String fields never written to the file
+static const std::vector<std::string> MASKED = {"password", "token"};
+
+bool RequestCapture::open(const std::string& path)
+{
+#ifndef _WIN32
+    // Requests carry member details: readable by the owner only
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if (fd >= 0) {
+        ::fchmod(fd, 0600);
+        ::close(fd);
+    }
+#endif
+    out.open(path, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        std::cerr << "Cannot write the capture file " << path << std::endl;
+        return false;
+    }
+    start = std::chrono::steady_clock::now();
+    std::cerr << "Capturing requests to " << path << std::endl;
+    return true;
+}
+
+uint64_t RequestCapture::sessionNumber(const std::shared_ptr<Session>& session)
+{
+    Known& known = sessions[session.get()];
+    if (known.number != 0 && known.session.lock() == session)
+        return known.number;
+    known.session = session;
+    known.number = nextSession++;
+    uint64_t number = known.number;
+    // Forget closed connections now and then, or a server taking many
+    // short connections would keep one entry per connection ever made
+    if (number % 1024 == 0) {
+        for (auto it = sessions.begin(); it != sessions.end();)
+            it = it->second.session.expired() ? sessions.erase(it) : std::next(it);
+    }
+    return number;
+}
+
+void RequestCapture::record(const std::shared_ptr<Session>& session, WireMode mode, const std::string& request,
+                            const std::string& method, bool ok, std::chrono::steady_clock::time_point received)
+{
+    static const char HEX[] = "0123456789abcdef";
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!out)
+        return;
+
+    masked = request;
+    if (!maskFields(masked, mode, MASKED))
+        masked.clear();     // unreadable anyway; replayed as an empty request
+
+    auto t = std::chrono::duration_cast<std::chrono::microseconds>(received - start).count();
+    line.clear();
+    line += "{\"t\":";
+    line += std::to_string(t < 0 ? 0 : t);
+    line += ",\"session\":";
+    line += std::to_string(sessionNumber(session));
+    line += ",\"method\":\"";
+    JSON::escapeTo(line, method);
+    line += "\",\"ok\":";
+    line += ok ? "true" : "false";
+    if (mode == WireMode::binary) {
+        line += ",\"msgpack\":\"";
+        for (unsigned char c : masked) {
+            line += HEX[c >> 4];
+            line += HEX[c & 15];
+        }
+    } else {
+        line += ",\"request\":\"";
+        JSON::escapeTo(line, masked);
+    }
+    line += "\"}\n";
+    out.write(line.data(), static_cast<std::streamsize>(line.size()));
+}
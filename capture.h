@@ -0,0 +1,53 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "protocol.h"
+
+// Records incoming requests for replay (see replay.cpp), one JSON line each:
+//
+//   {"t":1234,"session":1,"method":"addBook","ok":true,"request":"{...}"}
+//
+// t is when the request was read, in microseconds since the capture
+// started; session numbers the client connection (stdio is a single
+// session); ok is whether the reply said success. A request read in binary
+// mode is stored as "msgpack":"<hex>" instead of "request". Passwords and
+// session tokens are overwritten with '*' (see maskFields), and the file is
+// created readable by its owner only.
+//
+// Lines are written as requests complete, so with workers they are not
+// quite in t order; the file is complete once the backend exits.
+class RequestCapture
+{
+    public:
+
+    // False (and a message on stderr) if `path` cannot be created
+    bool open(const std::string& path);
+
+    void record(const std::shared_ptr<Session>& session, WireMode mode, const std::string& request,
+                const std::string& method, bool ok, std::chrono::steady_clock::time_point received);
+
+    private:
+
+    struct Known {
+        std::weak_ptr<Session> session;
+        uint64_t number;
+    };
+
+    std::mutex mutex;
+    std::ofstream out;
+    std::chrono::steady_clock::time_point start;
+    // Keyed by address; the weak pointer tells a new session at a reused one
+    std::unordered_map<const Session*, Known> sessions;
+    uint64_t nextSession = 1;
+    std::string line;
+    std::string masked;
+
+    uint64_t sessionNumber(const std::shared_ptr<Session>& session);
+};
@@ -0,0 +1,190 @@
+#include "catalog.h"
+
+#include <bitset>
+#include <cctype>
+
+namespace {
+
+std::string lowered(std::string_view s)
+{
+    std::string result(s);
+    std::transform(result.begin(), result.end(), result.begin(),
+                   [](unsigned char c){ return std::tolower(c); });
+    return result;
+}
+
+// Index of the lowest set bit of a non-zero mask
+inline unsigned lowestBit(uint64_t v)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return static_cast<unsigned>(__builtin_ctzll(v));
+#else
+    unsigned bit = 0;
+    while (!(v & 1)) {
+        v >>= 1;
+        ++bit;
+    }
+    return bit;
+#endif
+}
+
+// ASCII lower case, matching std::tolower in the "C" locale we run in
+inline char foldCase(char c)
+{
+    return (c >= 'A' && c <= 'Z') ? static_cast<char>(c | 0x20) : c;
+}
+
+// Case-insensitive substring test; `lowerNeedle` is already lower case.
+// Compares in place so the scan allocates nothing per record.
+bool containsLowered(std::string_view haystack, const std::string& lowerNeedle)
+{
+    size_t n = lowerNeedle.size();
+    if (n == 0) return true;
+    if (haystack.size() < n) return false;
+
+    const char first = lowerNeedle[0];
+    for (size_t i = 0, last = haystack.size() - n; i <= last; ++i) {
+        if (foldCase(haystack[i]) != first) continue;
+        size_t j = 1;
+        while (j < n && foldCase(haystack[i + j]) == lowerNeedle[j]) ++j;
+        if (j == n) return true;
+    }
+    return false;
+}
+
+} // namespace
+
+void BookColumns::rebuild(const std::vector<book>& rows)
+{
+    size_t n = rows.size();
+    genre.resize(n);
+    issuedTo.resize(n);
+    available.assign((n + 63) / 64, 0);
+    for (size_t i = 0; i < n; ++i) {
+        genre[i] = static_cast<uint8_t>(rows[i].getGenre());
+        issuedTo[i] = rows[i].getIssuedTo();
+        if (!rows[i].getBorrowStatus())
+            available[i / 64] |= uint64_t(1) << (i % 64);
+    }
+}
+
+std::vector<const book*> Catalog::searchBooks(const std::string& query) const
+{
+    std::vector<const book*> results;
+    std::string lowerQuery = lowered(query);
+
+    for (const auto& b : books)
+    {
+        if (containsLowered(b.getTitle(), lowerQuery) ||
+            containsLowered(b.getAuthor(), lowerQuery) ||
+            containsLowered(b.getISBN(), lowerQuery))
+        {
+            results.push_back(&b);
+        }
+    }
+    return results;
+}
+
+std::vector<const member*> Catalog::searchMembers(const std::string& query) const
+{
+    std::vector<const member*> results;
+    std::string lowerQuery = lowered(query);
+
+    for (const auto& m : members)
+    {
+        if (containsLowered(m.getName(), lowerQuery) ||
+            containsLowered(m.getAddress(), lowerQuery))
+        {
+            results.push_back(&m);
+        }
+    }
+    return results;
+}
+
+std::vector<const book*> Catalog::loansOf(int memberID) const
+{
+    std::vector<const book*> results;
+    if (const member* m = findMember(memberID)) {
+        for (int bookID : m->getLoans())
+            if (const book* b = findBook(bookID))
+                results.push_back(b);
+    }
+    return results;
+}
+
+int Catalog::countBooksByGenre(Genre genre) const
+{
+    const uint8_t wanted = static_cast<uint8_t>(genre);
+    size_t count = 0;
+    books.forEachChunk([&](const std::vector<book>&, const BookColumns& cols) {
+        // Local accumulator: `count` could alias the uint8_t column, which
+        // would keep the compiler from vectorizing the loop
+        const uint8_t* g = cols.genre.data();
+        uint32_t matches = 0;
+        for (size_t i = 0; i < cols.genre.size(); ++i)
+            matches += g[i] == wanted;
+        count += matches;
+    });
+    return static_cast<int>(count);
+}
+
+int Catalog::countAvailableBooks() const
+{
+    size_t count = 0;
+    books.forEachChunk([&](const std::vector<book>&, const BookColumns& cols) {
+        for (uint64_t word : cols.available)
+            count += std::bitset<64>(word).count();
+    });
+    return static_cast<int>(count);
+}
+
+std::vector<const book*> Catalog::filterBooks(std::optional<Genre> genre, bool availableOnly) const
+{
+    std::vector<const book*> results;
+    const uint8_t wanted = genre ? static_cast<uint8_t>(*genre) : 0;
+    books.forEachChunk([&](const std::vector<book>& rows, const BookColumns& cols) {
+        // Filter 64 rows at a time into a bit mask, then visit the set bits
+        for (size_t base = 0; base < rows.size(); base += 64) {
+            size_t n = std::min<size_t>(64, rows.size() - base);
+            uint64_t mask = n == 64 ? ~uint64_t(0) : (uint64_t(1) << n) - 1;
+            if (availableOnly)
+                mask &= cols.available[base / 64];
+            if (genre) {
+                const uint8_t* g = cols.genre.data() + base;
+                uint64_t match = 0;
+                for (size_t i = 0; i < n; ++i)
+                    match |= uint64_t(g[i] == wanted) << i;
+                mask &= match;
+            }
+            for (; mask; mask &= mask - 1)
+                results.push_back(&rows[base + lowestBit(mask)]);
+        }
+    });
+    return results;
+}
+
+void Catalog::memoryUsage(std::vector<MemoryItem>& out) const
+{
+    out.push_back(books.memoryUsage("catalog.books"));
+
+    MemoryItem columns;
+    columns.name = "catalog.bookColumns";
+    columns.count = books.size();
+    books.forEachChunk([&](const std::vector<book>&, const BookColumns& cols) {
+        columns.used += cols.genre.size() + cols.issuedTo.size() * sizeof(int) + cols.available.size() * sizeof(uint64_t);
+        columns.reserved += cols.genre.capacity() + cols.issuedTo.capacity() * sizeof(int) +
+                            cols.available.capacity() * sizeof(uint64_t);
+    });
+    out.push_back(columns);
+
+    out.push_back(members.memoryUsage("catalog.members"));
+
+    MemoryItem loans;
+    loans.name = "catalog.memberLoans";
+    for (const member& m : members) {
+        loans.count += m.getLoans().size();
+        loans.used += m.getLoans().size() * sizeof(int);
+        loans.reserved += m.getLoans().capacity() * sizeof(int);
+    }
+    out.push_back(loans);
+}
@@ -0,0 +1,318 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "book.h"
+#include "member.h"
+#include "memstats.h"
+
+// Records per chunk of a ChunkedList. A write copies one chunk of this
+// size plus the chunk table, never the whole list.
+const size_t CATALOG_CHUNK_SIZE = 256;
+
+// Per-chunk column store for records that have none (see ChunkedList)
+struct NoColumns
+{
+    template <typename Rows>
+    void rebuild(const Rows&) {}
+};
+
+// Records kept sorted by getID() in fixed-size, copy-on-write chunks.
+//
+// Copying a ChunkedList copies only the table of chunk pointers; the chunks
+// themselves are shared until one copy edits them. A chunk referenced from
+// a single list is edited in place, so one write touches each chunk at most
+// once. Only the owning (writer) thread may copy or edit a list; lists that
+// have been published are never modified again.
+//
+// Each chunk also carries a Columns object derived from its rows (e.g.
+// BookColumns). Edits only mark the chunk stale; seal() rebuilds the
+// stale chunks' columns and must run before the list is published.
+template <typename T, typename Columns = NoColumns>
+class ChunkedList
+{
+    private:
+
+    struct Chunk {
+        std::vector<T> rows;
+        Columns columns;
+        bool stale = true;      // columns out of date with rows
+    };
+    std::vector<std::shared_ptr<Chunk>> chunks;     // none empty
+    size_t count = 0;
+    bool stale = false;         // some chunk needs seal()
+
+    // First chunk whose last ID is >= id (chunks.size() if none)
+    size_t chunkFor(int id) const
+    {
+        auto it = std::lower_bound(chunks.begin(), chunks.end(), id,
+            [](const std::shared_ptr<Chunk>& c, int key) { return c->rows.back().getID() < key; });
+        return static_cast<size_t>(it - chunks.begin());
+    }
+
+    static typename std::vector<T>::const_iterator findIn(const std::vector<T>& rows, int id)
+    {
+        return std::lower_bound(rows.begin(), rows.end(), id,
+            [](const T& item, int key) { return item.getID() < key; });
+    }
+
+    static std::shared_ptr<Chunk> newChunk()
+    {
+        auto c = std::make_shared<Chunk>();
+        c->rows.reserve(CATALOG_CHUNK_SIZE);
+        return c;
+    }
+
+    // Makes chunk i private to this list before its rows are modified
+    std::vector<T>& own(size_t i)
+    {
+        if (chunks[i].use_count() > 1)
+            chunks[i] = std::make_shared<Chunk>(*chunks[i]);
+        chunks[i]->stale = true;
+        stale = true;
+        return chunks[i]->rows;
+    }
+
+    public:
+
+    class const_iterator
+    {
+        const std::vector<std::shared_ptr<Chunk>>* chunks = nullptr;
+        size_t chunk = 0;
+        size_t pos = 0;
+
+        public:
+
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const T*;
+        using reference = const T&;
+
+        const_iterator() = default;
+        const_iterator(const std::vector<std::shared_ptr<Chunk>>* c, size_t chunkIndex)
+            : chunks(c), chunk(chunkIndex) {}
+
+        reference operator*() const { return (*chunks)[chunk]->rows[pos]; }
+        pointer operator->() const { return &**this; }
+
+        const_iterator& operator++()
+        {
+            if (++pos == (*chunks)[chunk]->rows.size()) {
+                ++chunk;
+                pos = 0;
+            }
+            return *this;
+        }
+        const_iterator operator++(int) { const_iterator old = *this; ++*this; return old; }
+
+        bool operator==(const const_iterator& o) const { return chunk == o.chunk && pos == o.pos; }
+        bool operator!=(const const_iterator& o) const { return !(*this == o); }
+    };
+
+    const_iterator begin() const { return const_iterator(&chunks, 0); }
+    const_iterator end() const { return const_iterator(&chunks, chunks.size()); }
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    size_t chunkCount() const { return chunks.size(); }
+
+    // The records and the chunk table (not what records point to, nor the
+    // columns). Chunks shared with other versions are counted here too.
+    MemoryItem memoryUsage(const char* name) const
+    {
+        MemoryItem m;
+        m.name = name;
+        m.count = count;
+        m.used = count * sizeof(T);
+        m.reserved = chunks.capacity() * sizeof(std::shared_ptr<Chunk>);
+        for (const auto& c : chunks)    // make_shared: control block and chunk together
+            m.reserved += c->rows.capacity() * sizeof(T) + sizeof(Chunk) + 2 * sizeof(void*);
+        return m;
+    }
+
+    // Calls f(rows, columns) for each chunk in ID order. Columns are only
+    // current on a sealed list.
+    template <typename F>
+    void forEachChunk(F f) const
+    {
+        for (const auto& c : chunks)
+            f(c->rows, c->columns);
+    }
+
+    const T* find(int id) const
+    {
+        size_t i = chunkFor(id);
+        if (i == chunks.size()) return nullptr;
+        auto it = findIn(chunks[i]->rows, id);
+        return (it != chunks[i]->rows.end() && it->getID() == id) ? &*it : nullptr;
+    }
+
+    // Mutable access to one record; copies its chunk if it is shared
+    T* edit(int id)
+    {
+        size_t i = chunkFor(id);
+        if (i == chunks.size()) return nullptr;
+        auto it = findIn(chunks[i]->rows, id);
+        if (it == chunks[i]->rows.end() || it->getID() != id) return nullptr;
+        size_t pos = static_cast<size_t>(it - chunks[i]->rows.begin());
+        return &own(i)[pos];
+    }
+
+    // Inserts in ID order; appending (the usual case) only touches the last chunk
+    void insert(const T& item)
+    {
+        if (chunks.empty()) {
+            chunks.push_back(newChunk());
+            chunks.back()->rows.push_back(item);
+            count = 1;
+            stale = true;
+            return;
+        }
+
+        size_t i = std::min(chunkFor(item.getID()), chunks.size() - 1);
+        if (i == chunks.size() - 1 && chunks[i]->rows.size() >= CATALOG_CHUNK_SIZE &&
+            item.getID() > chunks[i]->rows.back().getID()) {
+            chunks.push_back(newChunk());   // last chunk full: start a new one
+            ++i;
+        }
+
+        std::vector<T>& c = own(i);
+        c.insert(findIn(c, item.getID()), item);
+        ++count;
+
+        // Mid-list inserts can overfill a chunk; split it in half
+        if (c.size() > 2 * CATALOG_CHUNK_SIZE) {
+            auto tail = std::make_shared<Chunk>();
+            tail->rows.assign(c.begin() + CATALOG_CHUNK_SIZE, c.end());
+            c.erase(c.begin() + CATALOG_CHUNK_SIZE, c.end());
+            chunks.insert(chunks.begin() + static_cast<std::ptrdiff_t>(i + 1), tail);
+        }
+    }
+
+    // Bulk loading: builds a record after the current last one, whose ID
+    // it must exceed (returns false and adds nothing otherwise)
+    template <typename... Args>
+    bool emplaceBack(Args&&... args)
+    {
+        if (chunks.empty() || chunks.back()->rows.size() >= CATALOG_CHUNK_SIZE ||
+            chunks.back().use_count() > 1)
+            chunks.push_back(newChunk());
+        std::vector<T>& rows = chunks.back()->rows;
+        rows.emplace_back(std::forward<Args>(args)...);
+        bool ordered = (rows.size() > 1) ? rows[rows.size() - 2].getID() < rows.back().getID()
+                     : (chunks.size() < 2 || chunks[chunks.size() - 2]->rows.back().getID() < rows.back().getID());
+        if (!ordered) {
+            rows.pop_back();
+            if (rows.empty()) chunks.pop_back();
+            return false;
+        }
+        chunks.back()->stale = true;
+        stale = true;
+        ++count;
+        return true;
+    }
+
+    bool erase(int id)
+    {
+        size_t i = chunkFor(id);
+        if (i == chunks.size()) return false;
+        auto found = findIn(chunks[i]->rows, id);
+        if (found == chunks[i]->rows.end() || found->getID() != id) return false;
+        size_t pos = static_cast<size_t>(found - chunks[i]->rows.begin());
+
+        std::vector<T>& c = own(i);
+        c.erase(c.begin() + static_cast<std::ptrdiff_t>(pos));
+        --count;
+        if (c.empty())
+            chunks.erase(chunks.begin() + static_cast<std::ptrdiff_t>(i));
+        return true;
+    }
+
+    // Replaces the contents with `items` (sorted here if they are not already)
+    void assign(std::vector<T> items)
+    {
+        auto byId = [](const T& a, const T& b) { return a.getID() < b.getID(); };
+        if (!std::is_sorted(items.begin(), items.end(), byId))
+            std::stable_sort(items.begin(), items.end(), byId);
+
+        chunks.clear();
+        for (size_t first = 0; first < items.size(); first += CATALOG_CHUNK_SIZE) {
+            size_t last = std::min(first + CATALOG_CHUNK_SIZE, items.size());
+            auto c = std::make_shared<Chunk>();
+            c->rows.assign(std::make_move_iterator(items.begin() + static_cast<std::ptrdiff_t>(first)),
+                           std::make_move_iterator(items.begin() + static_cast<std::ptrdiff_t>(last)));
+            chunks.push_back(std::move(c));
+        }
+        count = items.size();
+        stale = true;
+    }
+
+    // Brings every edited chunk's columns up to date
+    void seal()
+    {
+        if (!stale) return;
+        for (auto& c : chunks) {
+            if (c->stale) {
+                c->columns.rebuild(c->rows);
+                c->stale = false;
+            }
+        }
+        stale = false;
+    }
+};
+
+// Hot book fields of one chunk, stored column-wise so that counts and
+// filters scan a few bytes per book instead of whole book objects.
+// Row i of each column belongs to row i of the chunk.
+struct BookColumns
+{
+    std::vector<uint8_t> genre;         // Genre values
+    std::vector<int> issuedTo;          // member ID, 0 if available
+    std::vector<uint64_t> available;    // bit i set: row i can be checked out
+
+    void rebuild(const std::vector<book>& rows);
+    bool isAvailable(size_t row) const { return (available[row / 64] >> (row % 64)) & 1u; }
+};
+
+// One immutable version of the in-memory catalog (see library::snapshot).
+// Everything reachable from a published Catalog stays valid and unchanged
+// for as long as the caller holds its shared_ptr.
+struct Catalog
+{
+    ChunkedList<book, BookColumns> books;   // sorted by ID
+    ChunkedList<member> members;            // sorted by ID
+    int version = 0;                        // library version this snapshot reflects
+
+    // Brings the column store up to date; library::publish calls it
+    void seal() { books.seal(); }
+
+    // Heap held by the records, the book columns and the members' loan lists
+    void memoryUsage(std::vector<MemoryItem>& out) const;
+
+    const book* findBook(int bookID) const { return books.find(bookID); }
+    const member* findMember(int memberID) const { return members.find(memberID); }
+
+    // Books the member currently holds, oldest loan first. Loans are indexed
+    // both ways: by book (book::getIssuedTo) and by member (member::getLoans).
+    std::vector<const book*> loansOf(int memberID) const;
+
+    // Case-insensitive substring match on title, author or ISBN
+    std::vector<const book*> searchBooks(const std::string& query) const;
+    // Case-insensitive substring match on name or address
+    std::vector<const member*> searchMembers(const std::string& query) const;
+
+    // Column scans; only valid on a sealed (e.g. published) catalog
+    int countBooksByGenre(Genre genre) const;
+    int countAvailableBooks() const;
+    // Books matching both filters, in ID order; an empty genre matches all
+    std::vector<const book*> filterBooks(std::optional<Genre> genre, bool availableOnly) const;
+};
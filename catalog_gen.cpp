@@ -0,0 +1,245 @@
+#include "catalog_gen.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <string>
+
+namespace {
+
+const char* const ADJECTIVES[] = {
+    "Silent", "Broken", "Golden", "Hidden", "Last", "Lost", "Burning", "Crimson",
+    "Distant", "Forgotten", "Frozen", "Gentle", "Hollow", "Invisible", "Little", "Midnight",
+    "Painted", "Quiet", "Restless", "Scarlet", "Secret", "Shattered", "Silver", "Small",
+    "Stolen", "Strange", "Sunken", "Tender", "Wandering", "Wild", "Winter", "Wicked",
+};
+const char* const NOUNS[] = {
+    "River", "Shadow", "Garden", "Empire", "Letters", "Journey", "Night", "Glass",
+    "Harbor", "Memory", "Crown", "Forest", "Storm", "House", "Daughter", "Island",
+    "Kingdom", "Light", "Map", "Mirror", "Mountain", "Ocean", "Orchard", "Promise",
+    "Queen", "Road", "Sea", "Sky", "Song", "Stars", "Station", "Summer",
+    "Sword", "Thief", "Tide", "Tower", "Valley", "Voyage", "War", "Widow",
+    "Wind", "Wolf", "Year", "Atlas", "Bridge", "Clockmaker", "Dragon", "Engine",
+};
+const char* const PLACES[] = {
+    "Paris", "the North", "Winter", "Venice", "the Dark", "Eden", "Avalon", "Babylon",
+    "the Valley", "Kyoto", "the Desert", "Lisbon", "the Moor", "Cairo", "the Sea", "Prague",
+};
+const char* const SUBJECTS[] = {
+    "Power", "Money", "Science", "Medicine", "Trade", "Faith", "Music", "Language",
+    "Empire", "Memory", "Maps", "Machines", "Cities", "Rivers", "War", "Peace",
+    "Food", "Time", "Light", "Numbers", "Revolution", "Exile", "Photography", "Salt",
+};
+const char* const FIRST_NAMES[] = {
+    "Amelia", "Bashir", "Chen", "Dolores", "Emeka", "Farah", "Gustav", "Hana",
+    "Ines", "Jonas", "Kavya", "Leon", "Mariam", "Nikolai", "Olivia", "Pedro",
+    "Quinn", "Rosa", "Samir", "Tomasz", "Ursula", "Viktor", "Wen", "Yara",
+    "Zoe", "Aiko", "Bruno", "Clara", "Diego", "Elena", "Felix", "Grace",
+};
+const char* const LAST_NAMES[] = {
+    "Okafor", "Lindqvist", "Haddad", "Moreau", "Tanaka", "Castellanos", "Novak", "Whitfield",
+    "Abara", "Bergstrom", "Chaudhry", "Delacroix", "Eriksen", "Fontaine", "Gallagher", "Hoffmann",
+    "Ivanova", "Jovanovic", "Kowalski", "Larsen", "Mendoza", "Nakamura", "O'Brien", "Petrov",
+    "Quintero", "Rossi", "Sato", "Thornton", "Ueda", "Vasquez", "Weber", "Yilmaz",
+    "Zhang", "Adeyemi", "Brennan", "Costa", "Dubois", "Esposito", "Fischer", "Gupta",
+};
+const char* const STREETS[] = {
+    "Oak", "Maple", "Harbor", "Mill", "Church", "Station", "Park", "Willow",
+    "High", "Bridge", "Orchard", "King", "Queen", "Elm", "Meadow", "River",
+};
+const char* const STREET_KINDS[] = {"Street", "Road", "Lane", "Avenue", "Close", "Way"};
+const char* const CITIES[] = {
+    "Springfield", "Riverton", "Lakeside", "Fairview", "Brookfield", "Ashford",
+    "Milltown", "Westbury", "Northgate", "Kingsport", "Oakridge", "Greenhaven",
+};
+
+template <typename T, size_t N>
+constexpr size_t count(const T (&)[N]) { return N; }
+
+// Uniform draws straight from the engine (see catalog_gen.h)
+struct Random {
+    std::mt19937 engine;
+    explicit Random(uint32_t seed) : engine(seed) {}
+
+    size_t below(size_t n) { return n ? static_cast<size_t>(engine()) % n : 0; }
+    double unit() { return (engine() >> 8) * (1.0 / 16777216.0); }     // [0, 1)
+    template <typename T, size_t N>
+    const char* pick(const T (&words)[N]) { return words[below(N)]; }
+};
+
+// Draws ranks 0..n-1 with P(r) proportional to 1 / (r + 1)^s
+class Zipf {
+    std::vector<double> cdf;
+public:
+    Zipf(size_t n, double s) : cdf(n) {
+        double sum = 0;
+        for (size_t r = 0; r < n; ++r)
+            cdf[r] = sum += 1.0 / std::pow(static_cast<double>(r + 1), s);
+        for (double& c : cdf)
+            c /= sum;
+    }
+    size_t operator()(Random& rng) const {
+        size_t r = static_cast<size_t>(std::upper_bound(cdf.begin(), cdf.end(), rng.unit()) - cdf.begin());
+        return std::min(r, cdf.size() - 1);
+    }
+};
+
+// Author number of each of n books. Books per author follow a power law
+// (P(k or more) ~ k^-1.5, at most 200): most authors have a book or two, a
+// few have a shelf of their own. Their books are scattered over the ID range.
+std::vector<uint32_t> assignAuthors(size_t n, Random& rng)
+{
+    std::vector<uint32_t> byBook;
+    byBook.reserve(n);
+    for (uint32_t a = 0; byBook.size() < n; ++a) {
+        double k = std::pow(1.0 - rng.unit(), -1.0 / 1.5);
+        size_t books = std::min<size_t>(std::min<size_t>(static_cast<size_t>(k), 200), n - byBook.size());
+        byBook.insert(byBook.end(), std::max<size_t>(books, 1), a);
+    }
+    for (size_t i = n; i > 1; --i)
+        std::swap(byBook[i - 1], byBook[rng.below(i)]);
+    return byBook;
+}
+
+// Most books one generated member holds at once (raised if the loan
+// fraction needs more)
+const size_t MEMBER_LOAN_LIMIT = 20;
+
+// Genres by share of the shelves, in percent
+const std::pair<Genre, int> GENRE_WEIGHTS[] = {
+    {Genre::fiction, 30}, {Genre::mystery, 14}, {Genre::romance, 13}, {Genre::fantasy, 12},
+    {Genre::nonfiction, 11}, {Genre::history, 8}, {Genre::science, 7}, {Genre::adventure, 5},
+};
+
+Genre pickGenre(Random& rng)
+{
+    int roll = static_cast<int>(rng.below(100));
+    for (const auto& g : GENRE_WEIGHTS) {
+        if (roll < g.second)
+            return g.first;
+        roll -= g.second;
+    }
+    return Genre::fiction;
+}
+
+std::string makeTitle(Random& rng, Genre genre)
+{
+    std::string title;
+    switch (rng.below(6)) {
+        case 0: title = std::string("The ") + rng.pick(ADJECTIVES) + " " + rng.pick(NOUNS); break;
+        case 1: title = std::string("The ") + rng.pick(NOUNS) + " of " + rng.pick(PLACES); break;
+        case 2: title = std::string(rng.pick(ADJECTIVES)) + " " + rng.pick(NOUNS); break;
+        case 3: title = std::string("A ") + rng.pick(NOUNS) + " in " + rng.pick(PLACES); break;
+        case 4: title = std::string(rng.pick(FIRST_NAMES)) + "'s " + rng.pick(NOUNS); break;
+        default: title = std::string("The ") + rng.pick(NOUNS) + " and the " + rng.pick(NOUNS); break;
+    }
+    // Non-fiction nearly always has a subtitle, novels now and then
+    bool factual = genre == Genre::nonfiction || genre == Genre::history || genre == Genre::science;
+    if (rng.below(10) < (factual ? 9u : 2u)) {
+        switch (rng.below(3)) {
+            case 0: title += std::string(": ") + rng.pick(SUBJECTS) + " and the " + rng.pick(NOUNS) + " of " + rng.pick(PLACES); break;
+            case 1: title += std::string(": A History of ") + rng.pick(SUBJECTS) + " in " + rng.pick(PLACES); break;
+            default: title += std::string(": ") + rng.pick(ADJECTIVES) + " " + rng.pick(SUBJECTS); break;
+        }
+    }
+    return title;
+}
+
+// Author number a: first and last names, then middle initials once those
+// run out (A., B., ..., A. A., ...), so every number has its own name
+std::string authorName(size_t a)
+{
+    const size_t firsts = count(FIRST_NAMES), lasts = count(LAST_NAMES);
+    std::string initials;
+    for (size_t k = a / (firsts * lasts); k; k /= 26) {
+        --k;
+        initials.insert(0, std::string(1, static_cast<char>('A' + k % 26)) + ". ");
+    }
+    return std::string(FIRST_NAMES[a % firsts]) + " " + initials + LAST_NAMES[(a / firsts) % lasts];
+}
+
+// 978, nine digits unique per n (7919 is prime to 10^9), then the check digit
+std::string makeISBN(size_t n, uint32_t seed)
+{
+    uint64_t body = (static_cast<uint64_t>(n) * 7919u + seed) % 1000000000u;
+    std::string digits = "978" + std::string(9 - std::to_string(body).size(), '0') + std::to_string(body);
+    int sum = 0;
+    for (size_t i = 0; i < 12; ++i)
+        sum += (digits[i] - '0') * (i % 2 ? 3 : 1);
+    return digits + static_cast<char>('0' + (10 - sum % 10) % 10);
+}
+
+} // namespace
+
+GeneratedCatalog generateCatalog(const CatalogSpec& spec)
+{
+    GeneratedCatalog out;
+    Random rng(spec.seed);
+
+    // Books
+    std::vector<uint32_t> authors = assignAuthors(spec.books, rng);
+    out.books.reserve(spec.books);
+    for (size_t i = 0; i < spec.books; ++i) {
+        Genre genre = pickGenre(rng);
+        std::string title = makeTitle(rng, genre);
+        book b(title, makeISBN(i, spec.seed), authorName(authors[i]), genre, 0);
+        b.setID(static_cast<int>(i + 1));
+        out.books.push_back(std::move(b));
+    }
+
+    // Members; addresses cluster in a dozen towns
+    std::vector<std::vector<int>> held(spec.members);
+    for (size_t i = 0; i < spec.members; ++i) {
+        std::string name = std::string(rng.pick(FIRST_NAMES)) + " " + rng.pick(LAST_NAMES);
+        std::string address = std::to_string(rng.below(400) + 1) + " " + rng.pick(STREETS) + " " +
+                              rng.pick(STREET_KINDS) + ", " + rng.pick(CITIES);
+        out.members.emplace_back(static_cast<int>(i + 1), name, address, 0);
+    }
+
+    // Loans: random books, borrowers drawn from a Zipf over a shuffled
+    // member order so the regulars are spread across the ID range. Like a
+    // real desk, nobody holds more than a limit; a full member's draw goes
+    // to the next reader in line.
+    double fraction = std::min(1.0, std::max(0.0, spec.loanFraction));
+    size_t onLoan = spec.members ? static_cast<size_t>(std::llround(fraction * static_cast<double>(spec.books))) : 0;
+    if (onLoan) {
+        std::vector<int> bookIDs(spec.books), readers(spec.members);
+        for (size_t i = 0; i < spec.books; ++i) bookIDs[i] = static_cast<int>(i + 1);
+        for (size_t i = 0; i < spec.members; ++i) readers[i] = static_cast<int>(i + 1);
+        for (size_t i = spec.members; i > 1; --i)
+            std::swap(readers[i - 1], readers[rng.below(i)]);
+        Zipf borrowers(spec.members, 0.9);
+        size_t limit = std::max<size_t>(MEMBER_LOAN_LIMIT, (onLoan + spec.members - 1) / spec.members);
+
+        out.loans.reserve(onLoan);
+        for (size_t i = 0; i < onLoan; ++i) {
+            std::swap(bookIDs[i], bookIDs[i + rng.below(spec.books - i)]);     // partial shuffle
+            int bookID = bookIDs[i];
+            size_t rank = borrowers(rng);
+            while (held[static_cast<size_t>(readers[rank] - 1)].size() >= limit)
+                rank = (rank + 1) % spec.members;
+            int memberID = readers[rank];
+            book& b = out.books[static_cast<size_t>(bookID - 1)];
+            b.modifyBorrowStatus(true);
+            b.setIssuedTo(memberID);
+            held[static_cast<size_t>(memberID - 1)].push_back(bookID);
+            out.loans.push_back(Loan{bookID, memberID});
+        }
+    }
+    for (size_t i = 0; i < spec.members; ++i) {
+        member& m = out.members[i];
+        m.setLoans(std::move(held[i]));
+    }
+    return out;
+}
+
+bool writeCatalog(sqlite3* db, const GeneratedCatalog& catalog, size_t batch)
+{
+    createBooksTable(db);
+    createMembersTable(db);
+    createLoansTable(db);
+    createUsersTable(db);
+    return insertBooks(db, catalog.books, batch) &&
+           insertMembers(db, catalog.members, batch) &&
+           insertLoans(db, catalog.loans, batch);
+}
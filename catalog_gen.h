@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "book.h"
+#include "member.h"
+#include "database.h"
+
+// Synthetic catalogs for load and performance testing.
+//
+// The same spec always yields the same records on every platform (the
+// generator draws from std::mt19937 only, never from the standard
+// distributions, whose output is implementation-defined).
+//
+// What it looks like:
+//  - titles from a handful of patterns over a few hundred words, so common
+//    words repeat the way they do on real shelves; non-fiction is subtitled;
+//  - a power law of books per author: a long tail with one or two books
+//    each, a few prolific authors with hundreds;
+//  - genres skewed towards fiction, mystery and romance;
+//  - valid, unique ISBN-13s;
+//  - loanFraction of the books on loan, borrowed mostly by a core of
+//    regular readers (Zipf, up to 20 books each), each loan recorded on
+//    both sides.
+
+struct CatalogSpec {
+    size_t books = 10000;
+    size_t members = 1000;
+    double loanFraction = 0.3;  // share of books out on loan (0..1)
+    uint32_t seed = 42;
+};
+
+struct GeneratedCatalog {
+    std::vector<book> books;        // IDs 1..books
+    std::vector<member> members;    // IDs 1..members
+    std::vector<Loan> loans;        // oldest first
+};
+
+GeneratedCatalog generateCatalog(const CatalogSpec& spec);
+
+// Writes the catalog into `db`, creating the tables if needed. The tables
+// should be empty. Bulk transactions of `batch` rows; false on error.
+bool writeCatalog(sqlite3* db, const GeneratedCatalog& catalog, size_t batch = 50000);
@@ -4,363 +4,1101 @@
 #include <cctype>
 #include <vector>
 #include <cstring>
+#include <memory>
+#include <functional>
+#include <algorithm>
+#include <mutex>
+#include <optional>
+#include <chrono>
+#include <cstdint>
+#include <cerrno>
+#include <cstdlib>
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#endif
 #include "library.h"
 #include "database.h"
+#include "protocol.h"
+#include "executor.h"
+#include "capture.h"
+#include "memstats.h"
+#include "metrics.h"
+#include "passwordhash.h"
+#include "sessiontokens.h"
+#include "sqlprofile.h"
+#include "server.h"
+#include "trace.h"
 
-// Minimal JSON builder (no external dependency)
-class JSON {
-public:
-    std::string data;
-    
-    JSON() : data("{}") {}
-    
-    static JSON object() { JSON j; j.data = "{}"; return j; }
-    static JSON array() { JSON j; j.data = "[]"; return j; }
-    
-    static std::string escape(const std::string& s) {
-        std::string result;
-        for (char c : s) {
-            switch (c) {
-                case '"': result += "\\\""; break;
-                case '\\': result += "\\\\"; break;
-                case '\n': result += "\\n"; break;
-                case '\r': result += "\\r"; break;
-                case '\t': result += "\\t"; break;
-                default: result += c;
-            }
-        }
-        return result;
-    }
-    
-    static std::string stringify(const std::string& key, const std::string& value) {
-        return "\"" + key + "\":\"" + escape(value) + "\"";
+// Global library instance
+library lib;
+
+// Executor for --workers (null: requests run inline)
+std::unique_ptr<RequestExecutor> executor;
+
+// Password hashing: login and register run on these threads (--auth-workers),
+// so a login's tens of milliseconds of scrypt never hold up the request loop
+// or a checkout waiting for the executor's writer
+std::unique_ptr<RequestExecutor> authExecutor;
+
+// The users table's connection. With authExecutor, one of its own: on the
+// main connection an auth statement could land inside another thread's
+// transaction, or replace the rowid addBook/addMember read back. Only
+// single statements run on it, which SQLite serializes by itself.
+sqlite3* authDb = nullptr;
+
+// Signed-in users, by the token login hands out
+SessionTokens sessions;
+int hashCost = DEFAULT_HASH_COST;   // --auth-cost
+bool requireAuth = false;           // --require-auth: see needsSignIn
+
+// Per-method latency and error counts (the "stats" method)
+RpcMetrics metrics;
+
+// Incoming requests, with --capture
+std::unique_ptr<RequestCapture> capture;
+
+// Where the trace goes, with --trace ("" without: tracing stays off)
+std::string tracePath;
+
+// Set when the request running on this thread answers with success false
+thread_local bool requestFailed = false;
+
+// Writes the "data" member of a response
+using DataWriter = std::function<void(Encoder&)>;
+
+// Emits one encoded reply in the session's current wire format
+void emitPayload(Session& session, const std::string& payload) {
+    std::string bytes;
+    bytes.reserve(payload.size() + 4);
+    if (session.mode == WireMode::binary) {
+        appendFrame(bytes, payload);
+    } else {
+        bytes = payload;
+        bytes += '\n';
     }
-    
-    static std::string stringify(const std::string& key, int value) {
-        return "\"" + key + "\":" + std::to_string(value);
+    TraceSpan span("cli", "send");
+    session.send(bytes);
+}
+
+// Simple response builder
+void sendResponse(Session& session, int id, bool success, const DataWriter& writeData) {
+    TraceSpan span("cli", "respond");
+    if (!success)
+        requestFailed = true;
+    JsonEncoder json;
+    MsgpackEncoder msgpack;
+    Encoder& enc = (session.mode == WireMode::binary) ? static_cast<Encoder&>(msgpack) : json;
+
+    enc.beginObject(3);
+    enc.key("id");      enc.value(id);
+    enc.key("success"); enc.value(success);
+    enc.key("data");    writeData(enc);
+    enc.endObject();
+    emitPayload(session, enc.out);
+}
+
+void sendMessage(Session& session, int id, const char* message) {
+    sendResponse(session, id, true, [&](Encoder& enc) {
+        enc.beginObject(1);
+        enc.key("message"); enc.value(message);
+        enc.endObject();
+    });
+}
+
+void sendError(Session& session, int id, const std::string& error) {
+    TraceSpan span("cli", "respond");
+    requestFailed = true;
+    JsonEncoder json;
+    MsgpackEncoder msgpack;
+    Encoder& enc = (session.mode == WireMode::binary) ? static_cast<Encoder&>(msgpack) : json;
+
+    enc.beginObject(3);
+    enc.key("id");      enc.value(id);
+    enc.key("success"); enc.value(false);
+    enc.key("error");   enc.value(error);
+    enc.endObject();
+    emitPayload(session, enc.out);
+}
+
+// Ids touched by book changes (or member changes), each listed once
+std::vector<int> changedIds(const std::vector<CatalogChange>& changes, bool bookChanges) {
+    std::vector<int> ids;
+    for (const auto& c : changes) {
+        bool isBook = c.kind == ChangeKind::bookAdded || c.kind == ChangeKind::bookDeleted ||
+                      c.kind == ChangeKind::bookStatus;
+        if (isBook == bookChanges)
+            ids.push_back(c.id);
     }
-    
-    static std::string stringify(const std::string& key, bool value) {
-        return "\"" + key + "\":" + (value ? "true" : "false");
+    std::sort(ids.begin(), ids.end());
+    ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+    return ids;
+}
+
+// Common envelope of listBooksSince / listMembersSince.
+// `full` tells the client to drop its cache and take `changed` as the whole list.
+void writeDelta(Encoder& enc, int version, bool full, const std::vector<int>& deleted,
+                const std::function<void(Encoder&)>& writeChanged) {
+    enc.beginObject(5);
+    enc.key("epoch");   enc.value(lib.getEpoch());
+    enc.key("version"); enc.value(version);
+    enc.key("full");    enc.value(full);
+    enc.key("changed"); writeChanged(enc);
+    enc.key("deleted");
+    enc.beginArray(deleted.size());
+    for (int d : deleted) enc.value(d);
+    enc.endArray();
+    enc.endObject();
+}
+
+// Rows per chunk when a list is streamed ("stream": true, optional "chunkSize")
+const size_t DEFAULT_STREAM_CHUNK = 500;
+const size_t MAX_STREAM_CHUNK = 10000;
+
+// Books one recommend request may ask for
+const int MAX_RECOMMENDATIONS = 50;
+
+// Requested chunk size, or 0 when the client wants a single response
+size_t streamChunkSize(const RequestParser& parser) {
+    if (!parser.getBool("stream", false))
+        return 0;
+    int requested = parser.getInt("chunkSize", static_cast<int>(DEFAULT_STREAM_CHUNK));
+    if (requested < 1) requested = 1;
+    return std::min(static_cast<size_t>(requested), MAX_STREAM_CHUNK);
+}
+
+// Sends `rows` as a run of chunk messages
+//   {"id":N,"chunk":k,"data":[...at most chunkSize rows...]}
+// closed by {"id":N,"success":true,"end":true,"chunks":K,"total":count}.
+// Each chunk is encoded and sent on its own. Unsent output stays bounded
+// however large the list is: stdout blocks, and with --listen the stream
+// waits once the client is a few megabytes behind (see server.cpp).
+template <typename Rows, typename BeginTable, typename WriteRow>
+void streamTable(Session& session, int id, const Rows& rows, size_t chunkSize,
+                 BeginTable beginTable, WriteRow writeRow) {
+    JsonEncoder json;
+    MsgpackEncoder msgpack;
+    Encoder& enc = (session.mode == WireMode::binary) ? static_cast<Encoder&>(msgpack) : json;
+
+    size_t count = rows.size();
+    int chunks = 0;
+    auto it = rows.begin();
+    for (size_t first = 0; first < count; first += chunkSize) {
+        size_t n = std::min(chunkSize, count - first);
+        enc.out.clear();
+        enc.beginObject(3);
+        enc.key("id");    enc.value(id);
+        enc.key("chunk"); enc.value(chunks++);
+        enc.key("data");
+        beginTable(enc, n);
+        for (size_t i = 0; i < n; ++i, ++it)
+            writeRow(enc, *it);
+        enc.endTable();
+        enc.endObject();
+        emitPayload(session, enc.out);
     }
-};
 
-// Simple response builder
-void sendResponse(int id, bool success, const std::string& content) {
-    std::cout << "{\"id\":" << id 
-              << ",\"success\":" << (success ? "true" : "false")
-              << ",\"data\":" << content << "}" << std::endl;
-    std::cout.flush();
+    enc.out.clear();
+    enc.beginObject(5);
+    enc.key("id");      enc.value(id);
+    enc.key("success"); enc.value(true);
+    enc.key("end");     enc.value(true);
+    enc.key("chunks");  enc.value(chunks);
+    enc.key("total");   enc.value(static_cast<int>(count));
+    enc.endObject();
+    emitPayload(session, enc.out);
 }
 
-void sendError(int id, const std::string& error) {
-    std::cout << "{\"id\":" << id 
-              << ",\"success\":false"
-              << ",\"error\":\"" << JSON::escape(error) << "\"}" << std::endl;
-    std::cout.flush();
+// Reads the next stdin request: one line in JSON mode, one frame in binary mode
+bool readRequest(const Session& session, std::string& request) {
+    if (session.mode == WireMode::binary)
+        return readFrame(std::cin, request);
+    return static_cast<bool>(std::getline(std::cin, request));
 }
 
-// Simple JSON parser (extracts basic fields)
-class SimpleParser {
-public:
-    std::string raw;
-    
-    SimpleParser(const std::string& input) : raw(input) {}
-    
-    int getInt(const std::string& key, int defaultVal = 0) {
-        std::string search = "\"" + key + "\":";
-        size_t pos = raw.find(search);
-        if (pos == std::string::npos) return defaultVal;
-        
-        size_t start = pos + search.length();
-        size_t end = raw.find_first_of(",}", start);
-        std::string numStr = raw.substr(start, end - start);
-        
-        try {
-            return std::stoi(numStr);
-        } catch (...) {
-            return defaultVal;
+// Methods that never modify the catalog; with --workers these run concurrently
+bool isReadOnly(const std::string& method) {
+    return method == "listBooks" || method == "listMembers" ||
+           method == "listBooksSince" || method == "listMembersSince" ||
+           method == "searchBooks" || method == "searchMember" ||
+           method == "memberLoans" || method == "recommend" || method == "countBooksByGenre" || method == "login" ||
+           method == "loanHistory" || method == "loansPerDay" || method == "stats" ||
+           method == "sqlStats" || method == "memoryStats" || method == "logout";
+}
+
+// Requests that run scrypt: register, and login with a password (not a token)
+bool hashesPassword(const std::string& method, const RequestParser& parser) {
+    return method == "register" || (method == "login" && !parser.getString("password", "").empty());
+}
+
+// Reads that show members' details or what they borrowed
+bool readsMemberData(const std::string& method) {
+    return method == "listMembers" || method == "listMembersSince" || method == "searchMember" ||
+           method == "memberLoans" || method == "loanHistory" || method == "recommend";
+}
+
+// With --require-auth, requests that change anything (statistics resets
+// included) or read member data need a signed-in user
+bool needsSignIn(const std::string& method, const RequestParser& parser) {
+    if (method == "stats" || method == "sqlStats")
+        return parser.getBool("reset", false);
+    return readsMemberData(method) || (!isReadOnly(method) && method != "register" && method != "setProtocol");
+}
+
+// Executes one request and sends its response
+void handleRequest(Session& session, const RequestParser& parser, int id, const std::string& method) {
+    if (requireAuth && needsSignIn(method, parser)) {
+        std::string user;
+        if (!sessions.check(parser.getString("token", ""), user)) {
+            sendError(session, id, "Not signed in");
+            return;
         }
     }
-    
-    std::string getString(const std::string& key, const std::string& defaultVal = "") {
-        std::string search = "\"" + key + "\":\"";
-        size_t pos = raw.find(search);
-        if (pos == std::string::npos) return defaultVal;
-        
-        size_t start = pos + search.length();
-        size_t end = raw.find("\"", start);
-        if (end == std::string::npos) return defaultVal;
-        
-        return raw.substr(start, end - start);
-    }
-};
 
-// Global library instance
-library lib;
+    if (method == "listBooks") {
+        auto snap = lib.snapshot();
 
-int main() {
-    std::string line;
-    std::ios::sync_with_stdio(false);
-    
-    while (std::getline(std::cin, line)) {
-        if (line.empty()) continue;
-        
-        try {
-            SimpleParser parser(line);
-            
-            int id = parser.getInt("id", 0);
-            std::string method = parser.getString("method", "");
-            
-            if (method == "listBooks") {
-                const auto& books = lib.getBooks();
-                std::stringstream ss;
-                ss << "[";
-                bool first = true;
-                for (const auto& b : books) {
-                    if (!first) ss << ",";
-                    ss << "{"
-                       << "\"id\":" << b.getID()
-                       << ",\"title\":\"" << JSON::escape(b.getTitle()) << "\""
-                       << ",\"author\":\"" << JSON::escape(b.getAuthor()) << "\""
-                       << ",\"isbn\":\"" << JSON::escape(b.getISBN()) << "\""
-                       << ",\"genre\":\"" << JSON::escape(book::genretoString(b.getGenre())) << "\""
-                       << ",\"coverUrl\":\"" << JSON::escape(b.getCoverUrl()) << "\""
-                       << ",\"borrowed\":" << (b.getBorrowStatus() ? "true" : "false")
-                       << ",\"issuedTo\":" << b.getIssuedTo()
-                       << "}";
-                    first = false;
-                }
-                ss << "]";
-                sendResponse(id, true, ss.str());
+        // Optional filters, answered from the catalog's column store
+        std::string genreStr = parser.getString("genre", "");
+        bool availableOnly = parser.getBool("available", false);
+        if (!genreStr.empty() || availableOnly) {
+            std::optional<Genre> genre;
+            if (!genreStr.empty()) genre = book::stringtoGenre(genreStr);
+            auto results = snap->filterBooks(genre, availableOnly);
+            if (size_t chunk = streamChunkSize(parser)) {
+                streamTable(session, id, results, chunk,
+                    [](Encoder& enc, size_t rows) { beginBookTable(enc, rows); },
+                    [](Encoder& enc, const book* b) { writeBook(enc, *b); });
+                return;
             }
-            else if (method == "listMembers") {
-                const auto& members = lib.getMembers();
-                std::stringstream ss;
-                ss << "[";
-                bool first = true;
-                for (const auto& m : members) {
-                    if (!first) ss << ",";
-                    ss << "{"
-                       << "\"id\":" << m.getID()
-                       << ",\"name\":\"" << JSON::escape(m.getName()) << "\""
-                       << ",\"address\":\"" << JSON::escape(m.getAddress()) << "\""
-                       << ",\"borrowedBookId\":" << m.getBorrowedBookID()
-                       << "}";
-                    first = false;
-                }
-                ss << "]";
-                sendResponse(id, true, ss.str());
-            }
-            else if (method == "addBook") {
-                std::string title = parser.getString("title", "");
-                std::string isbn = parser.getString("isbn", "");
-                std::string author = parser.getString("author", "");
-                std::string genre = parser.getString("genre", "");
-                std::string coverUrl = parser.getString("coverUrl", "");
-                
-                if (title.empty() || isbn.empty() || author.empty()) {
-                    sendError(id, "Missing required fields: title, isbn, author, genre");
-                    continue;
-                }
-                Genre g = book::stringtoGenre(genre); // converts std::string to Genre
+            sendResponse(session, id, true, [&](Encoder& enc) {
+                beginBookTable(enc, results.size());
+                for (const auto* b : results)
+                    writeBook(enc, *b);
+                enc.endTable();
+            });
+            return;
+        }
 
-                lib.addBook(title, isbn, author, g, coverUrl);
-                sendResponse(id, true, "{\"message\":\"Book added successfully\"}");
-            }
-            else if (method == "addMember") {
-                std::string name = parser.getString("name", "");
-                std::string address = parser.getString("address", "");
-                
-                if (name.empty() || address.empty()) {
-                    sendError(id, "Missing required fields: name, address");
-                    continue;
-                }
-                
-                lib.addMember(name, address);
-                sendResponse(id, true, "{\"message\":\"Member added successfully\"}");
+        const auto& books = snap->books;
+        if (size_t chunk = streamChunkSize(parser)) {
+            streamTable(session, id, books, chunk,
+                [](Encoder& enc, size_t rows) { beginBookTable(enc, rows); },
+                [](Encoder& enc, const book& b) { writeBook(enc, b); });
+            return;
+        }
+        sendResponse(session, id, true, [&](Encoder& enc) {
+            beginBookTable(enc, books.size());
+            for (const auto& b : books)
+                writeBook(enc, b);
+            enc.endTable();
+        });
+    }
+    else if (method == "listMembers") {
+        auto snap = lib.snapshot();
+        const auto& members = snap->members;
+        if (size_t chunk = streamChunkSize(parser)) {
+            streamTable(session, id, members, chunk,
+                [](Encoder& enc, size_t rows) { beginMemberTable(enc, rows); },
+                [](Encoder& enc, const member& m) { writeMember(enc, m); });
+            return;
+        }
+        sendResponse(session, id, true, [&](Encoder& enc) {
+            beginMemberTable(enc, members.size());
+            for (const auto& m : members)
+                writeMember(enc, m);
+            enc.endTable();
+        });
+    }
+    else if (method == "listBooksSince") {
+        // Delta sync: only books added, deleted or re-statused after `since`
+        int since = parser.getInt("since", -1);
+        int clientEpoch = parser.getInt("epoch", 0);
+
+        auto snap = lib.snapshot();
+        std::vector<CatalogChange> changes;
+        bool full = clientEpoch != lib.getEpoch() || since < 0 ||
+                    !lib.changesSince(since, snap->version, changes);
+
+        std::vector<const book*> changed;
+        std::vector<int> deleted;
+        if (!full) {
+            for (int bookID : changedIds(changes, true)) {
+                const book* b = snap->findBook(bookID);
+                if (b) changed.push_back(b);
+                else deleted.push_back(bookID);
             }
-            else if (method == "checkoutBook") {
-                int bookID = parser.getInt("bookID", 0);
-                int memberID = parser.getInt("memberID", 0);
-                
-                if (bookID == 0 || memberID == 0) {
-                    sendError(id, "Missing required fields: bookID, memberID");
-                    continue;
-                }
-                
-                bool success = lib.checkOutBook(bookID, memberID);
-                if (success) {
-                    sendResponse(id, true, "{\"message\":\"Book checked out successfully\"}");
+        }
+
+        sendResponse(session, id, true, [&](Encoder& enc) {
+            writeDelta(enc, snap->version, full, deleted, [&](Encoder& e) {
+                const auto& books = snap->books;
+                beginBookTable(e, full ? books.size() : changed.size());
+                if (full) {
+                    for (const auto& b : books) writeBook(e, b);
                 } else {
-                    sendError(id, "Failed to checkout book (already borrowed or not found)");
+                    for (const auto* b : changed) writeBook(e, *b);
                 }
+                e.endTable();
+            });
+        });
+    }
+    else if (method == "listMembersSince") {
+        int since = parser.getInt("since", -1);
+        int clientEpoch = parser.getInt("epoch", 0);
+
+        auto snap = lib.snapshot();
+        std::vector<CatalogChange> changes;
+        bool full = clientEpoch != lib.getEpoch() || since < 0 ||
+                    !lib.changesSince(since, snap->version, changes);
+
+        std::vector<const member*> changed;
+        std::vector<int> deleted;
+        if (!full) {
+            for (int memberID : changedIds(changes, false)) {
+                const member* m = snap->findMember(memberID);
+                if (m) changed.push_back(m);
+                else deleted.push_back(memberID);
             }
-            else if (method == "returnBook") {
-                int bookID = parser.getInt("bookID", 0);
-                int memberID = parser.getInt("memberID", 0);
-                
-                if (bookID == 0 || memberID == 0) {
-                    sendError(id, "Missing required fields: bookID, memberID");
-                    continue;
-                }
-                
-                bool success = lib.returnBook(bookID, memberID);
-                if (success) {
-                    sendResponse(id, true, "{\"message\":\"Book returned successfully\"}");
+        }
+
+        sendResponse(session, id, true, [&](Encoder& enc) {
+            writeDelta(enc, snap->version, full, deleted, [&](Encoder& e) {
+                const auto& members = snap->members;
+                beginMemberTable(e, full ? members.size() : changed.size());
+                if (full) {
+                    for (const auto& m : members) writeMember(e, m);
                 } else {
-                    sendError(id, "Failed to return book (not borrowed or not found)");
+                    for (const auto* m : changed) writeMember(e, *m);
                 }
+                e.endTable();
+            });
+        });
+    }
+    else if (method == "addBook") {
+        std::string title = parser.getString("title", "");
+        std::string isbn = parser.getString("isbn", "");
+        std::string author = parser.getString("author", "");
+        std::string genre = parser.getString("genre", "");
+        std::string coverUrl = parser.getString("coverUrl", "");
+        
+        if (title.empty() || isbn.empty() || author.empty()) {
+            sendError(session, id, "Missing required fields: title, isbn, author, genre");
+            return;
+        }
+        Genre g = book::stringtoGenre(genre); // converts std::string to Genre
+
+        lib.addBook(title, isbn, author, g, coverUrl);
+        sendMessage(session, id, "Book added successfully");
+    }
+    else if (method == "addMember") {
+        std::string name = parser.getString("name", "");
+        std::string address = parser.getString("address", "");
+        
+        if (name.empty() || address.empty()) {
+            sendError(session, id, "Missing required fields: name, address");
+            return;
+        }
+        
+        lib.addMember(name, address);
+        sendMessage(session, id, "Member added successfully");
+    }
+    else if (method == "checkoutBook") {
+        int bookID = parser.getInt("bookID", 0);
+        int memberID = parser.getInt("memberID", 0);
+        
+        if (bookID == 0 || memberID == 0) {
+            sendError(session, id, "Missing required fields: bookID, memberID");
+            return;
+        }
+        
+        bool success = lib.checkOutBook(bookID, memberID);
+        if (success) {
+            sendMessage(session, id, "Book checked out successfully");
+        } else {
+            sendError(session, id, "Failed to checkout book (already borrowed or not found)");
+        }
+    }
+    else if (method == "returnBook") {
+        int bookID = parser.getInt("bookID", 0);
+        int memberID = parser.getInt("memberID", 0);
+        
+        if (bookID == 0 || memberID == 0) {
+            sendError(session, id, "Missing required fields: bookID, memberID");
+            return;
+        }
+        
+        bool success = lib.returnBook(bookID, memberID);
+        if (success) {
+            sendMessage(session, id, "Book returned successfully");
+        } else {
+            sendError(session, id, "Failed to return book (not borrowed or not found)");
+        }
+    }
+    else if (method == "searchBooks") {
+        std::string query = parser.getString("query", "");
+        if (query.empty()) {
+            sendError(session, id, "Missing required field: query");
+            return;
+        }
+        
+        auto snap = lib.snapshot();
+        auto results = snap->searchBooks(query);
+        if (size_t chunk = streamChunkSize(parser)) {
+            streamTable(session, id, results, chunk,
+                [](Encoder& enc, size_t rows) { beginBookTable(enc, rows, false); },
+                [](Encoder& enc, const book* b) { writeBook(enc, *b, false); });
+            return;
+        }
+        sendResponse(session, id, true, [&](Encoder& enc) {
+            beginBookTable(enc, results.size(), false);
+            for (const auto* b : results)
+                writeBook(enc, *b, false);
+            enc.endTable();
+        });
+    }
+    else if (method == "searchMember") {
+        // Support searching by numeric ID (memberID) or by name (query)
+        int memberID = parser.getInt("memberID", 0);
+        std::string q = parser.getString("query", "");
+        auto snap = lib.snapshot();
+
+        if (memberID != 0) {
+            // Search by member ID
+            const member* m = snap->findMember(memberID);
+            if (m) {
+                sendResponse(session, id, true, [&](Encoder& enc) { writeMember(enc, *m); });
+            } else {
+                sendError(session, id, "Member not found");
             }
-            else if (method == "searchBooks") {
-                std::string query = parser.getString("query", "");
-                if (query.empty()) {
-                    sendError(id, "Missing required field: query");
-                    continue;
-                }
-                
-                auto results = lib.searchBook(query);
-                std::stringstream ss;
-                ss << "[";
-                bool first = true;
-                for (const auto* b : results) {
-                    if (!first) ss << ",";
-                    ss << "{"
-                       << "\"id\":" << b->getID()
-                       << ",\"title\":\"" << JSON::escape(b->getTitle()) << "\""
-                       << ",\"author\":\"" << JSON::escape(b->getAuthor()) << "\""
-                       << ",\"isbn\":\"" << JSON::escape(b->getISBN()) << "\""
-                       << ",\"genre\":\"" << JSON::escape(book::genretoString(b->getGenre())) << "\""
-                       << ",\"coverUrl\":\"" << JSON::escape(b->getCoverUrl()) << "\""
-                       << ",\"borrowed\":" << (b->getBorrowStatus() ? "true" : "false")
-                       << "}";
-                    first = false;
-                }
-                ss << "]";
-                sendResponse(id, true, ss.str());
+        } else if (!q.empty()) {
+            // search by name substring
+            auto results = snap->searchMembers(q);
+            if (size_t chunk = streamChunkSize(parser)) {
+                streamTable(session, id, results, chunk,
+                    [](Encoder& enc, size_t rows) { beginMemberTable(enc, rows); },
+                    [](Encoder& enc, const member* m) { writeMember(enc, *m); });
+                return;
             }
-            else if (method == "searchMember") {
-                // Support searching by numeric ID (memberID) or by name (query)
-                int memberID = parser.getInt("memberID", 0);
-                std::string q = parser.getString("query", "");
-
-                if (memberID != 0) {
-                    // Search by member ID - find in members list
-                    const auto& members = lib.getMembers();
-                    const member* m = nullptr;
-                    for (const auto& mem : members) {
-                        if (mem.getID() == memberID) {
-                            m = &mem;
-                            break;
-                        }
-                    }
-                    if (m) {
-                        std::stringstream ss;
-                        ss << "{"
-                           << "\"id\":" << m->getID()
-                           << ",\"name\":\"" << JSON::escape(m->getName()) << "\""
-                           << ",\"address\":\"" << JSON::escape(m->getAddress()) << "\""
-                           << ",\"borrowedBookId\":" << m->getBorrowedBookID()
-                           << "}";
-                        sendResponse(id, true, ss.str());
-                    } else {
-                        sendError(id, "Member not found");
-                    }
-                } else if (!q.empty()) {
-                    // search by name substring
-                    auto results = lib.searchMember(q);
-                    std::stringstream ss;
-                    ss << "[";
-                    bool first = true;
-                    for (const auto* m : results) {
-                        if (!first) ss << ",";
-                        ss << "{"
-                           << "\"id\":" << m->getID()
-                           << ",\"name\":\"" << JSON::escape(m->getName()) << "\""
-                           << ",\"address\":\"" << JSON::escape(m->getAddress()) << "\""
-                           << ",\"borrowedBookId\":" << m->getBorrowedBookID()
-                           << "}";
-                        first = false;
-                    }
-                    ss << "]";
-                    sendResponse(id, true, ss.str());
-                } else {
-                    sendError(id, "Missing required field: memberID or query");
-                }
+            sendResponse(session, id, true, [&](Encoder& enc) {
+                beginMemberTable(enc, results.size());
+                for (const auto* m : results)
+                    writeMember(enc, *m);
+                enc.endTable();
+            });
+        } else {
+            sendError(session, id, "Missing required field: memberID or query");
+        }
+    }
+    else if (method == "memberLoans") {
+        // Every book the member currently holds, oldest loan first
+        int memberID = parser.getInt("memberID", 0);
+        if (memberID == 0) {
+            sendError(session, id, "Missing required field: memberID");
+            return;
+        }
+
+        auto snap = lib.snapshot();
+        if (!snap->findMember(memberID)) {
+            sendError(session, id, "Member not found");
+            return;
+        }
+        auto held = snap->loansOf(memberID);
+        sendResponse(session, id, true, [&](Encoder& enc) {
+            beginBookTable(enc, held.size());
+            for (const auto* b : held)
+                writeBook(enc, *b);
+            enc.endTable();
+        });
+    }
+    else if (method == "recommend") {
+        // Books on the shelf for a member, best first, from the co-borrow and
+        // genre statistics; memberID 0 (or omitted) gets the most borrowed
+        int memberID = parser.getInt("memberID", 0);
+        int count = std::min(std::max(parser.getInt("count", 5), 1), MAX_RECOMMENDATIONS);
+
+        auto snap = lib.snapshot();
+        if (memberID != 0 && !snap->findMember(memberID)) {
+            sendError(session, id, "Member not found");
+            return;
+        }
+        auto picks = lib.getRecommender().recommend(*snap, memberID, static_cast<size_t>(count));
+        sendResponse(session, id, true, [&](Encoder& enc) {
+            beginBookTable(enc, picks.size());
+            for (const auto& p : picks)
+                writeBook(enc, *p.b);
+            enc.endTable();
+        });
+    }
+    else if (method == "loanHistory" || method == "loansPerDay") {
+        // Circulation reports from the loan history, never the live tables.
+        // Optional range [from, to) in seconds since 1970.
+        uint32_t from = static_cast<uint32_t>(std::max(0, parser.getInt("from", 0)));
+        uint32_t to = static_cast<uint32_t>(std::max(0, parser.getInt("to", INT32_MAX)));
+        const LoanLog& history = lib.getLoanLog();
+
+        if (method == "loansPerDay") {
+            auto days = history.perDay(from, to);
+            sendResponse(session, id, true, [&](Encoder& enc) {
+                enc.beginTable(days.size(), LOAN_DAY_FIELDS, 3);
+                for (const auto& d : days)
+                    writeLoanDay(enc, d);
+                enc.endTable();
+            });
+            return;
+        }
+
+        int memberID = parser.getInt("memberID", 0);
+        if (memberID == 0) {
+            sendError(session, id, "Missing required field: memberID");
+            return;
+        }
+        auto events = history.memberHistory(memberID, from, to);
+        sendResponse(session, id, true, [&](Encoder& enc) {
+            enc.beginTable(events.size(), LOAN_EVENT_FIELDS, 4);
+            for (const auto& e : events)
+                writeLoanEvent(enc, e);
+            enc.endTable();
+        });
+    }
+    else if (method == "delete-book") {
+        int bookID = parser.getInt("bookID", 0);
+        
+        if (bookID == 0) {
+            sendError(session, id, "Missing required field: bookID");
+            return;
+        }
+        
+        lib.deleteBook(bookID);
+        sendMessage(session, id, "Book deleted successfully");
+    }
+    else if (method == "delete-member") {
+        int memberID = parser.getInt("memberID", 0);
+        
+        if (memberID == 0) {
+            sendError(session, id, "Missing required field: memberID");
+            return;
+        }
+
+        lib.deleteMember(memberID);
+        sendMessage(session, id, "Member deleted successfully");
+    }
+    else if (method == "countBooksByGenre") {
+        std::string genreStr = parser.getString("genre", "");
+        Genre g = book::stringtoGenre(genreStr);
+        int count = lib.snapshot()->countBooksByGenre(g);
+        sendResponse(session, id, true, [&](Encoder& enc) {
+            enc.beginObject(1);
+            enc.key("count"); enc.value(count);
+            enc.endObject();
+        });
+    }
+    else if (method == "register") {
+        std::string username = parser.getString("username", "");
+        std::string password = parser.getString("password", "");
+        
+        if (username.empty() || password.empty()) {
+            sendError(session, id, "Username and password are required");
+            return;
+        }
+        
+        // Check if user already exists
+        if (userExists(authDb, username)) {
+            sendResponse(session, id, false, [&](Encoder& enc) {
+                enc.beginObject(1);
+                enc.key("error"); enc.value("Username already exists");
+                enc.endObject();
+            });
+        } else {
+            // Insert new user
+            if (insertUser(authDb, username, hashPassword(password, hashCost))) {
+                sendResponse(session, id, true, [&](Encoder& enc) {
+                    enc.beginObject(2);
+                    enc.key("success"); enc.value(true);
+                    enc.key("message"); enc.value("Account created successfully");
+                    enc.endObject();
+                });
+            } else {
+                sendError(session, id, "Failed to create account");
             }
-            else if (method == "delete-book") {
-                int bookID = parser.getInt("bookID", 0);
-                
-                if (bookID == 0) {
-                    sendError(id, "Missing required field: bookID");
-                    continue;
-                }
-                
-                lib.deleteBook(bookID);
-                sendResponse(id, true, "{\"message\":\"Book deleted successfully\"}");
+        }
+    }
+    else if (method == "login") {
+        std::string username = parser.getString("username", "");
+        std::string password = parser.getString("password", "");
+        std::string token = parser.getString("token", "");
+
+        // Resuming with the token of an earlier login: no password to hash
+        if (password.empty() && !token.empty()) {
+            if (!sessions.check(token, username)) {
+                sendError(session, id, "Session expired");
+                return;
             }
-            else if (method == "delete-member") {
-                int memberID = parser.getInt("memberID", 0);
-                
-                if (memberID == 0) {
-                    sendError(id, "Missing required field: memberID");
-                    continue;
-                }
+        }
+        else if (username.empty() || password.empty()) {
+            sendError(session, id, "Username and password are required");
+            return;
+        }
+        else {
+            // An unknown name is checked against a hash of nothing, so it
+            // takes as long to refuse as a wrong password
+            static const std::string noSuchUser = hashPassword(randomHex(16), hashCost);
+            std::string stored;
+            bool known = readPasswordHash(authDb, username, stored);
+            bool rehash = false;
+            bool valid = verifyPassword(password, known ? stored : noSuchUser, hashCost, rehash) && known;
+            if (!valid) {
+                sendResponse(session, id, false, [&](Encoder& enc) {
+                    enc.beginObject(1);
+                    enc.key("error"); enc.value("Invalid username or password");
+                    enc.endObject();
+                });
+                return;
+            }
+            // Stored in plaintext, or at another --auth-cost
+            if (rehash)
+                updatePasswordHash(authDb, username, hashPassword(password, hashCost));
+            token = sessions.issue(username);
+        }
 
-                lib.deleteMember(memberID);
-                sendResponse(id, true, "{\"message\":\"Member deleted successfully\"}");
+        sendResponse(session, id, true, [&](Encoder& enc) {
+            enc.beginObject(5);
+            enc.key("success");     enc.value(true);
+            enc.key("message");     enc.value("Login successful");
+            enc.key("username");    enc.value(username);
+            enc.key("token");       enc.value(token);
+            enc.key("idleSeconds"); enc.value(static_cast<int>(sessions.idleLimit().count()));
+            enc.endObject();
+        });
+    }
+    else if (method == "logout") {
+        sessions.revoke(parser.getString("token", ""));
+        sendMessage(session, id, "Signed out");
+    }
+    else if (method == "saveSnapshot") {
+        // Runs as a write so no other write is half done while it reads the catalog
+        if (lib.saveSnapshot())
+            sendMessage(session, id, "Snapshot saved");
+        else
+            sendError(session, id, "Snapshot not saved");
+    }
+    else if (method == "flush") {
+        // Durability barrier: answers once every earlier write is committed
+        lib.flushWrites();
+        WriteBehindQueue::Stats stats;
+        bool queued = lib.writeBehindStats(stats);
+        sendResponse(session, id, true, [&](Encoder& enc) {
+            enc.beginObject(queued ? 6 : 1);
+            enc.key("writeBehind"); enc.value(queued);
+            if (queued) {
+                enc.key("committed"); enc.value(stats.committed);
+                enc.key("batches");   enc.value(stats.batches);
+                enc.key("coalesced"); enc.value(stats.coalesced);
+                enc.key("throttled"); enc.value(stats.throttled);
+                enc.key("queued");    enc.value(static_cast<uint64_t>(stats.queued));
             }
-            else if (method == "countBooksByGenre") {
-                std::string genreStr = parser.getString("genre", "");
-                Genre g = book::stringtoGenre(genreStr);
-                int count = lib.countBooksByGenreRecursive(g);
-                sendResponse(id, true, "{\"count\":" + std::to_string(count) + "}");
+            enc.endObject();
+        });
+    }
+    else if (method == "stats") {
+        // Latency per method since start (or the last "reset": true), in
+        // microseconds; quantiles are within about 3%
+        auto methods = metrics.snapshot();
+        auto windowMs = std::chrono::duration_cast<std::chrono::milliseconds>(metrics.window()).count();
+        uint64_t requests = 0, errors = 0;
+        for (const auto& m : methods) {
+            requests += m.count;
+            errors += m.errors;
+        }
+        if (parser.getBool("reset", false))
+            metrics.reset();
+
+        static const char* const FIELDS[] = {"method", "count", "errors", "p50Us", "p90Us", "p99Us", "maxUs", "meanUs"};
+        sendResponse(session, id, true, [&](Encoder& enc) {
+            enc.beginObject(4);
+            enc.key("windowMs"); enc.value(static_cast<uint64_t>(windowMs));
+            enc.key("requests"); enc.value(requests);
+            enc.key("errors");   enc.value(errors);
+            enc.key("methods");
+            enc.beginTable(methods.size(), FIELDS, 8);
+            for (const auto& m : methods) {
+                enc.beginRecord(8);
+                enc.field("method"); enc.value(m.method);
+                enc.field("count");  enc.value(m.count);
+                enc.field("errors"); enc.value(m.errors);
+                enc.field("p50Us");  enc.value(m.p50);
+                enc.field("p90Us");  enc.value(m.p90);
+                enc.field("p99Us");  enc.value(m.p99);
+                enc.field("maxUs");  enc.value(m.max);
+                enc.field("meanUs"); enc.value(m.mean);
+                enc.endRecord();
             }
-            else if (method == "register") {
-                std::string username = parser.getString("username", "");
-                std::string password = parser.getString("password", "");
-                
-                if (username.empty() || password.empty()) {
-                    sendError(id, "Username and password are required");
-                    continue;
-                }
-                
-                // Check if user already exists
-                if (userExists(lib.getDb(), username)) {
-                    sendResponse(id, false, "{\"error\":\"Username already exists\"}");
-                } else {
-                    // Insert new user
-                    if (insertUser(lib.getDb(), username, password)) {
-                        sendResponse(id, true, "{\"success\":true,\"message\":\"Account created successfully\"}");
-                    } else {
-                        sendError(id, "Failed to create account");
-                    }
-                }
+            enc.endTable();
+            enc.endObject();
+        });
+    }
+    else if (method == "sqlStats") {
+        // Time in SQLite per statement since start (or the last "reset":
+        // true), most total time first; see sqlprofile.h for what it covers
+        auto statements = SqlProfile::global().snapshot();
+        if (parser.getBool("reset", false))
+            SqlProfile::global().reset();
+
+        static const char* const FIELDS[] = {"sql", "count", "fullScanSteps", "totalMs", "meanUs", "p50Us", "p99Us", "maxUs"};
+        sendResponse(session, id, true, [&](Encoder& enc) {
+            enc.beginTable(statements.size(), FIELDS, 8);
+            for (const auto& s : statements) {
+                enc.beginRecord(8);
+                enc.field("sql");           enc.value(s.sql);
+                enc.field("count");         enc.value(s.count);
+                enc.field("fullScanSteps"); enc.value(s.fullScanSteps);
+                enc.field("totalMs");       enc.value(s.total / 1000);
+                enc.field("meanUs");        enc.value(s.mean);
+                enc.field("p50Us");         enc.value(s.p50);
+                enc.field("p99Us");         enc.value(s.p99);
+                enc.field("maxUs");         enc.value(s.max);
+                enc.endRecord();
             }
-            else if (method == "login") {
-                std::string username = parser.getString("username", "");
-                std::string password = parser.getString("password", "");
-                
-                if (username.empty() || password.empty()) {
-                    sendError(id, "Username and password are required");
-                    continue;
-                }
-                
-                // Authenticate user
-                if (authenticateUser(lib.getDb(), username, password)) {
-                    sendResponse(id, true, "{\"success\":true,\"message\":\"Login successful\",\"username\":\"" + JSON::escape(username) + "\"}");
-                } else {
-                    sendResponse(id, false, "{\"error\":\"Invalid username or password\"}");
-                }
+            enc.endTable();
+        });
+    }
+    else if (method == "memoryStats") {
+        // Bytes per in-memory structure (used by the contents vs held,
+        // spare capacity included), next to SQLite's and the allocator's own
+        // totals; see memstats.h
+        auto items = lib.memoryUsage();
+        uint64_t attributed = 0;
+        for (const auto& m : items)
+            attributed += m.reserved;
+        SqliteMemory sql;
+        readSqliteMemory(lib.getDb(), sql);
+        HeapTotals heap = heapTotals();
+        AllocationCounts counts = allocationCounts();
+        bool counting = allocationCounters.linked.load();
+
+        static const char* const FIELDS[] = {"name", "count", "usedBytes", "reservedBytes"};
+        sendResponse(session, id, true, [&](Encoder& enc) {
+            enc.beginObject(6);
+            enc.key("residentBytes");   enc.value(static_cast<uint64_t>(residentBytes()));
+            enc.key("attributedBytes"); enc.value(attributed);
+            enc.key("structures");
+            enc.beginTable(items.size(), FIELDS, 4);
+            for (const auto& m : items) {
+                enc.beginRecord(4);
+                enc.field("name");          enc.value(m.name);
+                enc.field("count");         enc.value(static_cast<uint64_t>(m.count));
+                enc.field("usedBytes");     enc.value(static_cast<uint64_t>(m.used));
+                enc.field("reservedBytes"); enc.value(static_cast<uint64_t>(m.reserved));
+                enc.endRecord();
+            }
+            enc.endTable();
+            enc.key("sqlite");
+            enc.beginObject(7);
+            enc.key("memoryUsed");      enc.value(static_cast<uint64_t>(sql.used));
+            enc.key("memoryHighwater"); enc.value(static_cast<uint64_t>(sql.highwater));
+            enc.key("cacheUsed");       enc.value(sql.cacheUsed);
+            enc.key("cacheHits");       enc.value(sql.cacheHits);
+            enc.key("cacheMisses");     enc.value(sql.cacheMisses);
+            enc.key("schemaUsed");      enc.value(sql.schemaUsed);
+            enc.key("statementsUsed");  enc.value(sql.statementsUsed);
+            enc.endObject();
+            enc.key("heap");
+            enc.beginObject(4);
+            enc.key("available"); enc.value(heap.available);
+            enc.key("inUse");     enc.value(static_cast<uint64_t>(heap.inUse));
+            enc.key("free");      enc.value(static_cast<uint64_t>(heap.free));
+            enc.key("mapped");    enc.value(static_cast<uint64_t>(heap.mapped));
+            enc.endObject();
+            enc.key("allocations");
+            enc.beginObject(5);
+            enc.key("counting");       enc.value(counting);
+            enc.key("allocations");    enc.value(counts.allocations);
+            enc.key("frees");          enc.value(counts.frees);
+            enc.key("bytesAllocated"); enc.value(counts.bytesAllocated);
+            enc.key("bytesFreed");     enc.value(counts.bytesFreed);
+            enc.endObject();
+            enc.endObject();
+        });
+    }
+    else if (method == "trace") {
+        // Turns tracing on or off ("enable") and writes the latest spans of
+        // every thread to the --trace file ("write": true); see trace.h.
+        // Not read-only: it changes what the backend does, so it runs as a
+        // write and needs a token under --require-auth.
+        if (tracePath.empty()) {
+            sendError(session, id, "Tracing needs the backend started with --trace FILE");
+            return;
+        }
+        bool enable = parser.getBool("enable", tracingOn.load());
+        if (enable)
+            Tracer::global().start();
+        else
+            Tracer::global().stop();
+        long written = 0;
+        if (parser.getBool("write", false)) {
+            written = Tracer::global().write(tracePath);
+            if (written < 0) {
+                sendError(session, id, "Cannot write trace to " + tracePath);
+                return;
             }
+        }
+
+        sendResponse(session, id, true, [&](Encoder& enc) {
+            enc.beginObject(3);
+            enc.key("tracing"); enc.value(enable);
+            enc.key("file");    enc.value(tracePath);
+            enc.key("events");  enc.value(static_cast<int>(written));
+            enc.endObject();
+        });
+    }
+    else if (method == "setProtocol") {
+        // The acknowledgement still goes out in the old mode; everything
+        // after it (in both directions) uses the new one.
+        std::string mode = parser.getString("mode", "json");
+        WireMode next;
+        if (mode == "json") next = WireMode::json;
+        else if (mode == "binary") next = WireMode::binary;
+        else {
+            sendError(session, id, "Unknown protocol mode: " + mode);
+            return;
+        }
+
+        sendResponse(session, id, true, [&](Encoder& enc) {
+            enc.beginObject(1);
+            enc.key("mode"); enc.value(mode);
+            enc.endObject();
+        });
+        session.mode = next;
+    }
+
+    else {
+        sendError(session, id, "Unknown method: " + method);
+    }
+}
+
+const std::string NO_METHOD = "(none)";
+
+// Runs one request and records how long it took since it was read, and
+// with --capture the request itself
+void handleTimed(const std::shared_ptr<Session>& session, const RequestParser& parser, int id,
+                 const std::string& method, std::chrono::steady_clock::time_point received,
+                 WireMode mode, const std::string& request) {
+    requestFailed = false;
+    {
+        TraceSpan span("cli", "request", method);
+        handleRequest(*session, parser, id, method);
+    }
+    const std::string& name = method.empty() ? NO_METHOD : method;
+    metrics.record(name, std::chrono::steady_clock::now() - received, requestFailed);
+    if (capture)
+        capture->record(session, mode, request, name, !requestFailed, received);
+}
+
+// Parses one request and runs it inline or on the executor
+void dispatch(const std::shared_ptr<Session>& session, const std::string& request) {
+    auto received = std::chrono::steady_clock::now();
+    WireMode mode = session->mode;
+    try {
+        std::shared_ptr<RequestParser> parser;
+        int id;
+        std::string method;
+        {
+            TraceSpan span("cli", "parse");
+            if (mode == WireMode::binary)
+                parser = std::make_shared<MsgpackParser>(request);
+            else
+                parser = std::make_shared<SimpleParser>(request);
+            id = parser->getInt("id", 0);
+            method = parser->getString("method", "");
+        }
+
+        if (method == "setProtocol") {
+            // Every reply already in flight must go out in the old mode first
+            if (executor)
+                executor->drain();
+            if (authExecutor)
+                authExecutor->drain();
+            handleTimed(session, *parser, id, method, received, mode, request);
+        }
+        else if (authExecutor && hashesPassword(method, *parser)) {
+            auto task = [session, parser, id, method, received, mode, request]() {
+                handleTimed(session, *parser, id, method, received, mode, request);
+            };
+            // As a write, a register finishes before any login sent after it
+            if (method == "register")
+                authExecutor->submitWrite(task);
+            else
+                authExecutor->submitRead(task);
+        }
+        else if (!executor) {
+            handleTimed(session, *parser, id, method, received, mode, request);
+        }
+        else {
+            auto task = [session, parser, id, method, received, mode, request]() {
+                handleTimed(session, *parser, id, method, received, mode, request);
+            };
+            if (isReadOnly(method))
+                executor->submitRead(task);
+            else
+                executor->submitWrite(task);
+        }
+    } catch (const std::exception& e) {
+        metrics.record("(unreadable)", std::chrono::steady_clock::now() - received, true);
+        if (capture)
+            capture->record(session, mode, request, "(unreadable)", false, received);
+        std::cerr << "Error: " << e.what() << std::endl;
+    }
+}
+
+// Reads the value of a numeric flag: a whole non-negative decimal number
+bool parseCount(const std::string& flag, const char* text, long& value) {
+    char* end = nullptr;
+    errno = 0;
+    value = std::strtol(text, &end, 10);
+    if (end == text || *end != '\0' || errno == ERANGE || value < 0) {
+        std::cerr << "Invalid value for " << flag << ": " << text << std::endl;
+        return false;
+    }
+    return true;
+}
 
-            else {
-                sendError(id, "Unknown method: " + method);
+int main(int argc, char* argv[]) {
+    // --workers N: run read-only requests on N threads, writes on one more
+    // --listen PATH: serve many clients on a Unix domain socket instead of stdio
+    // --write-behind MS: commit writes in the background, at most MS ms behind
+    // --write-queue N: with --write-behind, make writers wait beyond N queued
+    // --stats-interval S: every S seconds, log per-method latency to stderr
+    // --slow-query-ms MS: log SQL statements slower than MS ms (default 100, 0 = off)
+    // --capture FILE: record every request to FILE for replay (see replay.cpp)
+    // --trace FILE: trace requests (see trace.h); written to FILE on exit
+    // --auth-workers N: threads hashing passwords for login and register (default 2)
+    // --auth-cost N: scrypt cost of new password hashes, log2 of N (default 14)
+    // --require-auth: changes and member data need a "token" from login
+    size_t workers = 0;
+    size_t authWorkers = 2;
+    long statsInterval = 0;
+    std::string listenPath;
+    bool writeBehind = false;
+    WriteBehindOptions writeOptions;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        long value = 0;
+        if (arg == "--workers" && i + 1 < argc) {
+            if (!parseCount(arg, argv[++i], value))
+                return 1;
+            workers = static_cast<size_t>(value);
+        } else if (arg == "--listen" && i + 1 < argc) {
+            listenPath = argv[++i];
+        } else if (arg == "--write-behind" && i + 1 < argc) {
+            if (!parseCount(arg, argv[++i], value))
+                return 1;
+            writeBehind = true;
+            writeOptions.maxLag = std::chrono::milliseconds(value);
+        } else if (arg == "--write-queue" && i + 1 < argc) {
+            if (!parseCount(arg, argv[++i], value))
+                return 1;
+            writeOptions.maxQueued = static_cast<size_t>(value);
+        } else if (arg == "--stats-interval" && i + 1 < argc) {
+            if (!parseCount(arg, argv[++i], statsInterval))
+                return 1;
+        } else if (arg == "--slow-query-ms" && i + 1 < argc) {
+            if (!parseCount(arg, argv[++i], value))
+                return 1;
+            SqlProfile::global().setSlowThreshold(std::chrono::milliseconds(value));
+        } else if (arg == "--capture" && i + 1 < argc) {
+            capture.reset(new RequestCapture());
+            if (!capture->open(argv[++i]))
+                return 1;
+        } else if (arg == "--auth-workers" && i + 1 < argc) {
+            if (!parseCount(arg, argv[++i], value))
+                return 1;
+            authWorkers = static_cast<size_t>(value);
+        } else if (arg == "--auth-cost" && i + 1 < argc) {
+            if (!parseCount(arg, argv[++i], value))
+                return 1;
+            if (value < MIN_HASH_COST || value > MAX_HASH_COST) {
+                std::cerr << "--auth-cost must be between " << MIN_HASH_COST << " and " << MAX_HASH_COST << std::endl;
+                return 1;
             }
-        } catch (const std::exception& e) {
-            std::cerr << "Error: " << e.what() << std::endl;
+            hashCost = static_cast<int>(value);
+        } else if (arg == "--require-auth") {
+            requireAuth = true;
+        } else if (arg == "--trace" && i + 1 < argc) {
+            tracePath = argv[++i];
+            Tracer::nameThread("main");
+            Tracer::global().start();
+        } else {
+            std::cerr << "Unknown argument: " << arg << std::endl;
+            return 1;
+        }
+    }
+
+    if (writeBehind)
+        lib.enableWriteBehind(writeOptions);
+    if (workers > 0)
+        executor.reset(new RequestExecutor(workers));
+    // An in-memory database has no second connection: hash where every
+    // other request runs instead
+    if (lib.openConnection(authDb))
+        authExecutor.reset(new RequestExecutor(std::max<size_t>(authWorkers, 1)));
+    else
+        authDb = lib.getDb();
+    std::unique_ptr<MetricsReporter> reporter;
+    if (statsInterval > 0)
+        reporter.reset(new MetricsReporter(metrics, std::chrono::seconds(statsInterval)));
+
+    if (!listenPath.empty()) {
+        int rc = runServer(listenPath, dispatch);
+        authExecutor.reset();
+        executor.reset();   // finish in-flight work before the library goes away
+        if (authDb != lib.getDb())
+            closeDatabase(authDb);
+        lib.saveSnapshot(); // clean shutdown: the next start maps it
+        if (!tracePath.empty())
+            Tracer::global().write(tracePath);
+        return rc;
+    }
+
+    std::ios::sync_with_stdio(false);
+    // cin and cerr are tied to cout by default, so every read, and every
+    // log line from any thread, would flush cout without outputMutex while
+    // workers are writing replies
+    std::cin.tie(nullptr);
+    std::cerr.tie(nullptr);
+#ifdef _WIN32
+    // Frames are raw bytes; keep the CRT from translating newlines
+    _setmode(_fileno(stdin), _O_BINARY);
+    _setmode(_fileno(stdout), _O_BINARY);
+#endif
+
+    // Replies may come from several worker threads
+    std::mutex outputMutex;
+    auto stdio = std::make_shared<Session>();
+    stdio->send = [&outputMutex](const std::string& bytes) {
+        std::lock_guard<std::mutex> lock(outputMutex);
+        std::cout.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+        std::cout.flush();
+    };
+
+    std::string line;
+    try {
+        while (readRequest(*stdio, line)) {
+            if (line.empty()) continue;
+            dispatch(stdio, line);
         }
+    } catch (const std::exception& e) {
+        // A bad frame header leaves no way to find the next frame: report
+        // it, then shut down as on end of input
+        std::cerr << "Closing stdin: " << e.what() << std::endl;
+        sendError(*stdio, 0, e.what());
     }
-    
+
+    authExecutor.reset();
+    executor.reset();
+    if (authDb != lib.getDb())
+        closeDatabase(authDb);
+    lib.saveSnapshot();
+    if (!tracePath.empty())
+        Tracer::global().write(tracePath);
     return 0;
 }
@@ -2,6 +2,10 @@
 #include "book.h"
 #include "member.h"
 #include "database.h"
+#include "sqlprofile.h"
+#include "trace.h"
+#include <algorithm>
+#include <fstream>
 #include <iostream>
 
 void createBooksTable(sqlite3* db)
@@ -54,26 +58,64 @@ void openDatabase(sqlite3* &db, const std::string& dbPath) {
     if(rc) {
         std::cerr << "Can't open database: " << sqlite3_errmsg(db) << std::endl;
     } else {
+        SqlProfile::global().attach(db);
         // Successful open - avoid printing to stdout to keep CLI protocol clean
         std::cerr << "Database opened successfully (stderr)." << std::endl;
     }
 }
 
-int insertBook(sqlite3* db, const book& b) {
+bool openReadConnection(sqlite3*& db, const std::string& dbPath) {
+    int rc = sqlite3_open_v2(dbPath.c_str(), &db, SQLITE_OPEN_READONLY, nullptr);
+    if (rc != SQLITE_OK) {
+        std::cerr << "Can't open read connection: " << sqlite3_errmsg(db) << std::endl;
+        sqlite3_close(db);
+        db = nullptr;
+        return false;
+    }
+    // Wait out a commit on the main connection rather than read nothing
+    sqlite3_busy_timeout(db, 5000);
+    SqlProfile::global().attach(db);
+    return true;
+}
+
+// Prepares `sql`, logging why it failed; stmt is null then
+static bool prepare(sqlite3* db, const char* sql, sqlite3_stmt*& stmt)
+{
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) == SQLITE_OK)
+        return true;
+    std::cerr << "Failed to prepare \"" << sql << "\": " << sqlite3_errmsg(db) << std::endl;
+    stmt = nullptr;
+    return false;
+}
+
+// Binds record text, which is not NUL-terminated (see StringPool)
+static void bindText(sqlite3_stmt* stmt, int index, std::string_view text)
+{
+    sqlite3_bind_text(stmt, index, text.data(), static_cast<int>(text.size()), SQLITE_TRANSIENT);
+}
 
+int insertBook(sqlite3* db, const book& b, bool keepID) {
+    TraceSpan span("database", "insertBook");
+
+    // A NULL id lets SQLite pick the next one
     const char* sql =
-        "INSERT INTO books (title, author, ISBN, genre, cover_url) "
-        "VALUES (?, ?, ?, ?, ?);";
+        "INSERT INTO books (id, title, author, ISBN, genre, cover_url) "
+        "VALUES (?, ?, ?, ?, ?, ?);";
 
     sqlite3_stmt* stmt = nullptr;
 
-    sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr);
+    if (!prepare(db, sql, stmt))
+        return -1;
 
-    sqlite3_bind_text(stmt, 1, b.getTitle().c_str(), -1, SQLITE_TRANSIENT);
-    sqlite3_bind_text(stmt, 2, b.getAuthor().c_str(), -1, SQLITE_TRANSIENT);
-    sqlite3_bind_text(stmt, 3, b.getISBN().c_str(), -1, SQLITE_TRANSIENT);
-    sqlite3_bind_text(stmt, 4, book::genretoString(b.getGenre()).c_str(), -1 , SQLITE_TRANSIENT);
-    sqlite3_bind_text(stmt, 5, b.getCoverUrl().c_str(), -1, SQLITE_TRANSIENT);
+    if (keepID)
+        sqlite3_bind_int(stmt, 1, b.getID());
+    else
+        sqlite3_bind_null(stmt, 1);
+    bindText(stmt, 2, b.getTitle());
+    bindText(stmt, 3, b.getAuthor());
+    bindText(stmt, 4, b.getISBN());
+    sqlite3_bind_text(stmt, 5, book::genretoString(b.getGenre()).c_str(), -1 , SQLITE_TRANSIENT);
+    bindText(stmt, 6, b.getCoverUrl());
 
     if (sqlite3_step(stmt) != SQLITE_DONE)
     {
@@ -90,18 +132,24 @@ int insertBook(sqlite3* db, const book& b) {
 
 }
 
-int insertMember(sqlite3* db, const member& m) {
+int insertMember(sqlite3* db, const member& m, bool keepID) {
+    TraceSpan span("database", "insertMember");
     const char* sql =
-        "INSERT INTO members (name, address, BorrowedBookID) "
-        "VALUES (?, ?, ?);";
+        "INSERT INTO members (id, name, address, BorrowedBookID) "
+        "VALUES (?, ?, ?, ?);";
 
     sqlite3_stmt* stmt = nullptr;
 
-    sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr);
+    if (!prepare(db, sql, stmt))
+        return -1;
 
-    sqlite3_bind_text(stmt, 1, m.getName().c_str(), -1, SQLITE_TRANSIENT);
-    sqlite3_bind_text(stmt, 2, m.getAddress().c_str(), -1, SQLITE_TRANSIENT);
-    sqlite3_bind_int(stmt, 3, m.getBorrowedBookID()); // BorrowedBookID
+    if (keepID)
+        sqlite3_bind_int(stmt, 1, m.getID());
+    else
+        sqlite3_bind_null(stmt, 1);
+    bindText(stmt, 2, m.getName());
+    bindText(stmt, 3, m.getAddress());
+    sqlite3_bind_int(stmt, 4, m.getBorrowedBookID()); // BorrowedBookID
 
     if (sqlite3_step(stmt) != SQLITE_DONE)
     {
@@ -115,10 +163,74 @@ int insertMember(sqlite3* db, const member& m) {
     return (int)sqlite3_last_insert_rowid(db);
 }
 
+// Runs `bind` for rows [0, count) against one prepared statement, committing
+// every `batch` rows; `what` names the records in error messages
+template <typename Bind>
+static bool insertInBatches(sqlite3* db, const char* sql, size_t count, size_t batch, const char* what, Bind bind)
+{
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+        std::cerr << "Failed to insert " << what << ": " << sqlite3_errmsg(db) << std::endl;
+        return false;
+    }
+    if (batch == 0)
+        batch = count;
+
+    bool ok = true;
+    for (size_t first = 0; ok && first < count; first += batch) {
+        ok = sqlite3_exec(db, "BEGIN;", nullptr, nullptr, nullptr) == SQLITE_OK;
+        size_t last = std::min(count, first + batch);
+        for (size_t i = first; ok && i < last; ++i) {
+            bind(stmt, i);
+            ok = sqlite3_step(stmt) == SQLITE_DONE;
+            sqlite3_reset(stmt);
+        }
+        if (ok)
+            ok = sqlite3_exec(db, "COMMIT;", nullptr, nullptr, nullptr) == SQLITE_OK;
+    }
+    sqlite3_finalize(stmt);
+
+    if (ok)
+        return true;
+    std::cerr << "Failed to insert " << what << ": " << sqlite3_errmsg(db) << std::endl;
+    sqlite3_exec(db, "ROLLBACK;", nullptr, nullptr, nullptr);
+    return false;
+}
+
+bool insertBooks(sqlite3* db, const std::vector<book>& books, size_t batch) {
+    const char* sql =
+        "INSERT INTO books (id, title, author, ISBN, genre, cover_url, borrowStatus, issuedTo) "
+        "VALUES (?, ?, ?, ?, ?, ?, ?, ?);";
+    return insertInBatches(db, sql, books.size(), batch, "books", [&books](sqlite3_stmt* stmt, size_t i) {
+        const book& b = books[i];
+        sqlite3_bind_int(stmt, 1, b.getID());
+        bindText(stmt, 2, b.getTitle());
+        bindText(stmt, 3, b.getAuthor());
+        bindText(stmt, 4, b.getISBN());
+        sqlite3_bind_text(stmt, 5, book::genretoString(b.getGenre()).c_str(), -1, SQLITE_TRANSIENT);
+        bindText(stmt, 6, b.getCoverUrl());
+        sqlite3_bind_int(stmt, 7, b.getBorrowStatus() ? 1 : 0);
+        sqlite3_bind_int(stmt, 8, b.getIssuedTo());
+    });
+}
+
+bool insertMembers(sqlite3* db, const std::vector<member>& members, size_t batch) {
+    const char* sql = "INSERT INTO members (id, name, address, BorrowedBookID) VALUES (?, ?, ?, ?);";
+    return insertInBatches(db, sql, members.size(), batch, "members", [&members](sqlite3_stmt* stmt, size_t i) {
+        const member& m = members[i];
+        sqlite3_bind_int(stmt, 1, m.getID());
+        bindText(stmt, 2, m.getName());
+        bindText(stmt, 3, m.getAddress());
+        sqlite3_bind_int(stmt, 4, m.getBorrowedBookID());
+    });
+}
+
 void updateMemberBorrow(sqlite3* db, int memberID, int borrowedBookID) {
+    TraceSpan span("database", "updateMemberBorrow");
     const char* sql = "UPDATE members SET BorrowedBookID = ? WHERE id = ?;";
     sqlite3_stmt* stmt = nullptr;
-    sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr);
+    if (!prepare(db, sql, stmt))
+        return;
     sqlite3_bind_int(stmt, 1, borrowedBookID);
     sqlite3_bind_int(stmt, 2, memberID);
     if (sqlite3_step(stmt) != SQLITE_DONE) {
@@ -128,12 +240,14 @@ void updateMemberBorrow(sqlite3* db, int memberID, int borrowedBookID) {
 }
 
 void updateBookStatus(sqlite3* db, const book& b) {
+    TraceSpan span("database", "updateBookStatus");
     const char* sql =
             "UPDATE books SET borrowStatus = ?, issuedTo = ? WHERE id = ?;";
 
     sqlite3_stmt* stmt = nullptr;
 
-    sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr);
+    if (!prepare(db, sql, stmt))
+        return;
 
     sqlite3_bind_int(stmt, 1, b.getBorrowStatus() ? 1 : 0); // borrowStatus
     sqlite3_bind_int(stmt, 2, b.getIssuedTo());             // issuedTo
@@ -147,68 +261,92 @@ void updateBookStatus(sqlite3* db, const book& b) {
     sqlite3_finalize(stmt);
 }
 
-void loadBooks(sqlite3* db, std::vector<book>& books) {
-    const char* sql = "SELECT id, title, author, ISBN, genre, cover_url, borrowStatus, issuedTo FROM books;";
+// Row count of `table`, used to size the load vectors up front
+static size_t countRows(sqlite3* db, const char* table)
+{
+    std::string sql = std::string("SELECT COUNT(*) FROM ") + table + ";";
+    sqlite3_stmt* stmt = nullptr;
+    size_t count = 0;
+    if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) == SQLITE_OK &&
+        sqlite3_step(stmt) == SQLITE_ROW)
+        count = static_cast<size_t>(sqlite3_column_int64(stmt, 0));
+    sqlite3_finalize(stmt);
+    return count;
+}
 
+int lastRowID(sqlite3* db, const char* table)
+{
+    std::string sql = std::string("SELECT MAX(id) FROM ") + table + ";";
     sqlite3_stmt* stmt = nullptr;
-    sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr);
+    int id = 0;
+    if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) == SQLITE_OK &&
+        sqlite3_step(stmt) == SQLITE_ROW)
+        id = sqlite3_column_int(stmt, 0);   // NULL (empty table) reads as 0
+    sqlite3_finalize(stmt);
+    return id;
+}
 
-    while (sqlite3_step(stmt) == SQLITE_ROW)
-    {
-        int id = sqlite3_column_int(stmt, 0);
-        std::string title = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
-        std::string author = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2));
-        std::string isbn = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 3));
-        std::string genreStr = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 4));
-        const char* coverUrlPtr = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 5));
-        std::string coverUrl = coverUrlPtr ? coverUrlPtr : "";
-        int borrowStatus = sqlite3_column_int(stmt, 6);
-        int issuedTo = sqlite3_column_int(stmt, 7);
+// A text column as a view of SQLite's own buffer, valid until the next
+// step; NULL reads as "". Nothing is copied until the record is built.
+static std::string_view columnText(sqlite3_stmt* stmt, int column)
+{
+    const char* text = reinterpret_cast<const char*>(sqlite3_column_text(stmt, column));
+    if (!text) return std::string_view();
+    return std::string_view(text, static_cast<size_t>(sqlite3_column_bytes(stmt, column)));
+}
 
-        Genre genre = book::stringtoGenre(genreStr);
+void loadBooks(sqlite3* db, std::vector<book>& books) {
+    // ID order lets the catalog take the rows without sorting them
+    const char* sql = "SELECT id, title, author, ISBN, genre, cover_url, borrowStatus, issuedTo FROM books ORDER BY id;";
 
-        book b(title, isbn, author, genre, issuedTo);
-        b.modifyBorrowStatus(borrowStatus == 1);
-        b.setCoverUrl(coverUrl);
+    books.reserve(books.size() + countRows(db, "books"));
 
-        // Force restore ID
-        b.setID(id);// sets private ID directly
+    sqlite3_stmt* stmt = nullptr;
+    if (!prepare(db, sql, stmt))
+        return;
 
-        books.push_back(b);
+    while (sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        // Built in place; the text goes straight from SQLite into the string pool
+        books.emplace_back(sqlite3_column_int(stmt, 0),
+                           columnText(stmt, 1),                          // title
+                           columnText(stmt, 3),                          // ISBN
+                           columnText(stmt, 2),                          // author
+                           book::stringtoGenre(columnText(stmt, 4)),
+                           columnText(stmt, 5),                          // cover_url
+                           sqlite3_column_int(stmt, 6) == 1,             // borrowStatus
+                           sqlite3_column_int(stmt, 7));                 // issuedTo
     }
 
     sqlite3_finalize(stmt);
 }
 
 void loadMembers(sqlite3* db, std::vector<member>& members) {
-    const char* sql = "SELECT id, name, address, BorrowedBookID FROM members;";
+    const char* sql = "SELECT id, name, address, BorrowedBookID FROM members ORDER BY id;";
+
+    members.reserve(members.size() + countRows(db, "members"));
 
     sqlite3_stmt* stmt = nullptr;
-    sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr);
+    if (!prepare(db, sql, stmt))
+        return;
 
     while (sqlite3_step(stmt) == SQLITE_ROW)
     {
-        int id = sqlite3_column_int(stmt, 0);
-        std::string name = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
-        std::string address = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2));
-        int borrowedID = sqlite3_column_int(stmt, 3);
-
-
-        member m(name, address, borrowedID);
-
-        // Restore ID
-        m.setID(id);
-
-        members.push_back(m);
+        members.emplace_back(sqlite3_column_int(stmt, 0),
+                             columnText(stmt, 1),                        // name
+                             columnText(stmt, 2),                        // address
+                             sqlite3_column_int(stmt, 3));               // BorrowedBookID
     }
 
     sqlite3_finalize(stmt);
 }
 
 void deleteBook(sqlite3* db, int bookID) {
+    TraceSpan span("database", "deleteBook");
     const char* sql = "DELETE FROM books WHERE id = ?;";
     sqlite3_stmt* stmt = nullptr;
-    sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr);
+    if (!prepare(db, sql, stmt))
+        return;
     sqlite3_bind_int(stmt, 1, bookID);
     
     if (sqlite3_step(stmt) != SQLITE_DONE) {
@@ -219,9 +357,11 @@ void deleteBook(sqlite3* db, int bookID) {
 }
 
 void deleteMember(sqlite3* db, int memberID) {
+    TraceSpan span("database", "deleteMember");
     const char* sql = "DELETE FROM members WHERE id = ?;";
     sqlite3_stmt* stmt = nullptr;
-    sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr);
+    if (!prepare(db, sql, stmt))
+        return;
     sqlite3_bind_int(stmt, 1, memberID);
     
     if (sqlite3_step(stmt) != SQLITE_DONE) {
@@ -231,6 +371,253 @@ void deleteMember(sqlite3* db, int memberID) {
     sqlite3_finalize(stmt);
 }
 
+// Loans: one row per book currently out. book_id is the key (a copy can
+// only be lent once); loans_by_member serves "what does X hold" and
+// member deletion without touching the rest of the catalog.
+void createLoansTable(sqlite3* db) {
+    // Databases from before the loans table kept loans only in books.issuedTo
+    bool existed = false;
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(db, "SELECT 1 FROM sqlite_master WHERE type = 'table' AND name = 'loans';",
+                           -1, &stmt, nullptr) == SQLITE_OK) {
+        existed = (sqlite3_step(stmt) == SQLITE_ROW);
+    }
+    sqlite3_finalize(stmt);
+
+    const char* sql =
+        "CREATE TABLE IF NOT EXISTS loans ("
+        "book_id INTEGER PRIMARY KEY, "
+        "member_id INTEGER NOT NULL, "
+        "loaned_at INTEGER NOT NULL DEFAULT (strftime('%s', 'now'))"
+        ");"
+        "CREATE INDEX IF NOT EXISTS loans_by_member ON loans (member_id);";
+
+    char* errMsg = nullptr;
+    if (sqlite3_exec(db, sql, nullptr, nullptr, &errMsg) != SQLITE_OK) {
+        std::cerr << "Error creating loans table: " << errMsg << std::endl;
+        sqlite3_free(errMsg);
+        return;
+    }
+
+    if (!existed) {
+        const char* migrate =
+            "INSERT OR IGNORE INTO loans (book_id, member_id) "
+            "SELECT id, issuedTo FROM books WHERE borrowStatus = 1 AND issuedTo <> 0;";
+        if (sqlite3_exec(db, migrate, nullptr, nullptr, &errMsg) != SQLITE_OK) {
+            std::cerr << "Error migrating loans: " << errMsg << std::endl;
+            sqlite3_free(errMsg);
+        }
+    }
+}
+
+void insertLoan(sqlite3* db, int bookID, int memberID) {
+    TraceSpan span("database", "insertLoan");
+    const char* sql = "INSERT OR REPLACE INTO loans (book_id, member_id) VALUES (?, ?);";
+    sqlite3_stmt* stmt = nullptr;
+    if (!prepare(db, sql, stmt))
+        return;
+    sqlite3_bind_int(stmt, 1, bookID);
+    sqlite3_bind_int(stmt, 2, memberID);
+    if (sqlite3_step(stmt) != SQLITE_DONE) {
+        std::cerr << "Failed to insert loan.\n";
+    }
+    sqlite3_finalize(stmt);
+}
+
+void deleteLoan(sqlite3* db, int bookID) {
+    TraceSpan span("database", "deleteLoan");
+    const char* sql = "DELETE FROM loans WHERE book_id = ?;";
+    sqlite3_stmt* stmt = nullptr;
+    if (!prepare(db, sql, stmt))
+        return;
+    sqlite3_bind_int(stmt, 1, bookID);
+    if (sqlite3_step(stmt) != SQLITE_DONE) {
+        std::cerr << "Failed to delete loan.\n";
+    }
+    sqlite3_finalize(stmt);
+}
+
+// Returns every book the member holds with one UPDATE (driven by
+// loans_by_member), then drops their loans
+void releaseMemberLoans(sqlite3* db, int memberID) {
+    TraceSpan span("database", "releaseMemberLoans");
+    const char* sqls[] = {
+        "UPDATE books SET borrowStatus = 0, issuedTo = 0 "
+        "WHERE id IN (SELECT book_id FROM loans WHERE member_id = ?);",
+        "DELETE FROM loans WHERE member_id = ?;"
+    };
+    for (const char* sql : sqls) {
+        sqlite3_stmt* stmt = nullptr;
+        if (!prepare(db, sql, stmt))
+            return;
+        sqlite3_bind_int(stmt, 1, memberID);
+        if (sqlite3_step(stmt) != SQLITE_DONE) {
+            std::cerr << "Failed to release loans: " << sqlite3_errmsg(db) << std::endl;
+        }
+        sqlite3_finalize(stmt);
+    }
+}
+
+void loadLoans(sqlite3* db, std::vector<Loan>& loans) {
+    const char* sql = "SELECT book_id, member_id FROM loans ORDER BY loaned_at, rowid;";
+
+    sqlite3_stmt* stmt = nullptr;
+    if (!prepare(db, sql, stmt))
+        return;
+
+    while (sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        loans.push_back(Loan{sqlite3_column_int(stmt, 0), sqlite3_column_int(stmt, 1)});
+    }
+
+    sqlite3_finalize(stmt);
+}
+
+bool insertLoans(sqlite3* db, const std::vector<Loan>& loans, size_t batch) {
+    const char* sql = "INSERT OR REPLACE INTO loans (book_id, member_id) VALUES (?, ?);";
+    return insertInBatches(db, sql, loans.size(), batch, "loans", [&loans](sqlite3_stmt* stmt, size_t i) {
+        sqlite3_bind_int(stmt, 1, loans[i].bookID);
+        sqlite3_bind_int(stmt, 2, loans[i].memberID);
+    });
+}
+
+// Time and member indexes keep report queries to the range they ask for
+void createLoanHistoryTable(sqlite3* db) {
+    const char* sql =
+        "CREATE TABLE IF NOT EXISTS loan_history ("
+        "seq INTEGER PRIMARY KEY, "
+        "time INTEGER NOT NULL, "
+        "book_id INTEGER NOT NULL, "
+        "member_id INTEGER NOT NULL, "
+        "action INTEGER NOT NULL"
+        ");"
+        "CREATE INDEX IF NOT EXISTS loan_history_by_time ON loan_history (time);"
+        "CREATE INDEX IF NOT EXISTS loan_history_by_member ON loan_history (member_id, time);";
+    char* errMsg = nullptr;
+    if (sqlite3_exec(db, sql, nullptr, nullptr, &errMsg) != SQLITE_OK) {
+        std::cerr << "Error creating loan_history table: " << errMsg << std::endl;
+        sqlite3_free(errMsg);
+    }
+}
+
+uint64_t nextLoanHistorySeq(sqlite3* db) {
+    sqlite3_stmt* stmt = nullptr;
+    uint64_t seq = 0;
+    if (sqlite3_prepare_v2(db, "SELECT COALESCE(MAX(seq) + 1, 0) FROM loan_history;", -1, &stmt, nullptr) == SQLITE_OK &&
+        sqlite3_step(stmt) == SQLITE_ROW)
+        seq = static_cast<uint64_t>(sqlite3_column_int64(stmt, 0));
+    sqlite3_finalize(stmt);
+    return seq;
+}
+
+bool insertLoanHistory(sqlite3* db, uint64_t firstSeq, const std::vector<LoanEvent>& events) {
+    TraceSpan span("database", "insertLoanHistory");
+    const char* sql =
+        "INSERT OR IGNORE INTO loan_history (seq, time, book_id, member_id, action) VALUES (?, ?, ?, ?, ?);";
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+        std::cerr << "Failed to store loan history: " << sqlite3_errmsg(db) << std::endl;
+        return false;
+    }
+
+    bool ok = sqlite3_exec(db, "BEGIN;", nullptr, nullptr, nullptr) == SQLITE_OK;
+    for (size_t i = 0; ok && i < events.size(); ++i) {
+        sqlite3_bind_int64(stmt, 1, static_cast<sqlite3_int64>(firstSeq + i));
+        sqlite3_bind_int64(stmt, 2, events[i].time);
+        sqlite3_bind_int(stmt, 3, events[i].bookID);
+        sqlite3_bind_int(stmt, 4, events[i].memberID);
+        sqlite3_bind_int(stmt, 5, static_cast<int>(events[i].action));
+        ok = sqlite3_step(stmt) == SQLITE_DONE;
+        sqlite3_reset(stmt);
+    }
+    sqlite3_finalize(stmt);
+
+    if (ok && sqlite3_exec(db, "COMMIT;", nullptr, nullptr, nullptr) == SQLITE_OK)
+        return true;
+    std::cerr << "Failed to store loan history: " << sqlite3_errmsg(db) << std::endl;
+    sqlite3_exec(db, "ROLLBACK;", nullptr, nullptr, nullptr);
+    return false;
+}
+
+void loadMemberLoanHistory(sqlite3* db, int memberID, uint32_t from, uint32_t to, uint64_t beforeSeq,
+                           std::vector<LoanEvent>& events) {
+    TraceSpan span("database", "loadMemberLoanHistory");
+    const char* sql =
+        "SELECT time, book_id, member_id, action FROM loan_history "
+        "WHERE member_id = ? AND time >= ? AND time < ? AND seq < ? ORDER BY seq;";
+    sqlite3_stmt* stmt = nullptr;
+    if (!prepare(db, sql, stmt))
+        return;
+    sqlite3_bind_int(stmt, 1, memberID);
+    sqlite3_bind_int64(stmt, 2, from);
+    sqlite3_bind_int64(stmt, 3, to);
+    sqlite3_bind_int64(stmt, 4, static_cast<sqlite3_int64>(beforeSeq));
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        events.push_back({static_cast<uint32_t>(sqlite3_column_int64(stmt, 0)),
+                          sqlite3_column_int(stmt, 1),
+                          sqlite3_column_int(stmt, 2),
+                          static_cast<LoanAction>(sqlite3_column_int(stmt, 3))});
+    }
+    sqlite3_finalize(stmt);
+}
+
+void countLoanHistoryPerDay(sqlite3* db, uint32_t from, uint32_t to, uint64_t beforeSeq,
+                            std::vector<LoanDayCount>& days) {
+    TraceSpan span("database", "countLoanHistoryPerDay");
+    const char* sql =
+        "SELECT time / 86400 AS day, SUM(action = 0), SUM(action = 1) FROM loan_history "
+        "WHERE time >= ? AND time < ? AND seq < ? GROUP BY day ORDER BY day;";
+    sqlite3_stmt* stmt = nullptr;
+    if (!prepare(db, sql, stmt))
+        return;
+    sqlite3_bind_int64(stmt, 1, from);
+    sqlite3_bind_int64(stmt, 2, to);
+    sqlite3_bind_int64(stmt, 3, static_cast<sqlite3_int64>(beforeSeq));
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        LoanDayCount d;
+        d.day = static_cast<uint32_t>(sqlite3_column_int64(stmt, 0));
+        d.checkouts = sqlite3_column_int(stmt, 1);
+        d.returns = sqlite3_column_int(stmt, 2);
+        days.push_back(d);
+    }
+    sqlite3_finalize(stmt);
+}
+
+void loadRecentCheckouts(sqlite3* db, uint64_t beforeSeq, size_t limit, std::vector<LoanEvent>& events) {
+    TraceSpan span("database", "loadRecentCheckouts");
+    const char* sql =
+        "SELECT time, book_id, member_id, action FROM loan_history "
+        "WHERE seq < ? AND action = 0 ORDER BY seq DESC LIMIT ?;";
+    sqlite3_stmt* stmt = nullptr;
+    if (!prepare(db, sql, stmt))
+        return;
+    sqlite3_bind_int64(stmt, 1, static_cast<sqlite3_int64>(beforeSeq));
+    sqlite3_bind_int64(stmt, 2, static_cast<sqlite3_int64>(limit));
+    size_t first = events.size();
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        events.push_back({static_cast<uint32_t>(sqlite3_column_int64(stmt, 0)),
+                          sqlite3_column_int(stmt, 1),
+                          sqlite3_column_int(stmt, 2),
+                          static_cast<LoanAction>(sqlite3_column_int(stmt, 3))});
+    }
+    sqlite3_finalize(stmt);
+    std::reverse(events.begin() + static_cast<std::ptrdiff_t>(first), events.end());
+}
+
+void beginTransaction(sqlite3* db) {
+    TraceSpan span("database", "beginTransaction");
+    sqlite3_exec(db, "BEGIN;", nullptr, nullptr, nullptr);
+}
+
+void commitTransaction(sqlite3* db) {
+    TraceSpan span("database", "commitTransaction");
+    char* errMsg = nullptr;
+    if (sqlite3_exec(db, "COMMIT;", nullptr, nullptr, &errMsg) != SQLITE_OK) {
+        std::cerr << "Commit failed: " << errMsg << std::endl;
+        sqlite3_free(errMsg);
+    }
+}
+
 // User authentication functions
 void createUsersTable(sqlite3* db) {
     const char* sql = "CREATE TABLE IF NOT EXISTS users ("
@@ -245,10 +632,8 @@ void createUsersTable(sqlite3* db) {
     }
 }
 
-bool insertUser(sqlite3* db, const std::string& username, const std::string& password) {
-    // Simple password hashing (in production, use bcrypt or similar)
-    std::string passwordHash = password; // For now, just store as-is (upgrade to proper hashing later)
-    
+bool insertUser(sqlite3* db, const std::string& username, const std::string& passwordHash) {
+    TraceSpan span("database", "insertUser");
     const char* sql = "INSERT INTO users (username, passwordHash) VALUES (?, ?);";
     sqlite3_stmt* stmt = nullptr;
     
@@ -266,29 +651,43 @@ bool insertUser(sqlite3* db, const std::string& username, const std::string& pas
     return success;
 }
 
-bool authenticateUser(sqlite3* db, const std::string& username, const std::string& password) {
+bool readPasswordHash(sqlite3* db, const std::string& username, std::string& passwordHash) {
+    TraceSpan span("database", "readPasswordHash");
     const char* sql = "SELECT passwordHash FROM users WHERE username = ?;";
     sqlite3_stmt* stmt = nullptr;
-    
-    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+    if (!prepare(db, sql, stmt))
         return false;
-    }
-    
     sqlite3_bind_text(stmt, 1, username.c_str(), -1, SQLITE_TRANSIENT);
-    
-    bool authenticated = false;
+
+    bool found = false;
     if (sqlite3_step(stmt) == SQLITE_ROW) {
-        const char* storedHash = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
-        if (storedHash && password == storedHash) {
-            authenticated = true;
+        const char* stored = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
+        if (stored) {
+            passwordHash = stored;
+            found = true;
         }
     }
-    
     sqlite3_finalize(stmt);
-    return authenticated;
+    return found;
+}
+
+bool updatePasswordHash(sqlite3* db, const std::string& username, const std::string& passwordHash) {
+    TraceSpan span("database", "updatePasswordHash");
+    const char* sql = "UPDATE users SET passwordHash = ? WHERE username = ?;";
+    sqlite3_stmt* stmt = nullptr;
+    if (!prepare(db, sql, stmt))
+        return false;
+    sqlite3_bind_text(stmt, 1, passwordHash.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_text(stmt, 2, username.c_str(), -1, SQLITE_TRANSIENT);
+    bool success = (sqlite3_step(stmt) == SQLITE_DONE);
+    if (!success)
+        std::cerr << "Failed to update password hash.\n";
+    sqlite3_finalize(stmt);
+    return success;
 }
 
 bool userExists(sqlite3* db, const std::string& username) {
+    TraceSpan span("database", "userExists");
     const char* sql = "SELECT COUNT(*) FROM users WHERE username = ?;";
     sqlite3_stmt* stmt = nullptr;
     
@@ -307,6 +706,38 @@ bool userExists(sqlite3* db, const std::string& username) {
     return exists;
 }
 
+bool readDataVersion(sqlite3* db, uint64_t& version) {
+    const char* path = sqlite3_db_filename(db, "main");
+    if (!path || !*path)
+        return false;   // in-memory
+
+    unsigned char header[100];
+    std::ifstream file(path, std::ios::binary);
+    if (!file.read(reinterpret_cast<char*>(header), sizeof(header)))
+        return false;
+    if (header[18] == 2 || header[19] == 2)
+        return false;   // WAL: commits do not touch the header
+
+    // Big-endian fields: file change counter at 24, page count at 28
+    auto field = [&header](int at) {
+        return (uint64_t(header[at]) << 24) | (uint64_t(header[at + 1]) << 16) |
+               (uint64_t(header[at + 2]) << 8) | uint64_t(header[at + 3]);
+    };
+    version = (field(24) << 32) | field(28);
+    return true;
+}
+
+void readSqliteMemory(sqlite3* db, SqliteMemory& out) {
+    out.used = sqlite3_memory_used();
+    out.highwater = sqlite3_memory_highwater(0);
+    int highwater = 0;
+    sqlite3_db_status(db, SQLITE_DBSTATUS_CACHE_USED, &out.cacheUsed, &highwater, 0);
+    sqlite3_db_status(db, SQLITE_DBSTATUS_CACHE_HIT, &out.cacheHits, &highwater, 0);
+    sqlite3_db_status(db, SQLITE_DBSTATUS_CACHE_MISS, &out.cacheMisses, &highwater, 0);
+    sqlite3_db_status(db, SQLITE_DBSTATUS_SCHEMA_USED, &out.schemaUsed, &highwater, 0);
+    sqlite3_db_status(db, SQLITE_DBSTATUS_STMT_USED, &out.statementsUsed, &highwater, 0);
+}
+
 void closeDatabase(sqlite3* db) {
     if (db)
         sqlite3_close(db);
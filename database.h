@@ -3,19 +3,35 @@
 #include "external/sqlite/sqlite3.h"
 #include "book.h"
 #include "member.h"
+#include "loanlog.h"
+#include <cstdint>
 #include <iostream>
+#include <vector>
 
 void openDatabase(sqlite3*& db, const std::string& dbPath);
 
+// Another, read-only connection to the same file, for loading in parallel.
+// False (and db null) if it cannot be opened.
+bool openReadConnection(sqlite3*& db, const std::string& dbPath);
+
 void createBooksTable(sqlite3* db);
 
 void createMembersTable(sqlite3* db);
 
-// Inserts and returns the new row ID (auto-incremented)
-int insertBook(sqlite3* db, const book& b);
+// Inserts and returns the new row ID (auto-incremented, or b's own with keepID)
+int insertBook(sqlite3* db, const book& b, bool keepID = false);
+
+// Inserts member and returns new row ID (m's own with keepID)
+int insertMember(sqlite3* db, const member& m, bool keepID = false);
+
+// Bulk load of complete records under their own IDs (status and loans
+// included), one prepared statement and one transaction per `batch` rows.
+// False if a batch failed; batches before it stay committed.
+bool insertBooks(sqlite3* db, const std::vector<book>& books, size_t batch = 50000);
+bool insertMembers(sqlite3* db, const std::vector<member>& members, size_t batch = 50000);
 
-// Inserts member and returns new row ID
-int insertMember(sqlite3* db, const member& m);
+// Highest ID in `table`, 0 if it is empty
+int lastRowID(sqlite3* db, const char* table);
 
 // Update a member's borrowed book id
 void updateMemberBorrow(sqlite3* db, int memberID, int borrowedBookID);
@@ -30,10 +46,67 @@ void deleteBook(sqlite3* db, int bookID);
 
 void deleteMember(sqlite3* db, int memberID);
 
-// User authentication functions
+// One book out on loan (a row of the loans table)
+struct Loan {
+    int bookID;
+    int memberID;
+};
+
+// Creates the loans table; on first run fills it from books.issuedTo
+void createLoansTable(sqlite3* db);
+void insertLoan(sqlite3* db, int bookID, int memberID);
+void deleteLoan(sqlite3* db, int bookID);
+// Returns all of a member's books and removes their loans
+void releaseMemberLoans(sqlite3* db, int memberID);
+// Oldest loan first
+void loadLoans(sqlite3* db, std::vector<Loan>& loans);
+// Bulk counterpart of insertLoan (see insertBooks)
+bool insertLoans(sqlite3* db, const std::vector<Loan>& loans, size_t batch = 50000);
+
+// Loan history (see loanlog.h): compacted events, keyed by sequence number
+void createLoanHistoryTable(sqlite3* db);
+// Sequence number after the last stored event
+uint64_t nextLoanHistorySeq(sqlite3* db);
+// Stores events[i] as sequence number firstSeq + i, in one transaction;
+// already stored ones are skipped. False if nothing was committed.
+bool insertLoanHistory(sqlite3* db, uint64_t firstSeq, const std::vector<LoanEvent>& events);
+// Range queries over events numbered below beforeSeq, from <= time < to
+void loadMemberLoanHistory(sqlite3* db, int memberID, uint32_t from, uint32_t to, uint64_t beforeSeq,
+                           std::vector<LoanEvent>& events);
+void countLoanHistoryPerDay(sqlite3* db, uint32_t from, uint32_t to, uint64_t beforeSeq,
+                            std::vector<LoanDayCount>& days);
+// The last `limit` checkouts numbered below beforeSeq, oldest first
+void loadRecentCheckouts(sqlite3* db, uint64_t beforeSeq, size_t limit, std::vector<LoanEvent>& events);
+
+// Groups the statements of one mutation into a single commit
+void beginTransaction(sqlite3* db);
+void commitTransaction(sqlite3* db);
+
+// User authentication functions. Passwords are stored as given by the
+// caller: hashed with hashPassword (see passwordhash.h).
 void createUsersTable(sqlite3* db);
-bool insertUser(sqlite3* db, const std::string& username, const std::string& password);
-bool authenticateUser(sqlite3* db, const std::string& username, const std::string& password);
+bool insertUser(sqlite3* db, const std::string& username, const std::string& passwordHash);
+// False if there is no such user
+bool readPasswordHash(sqlite3* db, const std::string& username, std::string& passwordHash);
+bool updatePasswordHash(sqlite3* db, const std::string& username, const std::string& passwordHash);
 bool userExists(sqlite3* db, const std::string& username);
 
+// Identifies the data a catalog snapshot file was taken from: the file
+// change counter from the database header, which SQLite bumps on every
+// commit, combined with the page count. False for in-memory or WAL-mode
+// databases, where the header does not track commits.
+bool readDataVersion(sqlite3* db, uint64_t& version);
+
+// SQLite's heap (all connections) and one connection's caches
+struct SqliteMemory {
+    int64_t used = 0;           // bytes now
+    int64_t highwater = 0;      // most bytes at once since start
+    int cacheUsed = 0;          // page cache of `db`, bytes
+    int cacheHits = 0;
+    int cacheMisses = 0;
+    int schemaUsed = 0;         // parsed schema, bytes
+    int statementsUsed = 0;     // prepared statements, bytes
+};
+void readSqliteMemory(sqlite3* db, SqliteMemory& out);
+
 void closeDatabase(sqlite3* db);
\ No newline at end of file
@@ -0,0 +1,122 @@
+#include "executor.h"
+
+#include <iostream>
+
+#include "trace.h"
+
+RequestExecutor::RequestExecutor(size_t readerThreads)
+{
+    if (readerThreads == 0)
+        readerThreads = 1;
+
+    for (size_t i = 0; i < readerThreads; ++i)
+        readers.emplace_back(&RequestExecutor::readerLoop, this);
+    writer = std::thread(&RequestExecutor::writerLoop, this);
+}
+
+RequestExecutor::~RequestExecutor()
+{
+    drain();
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        stopping = true;
+    }
+    workReady.notify_all();
+
+    for (auto& t : readers)
+        t.join();
+    writer.join();
+}
+
+void RequestExecutor::submitRead(std::function<void()> task)
+{
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        reads.push_back(ReadTask{std::move(task), writesSubmitted});
+        ++inFlight;
+    }
+    workReady.notify_all();
+}
+
+void RequestExecutor::submitWrite(std::function<void()> task)
+{
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        writes.push_back(std::move(task));
+        ++writesSubmitted;
+        ++inFlight;
+    }
+    workReady.notify_all();
+}
+
+void RequestExecutor::drain()
+{
+    std::unique_lock<std::mutex> lock(queueMutex);
+    progress.wait(lock, [this] { return inFlight == 0; });
+}
+
+// A throwing task must not skip finished(), or drain() would never return
+void RequestExecutor::runGuarded(const std::function<void()>& task)
+{
+    try {
+        task();
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+    } catch (...) {
+        std::cerr << "Error: unknown exception in request task" << std::endl;
+    }
+}
+
+void RequestExecutor::finished(bool wasWrite)
+{
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        if (wasWrite)
+            ++writesCompleted;
+        --inFlight;
+    }
+    progress.notify_all();
+}
+
+void RequestExecutor::readerLoop()
+{
+    Tracer::nameThread("reader");
+    for (;;)
+    {
+        ReadTask task;
+        {
+            std::unique_lock<std::mutex> lock(queueMutex);
+            workReady.wait(lock, [this] { return stopping || !reads.empty(); });
+            if (reads.empty())
+                return;     // stopping and nothing left
+            task = std::move(reads.front());
+            reads.pop_front();
+
+            // Read-your-writes: wait for the writes queued ahead of this read
+            progress.wait(lock, [&] { return writesCompleted >= task.afterWrite; });
+        }
+
+        runGuarded(task.run);
+        finished(false);
+    }
+}
+
+void RequestExecutor::writerLoop()
+{
+    Tracer::nameThread("writer");
+    for (;;)
+    {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(queueMutex);
+            workReady.wait(lock, [this] { return stopping || !writes.empty(); });
+            if (writes.empty())
+                return;
+            task = std::move(writes.front());
+            writes.pop_front();
+        }
+
+        runGuarded(task);
+        finished(true);
+    }
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Runs requests off the main thread.
+//
+// Read-only requests run concurrently on a pool of reader threads, each on
+// its own catalog snapshot (library::snapshot), so they never wait for a
+// write in progress; writes run one at a time on a single writer thread,
+// which is what library requires of its mutations. A read never starts
+// before every write submitted ahead of it has finished, so a client always
+// sees its own writes. Responses go out as each task completes, i.e.
+// possibly out of order.
+class RequestExecutor
+{
+    private:
+
+    struct ReadTask {
+        std::function<void()> run;
+        uint64_t afterWrite;    // writes that must complete first
+    };
+
+    std::mutex queueMutex;
+    std::condition_variable workReady;  // new task or shutdown
+    std::condition_variable progress;   // a task finished
+
+    std::deque<ReadTask> reads;
+    std::deque<std::function<void()>> writes;
+    uint64_t writesSubmitted = 0;
+    uint64_t writesCompleted = 0;
+    size_t inFlight = 0;                // submitted but not yet finished
+    bool stopping = false;
+
+    std::vector<std::thread> readers;
+    std::thread writer;
+
+    void readerLoop();
+    void writerLoop();
+    void finished(bool wasWrite);
+    static void runGuarded(const std::function<void()>& task);
+
+    public:
+
+    explicit RequestExecutor(size_t readerThreads);
+    ~RequestExecutor();
+
+    RequestExecutor(const RequestExecutor&) = delete;
+    RequestExecutor& operator=(const RequestExecutor&) = delete;
+
+    void submitRead(std::function<void()> task);
+    void submitWrite(std::function<void()> task);
+
+    // Blocks until everything submitted so far has finished
+    void drain();
+};
@@ -0,0 +1,98 @@
+// Writes a synthetic catalog into a new SQLite database (see catalog_gen.h).
+//
+// Usage: sem_project_focp_catalog_gen OUTPUT.db [--books N] [--members N]
+//                                     [--loans FRACTION] [--seed S]
+//                                     [--batch ROWS] [--snapshot] [--force]
+//
+//   --books N         books to generate (default 100000)
+//   --members N       members (default a tenth of the books)
+//   --loans FRACTION  share of the books out on loan (default 0.3)
+//   --seed S          same seed and sizes, same database (default 42)
+//   --batch ROWS      rows per transaction (default 50000)
+//   --snapshot        also save the catalog snapshot file next to it, as
+//                     the server does on shutdown
+//   --force           replace OUTPUT.db if it exists
+//
+// The result is an ordinary lms.db: the server opens it from its working
+// directory under that name.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "catalog_gen.h"
+#include "database.h"
+#include "library.h"
+
+int main(int argc, char* argv[])
+{
+    CatalogSpec spec;
+    spec.books = 100000;
+    bool membersSet = false, snapshot = false, force = false;
+    size_t batch = 50000;
+    std::string path;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--books" && i + 1 < argc) spec.books = std::stoul(argv[++i]);
+        else if (arg == "--members" && i + 1 < argc) { spec.members = std::stoul(argv[++i]); membersSet = true; }
+        else if (arg == "--loans" && i + 1 < argc) spec.loanFraction = std::stod(argv[++i]);
+        else if (arg == "--seed" && i + 1 < argc) spec.seed = static_cast<uint32_t>(std::stoul(argv[++i]));
+        else if (arg == "--batch" && i + 1 < argc) batch = std::stoul(argv[++i]);
+        else if (arg == "--snapshot") snapshot = true;
+        else if (arg == "--force") force = true;
+        else if (arg.rfind("--", 0) == 0 || !path.empty()) {
+            std::cerr << "Unknown argument: " << arg << std::endl;
+            return 2;
+        }
+        else path = arg;
+    }
+    if (path.empty()) {
+        std::cerr << "Usage: sem_project_focp_catalog_gen OUTPUT.db [--books N] [--members N] [--loans FRACTION]"
+                     " [--seed S] [--batch ROWS] [--snapshot] [--force]" << std::endl;
+        return 2;
+    }
+    if (!membersSet)
+        spec.members = std::max<size_t>(1, spec.books / 10);
+
+    if (std::ifstream(path).good()) {
+        if (!force) {
+            std::cerr << path << " exists; pass --force to replace it" << std::endl;
+            return 1;
+        }
+        // A stale snapshot or loan log would describe the old catalog
+        for (const char* suffix : {"", ".snap", ".loans"})
+            std::remove((path + suffix).c_str());
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    GeneratedCatalog catalog = generateCatalog(spec);
+    auto generated = std::chrono::steady_clock::now();
+
+    sqlite3* db = nullptr;
+    openDatabase(db, path);
+    // A half-written file is simply generated again, so skip the syncs
+    sqlite3_exec(db, "PRAGMA synchronous = OFF;", nullptr, nullptr, nullptr);
+    bool ok = writeCatalog(db, catalog, batch);
+    closeDatabase(db);
+    auto written = std::chrono::steady_clock::now();
+    if (!ok) {
+        std::cerr << "Failed to write " << path << std::endl;
+        return 1;
+    }
+
+    auto ms = [](std::chrono::steady_clock::time_point a, std::chrono::steady_clock::time_point b) {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(b - a).count();
+    };
+    std::cerr << "Wrote " << catalog.books.size() << " books, " << catalog.members.size() << " members and "
+              << catalog.loans.size() << " loans to " << path << " (seed " << spec.seed << "): generated in "
+              << ms(start, generated) << " ms, written in " << ms(generated, written) << " ms" << std::endl;
+
+    if (snapshot && !library(path).saveSnapshot()) {
+        std::cerr << "Failed to save the snapshot file for " << path << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,150 @@
+// Known-answer tests for password hashing (see passwordhash.h).
+//
+// Usage: sem_project_focp_hashcheck [test...]
+//
+//   vectors     PBKDF2-HMAC-SHA256 and scrypt against the test vectors of
+//               RFC 7914, sections 11 and 12. The last scrypt vector
+//               (N = 2^20, 1 GiB) is left out.
+//   passwords   hashPassword and verifyPassword: the stored form, wrong
+//               passwords, rehashing at another cost or from plaintext, and
+//               refusing malformed or oversized parameters.
+//
+// Prints one line per test and exits non-zero if any check failed.
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "passwordhash.h"
+
+namespace {
+
+std::string hex(const std::vector<uint8_t>& bytes)
+{
+    static const char digits[] = "0123456789abcdef";
+    std::string out;
+    for (uint8_t b : bytes) {
+        out += digits[b >> 4];
+        out += digits[b & 15];
+    }
+    return out;
+}
+
+std::vector<uint8_t> bytesOf(const std::string& s)
+{
+    return std::vector<uint8_t>(s.begin(), s.end());
+}
+
+struct Checks {
+    const char* test;
+    int failures = 0;
+
+    explicit Checks(const char* name) : test(name) {}
+
+    void expect(bool ok, const std::string& what)
+    {
+        if (ok)
+            return;
+        ++failures;
+        std::cerr << test << ": " << what << std::endl;
+    }
+
+    int report(int checks) const
+    {
+        std::cout << test << ": " << (failures ? "FAIL" : "OK") << " checks=" << checks
+                  << " failures=" << failures << std::endl;
+        return failures ? 1 : 0;
+    }
+};
+
+int testVectors()
+{
+    Checks c("vectors");
+
+    // RFC 7914, 11: PBKDF2-HMAC-SHA256, P = "passwd", S = "salt", c = 1
+    std::vector<uint8_t> salt = bytesOf("salt");
+    std::vector<uint8_t> out(64);
+    pbkdf2Sha256("passwd", salt.data(), salt.size(), out.data(), out.size());
+    c.expect(hex(out) == "55ac046e56e3089fec1691c22544b605f94185216dde0465e68b9d57c20dacbc"
+                         "49ca9cccf179b645991664b39d77ef317c71b845b1e30bd509112041d3a19783",
+             "PBKDF2 passwd/salt: " + hex(out));
+
+    // RFC 7914, 12
+    struct Vector {
+        const char* password;
+        const char* salt;
+        uint64_t N;
+        uint32_t r, p;
+        const char* expected;
+    };
+    const Vector vectors[] = {
+        {"", "", 16, 1, 1,
+         "77d6576238657b203b19ca42c18a0497f16b4844e3074ae8dfdffa3fede21442"
+         "fcd0069ded0948f8326a753a0fc81f17e8d3e0fb2e0d3628cf35e20c38d18906"},
+        {"password", "NaCl", 1024, 8, 16,
+         "fdbabe1c9d3472007856e7190d01e9fe7c6ad7cbc8237830e77376634b373162"
+         "2eaf30d92e22a3886ff109279d9830dac727afb94a83ee6d8360cbdfa2cc0640"},
+        {"pleaseletmein", "SodiumChloride", 16384, 8, 1,
+         "7023bdcb3afd7348461c06cd81fd38ebfda8fbba904f8e3ea9b543f6545da1f2"
+         "d5432955613f0fcf62d49705242a9af9e61e85dc0d651e40dfcf017b45575887"},
+    };
+    for (const auto& v : vectors) {
+        std::vector<uint8_t> s = bytesOf(v.salt);
+        scrypt(v.password, s.data(), s.size(), v.N, v.r, v.p, out.data(), out.size());
+        c.expect(hex(out) == v.expected,
+                 std::string("scrypt \"") + v.password + "\" N=" + std::to_string(v.N) + ": " + hex(out));
+    }
+    return c.report(1 + 3);
+}
+
+int testPasswords()
+{
+    Checks c("passwords");
+    const int cost = MIN_HASH_COST;
+    bool rehash = true;
+
+    std::string stored = hashPassword("correct horse", cost);
+    c.expect(stored.compare(0, 22, "$scrypt$ln=10,r=8,p=1$") == 0 && stored.size() == 22 + 32 + 1 + 64,
+             "stored form: " + stored);
+    c.expect(hashPassword("correct horse", cost) != stored, "two hashes of one password share a salt");
+    c.expect(verifyPassword("correct horse", stored, cost, rehash) && !rehash, "right password refused");
+    c.expect(!verifyPassword("correct horsf", stored, cost, rehash) && !rehash, "wrong password accepted");
+    c.expect(!verifyPassword("", stored, cost, rehash), "empty password accepted");
+
+    // Another --auth-cost: still valid, but to be hashed again
+    c.expect(verifyPassword("correct horse", stored, cost + 1, rehash) && rehash, "no rehash after a cost change");
+
+    // Plaintext from before hashing: matched once, then rehashed
+    c.expect(verifyPassword("legacy", "legacy", cost, rehash) && rehash, "plaintext password refused");
+    c.expect(!verifyPassword("legacy", "legacz", cost, rehash) && !rehash, "wrong plaintext password accepted");
+
+    // Malformed, or parameters needing more than 1 GiB
+    std::string salt(32, '0'), hash(64, '0');
+    c.expect(!verifyPassword("x", "$scrypt$ln=10,r=8$" + salt + "$" + hash, cost, rehash), "missing p accepted");
+    c.expect(!verifyPassword("x", "$scrypt$ln=10,r=8,p=1$" + salt + "$" + hash.substr(2), cost, rehash),
+             "short hash accepted");
+    c.expect(!verifyPassword("x", "$scrypt$ln=20,r=16,p=1$" + salt + "$" + hash, cost, rehash),
+             "2 GiB parameters accepted");
+    return c.report(11);
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    std::vector<std::string> tests(argv + 1, argv + argc);
+    if (tests.empty())
+        tests = {"vectors", "passwords"};
+
+    int failed = 0;
+    for (const auto& name : tests) {
+        if (name == "vectors") failed += testVectors();
+        else if (name == "passwords") failed += testPasswords();
+        else {
+            std::cerr << "Unknown test: " << name << std::endl;
+            return 2;
+        }
+    }
+    return failed ? 1 : 0;
+}
@@ -2,10 +2,30 @@
 #include <iostream>
 #include <algorithm>
 #include <cctype>
+#include <chrono>
+#include <iomanip>
+#include <random>
+#include <sstream>
+#include <unordered_map>
 #include "database.h"
+#include "snapshotfile.h"
+#include "stringpool.h"
+#include "trace.h"
 #include "external/sqlite/sqlite3.h"
 
 static const char* DB_PATH = "lms.db";
+static const char* SNAPSHOT_SUFFIX = ".snap";   // lms.db -> lms.db.snap
+static const char* LOAN_LOG_SUFFIX = ".loans";  // lms.db -> lms.db.loans
+
+static long long millisecondsSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+static double millisecondsBetween(std::chrono::steady_clock::time_point from, std::chrono::steady_clock::time_point to)
+{
+    return std::chrono::duration<double, std::milli>(to - from).count();
+}
 
 std::string library::toLower(const std::string& s) const
 {
@@ -15,80 +35,163 @@ std::string library::toLower(const std::string& s) const
     return result;
 }
 
-int library::countBooksByGenreRecursive(Genre genre, size_t index) const {
-    const auto& books = getBooks(); // your existing getter
-    if (index >= books.size()) return 0; // base case: no more books
-    int count = (books[index].getGenre() == genre) ? 1 : 0;
-    return count + countBooksByGenreRecursive(genre, index + 1); // recursive call
+// PRIVATE HELPER: start the next catalog version (shares all chunks with the current one)
+std::shared_ptr<Catalog> library::beginEdit() const
+{
+    return std::make_shared<Catalog>(*snapshot());
 }
 
-// PRIVATE HELPER: find a book by ID
-book* library::findBook(int bookID)
+// PRIVATE HELPER: wait for our turn to edit
+std::unique_lock<std::mutex> library::lockEdits()
 {
-    for (auto& b : books)       // Range-Based for loop for fetching every book stored in the books vector
-    {
-        if (b.getID() == bookID)    // If the ID of b = the ID in the query, address of b will be returned
-            return &b;
-    }
-    return nullptr;
+    TraceSpan span("library", "waitEditLock");
+    return std::unique_lock<std::mutex>(editMutex);
 }
 
-// PRIVATE HELPER: find a member by ID
-member* library::findMember(int memberID) // Range-Based for loop for fetching every book stored in the books vector
+// PRIVATE HELPER: make `next` the current catalog
+void library::publish(std::shared_ptr<Catalog> next)
 {
-    for (auto& m : members)
-    {
-        if (m.getID() == memberID)   // If the ID of b = the ID in the query, address of b will be returned
-            return &m;
+    TraceSpan span("library", "publish");
+    next->version = getVersion();
+    next->seal();
+    std::atomic_store(&current, std::shared_ptr<const Catalog>(std::move(next)));
+}
+
+// PRIVATE HELPER: write one mutation to the database
+void library::persist(PersistOp op)
+{
+    TraceSpan span("library", "persist");
+    if (writeBehind) {
+        writeBehind->push(std::move(op));
+        return;
     }
-    return nullptr;
+    beginTransaction(db);
+    for (const auto& step : op)
+        step.run(db);
+    commitTransaction(db);
 }
-const member* library::findMember(int memberID) const// Range-Based for loop for fetching every book stored in the books vector
+
+// PRIVATE HELPER: add to the loan history, compacting it now and then
+void library::logLoan(LoanAction action, int bookID, int memberID)
 {
-    for (auto& m : members)
+    if (loanLog.append(action, bookID, memberID))
+        compactLoanHistory();
+}
+
+// PRIVATE HELPER: move the loan log into SQLite
+void library::compactLoanHistory()
+{
+    flushWrites();  // an in-memory database shares its one connection with the writer
+    loanLog.compact();
+}
+
+std::shared_ptr<const Catalog> library::snapshot() const
+{
+    waitReady();
+    return std::atomic_load(&current);
+}
+
+// PRIVATE HELPER: block until the catalog has loaded (see library::open)
+void library::waitReady() const
+{
+    if (ready.load(std::memory_order_acquire))
+        return;
+    std::unique_lock<std::mutex> lock(readyMutex);
+    readyCv.wait(lock, [this] { return ready.load(std::memory_order_acquire); });
+}
+
+std::vector<MemoryItem> library::memoryUsage() const
+{
+    std::vector<MemoryItem> items;
+    snapshot()->memoryUsage(items);
+    StringPool::global().memoryUsage(items);
+    items.push_back(bookStates.memoryUsage());
     {
-        if (m.getID() == memberID)   // If the ID of b = the ID in the query, address of b will be returned
-            return &m;
+        std::lock_guard<std::mutex> lock(changeMutex);
+        MemoryItem changes;
+        changes.name = "changeLog";
+        changes.count = changeLog.size();
+        changes.used = changeLog.size() * sizeof(CatalogChange);
+        changes.reserved = changeLog.capacity() * sizeof(CatalogChange);
+        items.push_back(changes);
     }
-    return nullptr;
+    items.push_back(loanLog.memoryUsage());
+    recommender.memoryUsage(items);
+    return items;
 }
 
+std::vector<StartupPhase> library::startupPhases() const
+{
+    waitReady();
+    return phases;
+}
 
 // PUBLIC: check out a book
 bool library::checkOutBook(int bookID, int memberID)
 {
-    book* b = findBook(bookID);
-    member* m = findMember(memberID);
-
-    if (!b || !m)
-        return false;  // not found
-
-    if (b->getBorrowStatus())      // b is a pointer storing address of the book, "->" is used to access members of an object
-        return false;  // book already borrowed
+    TraceSpan span("library", "checkOutBook");
+    {
+        auto snap = snapshot();
+        if (!snap->findBook(bookID) || !snap->findMember(memberID))
+            return false;  // not found
+    }
+    // Claim the copy: of two desks issuing it at once only one gets past here
+    if (!bookStates.begin(bookID, 0, memberID))
+        return false;  // book already borrowed (or being checked out or returned)
+
+    auto lock = lockEdits();
+    auto next = beginEdit();
+    book* b = next->books.edit(bookID);
+    member* m = next->members.edit(memberID);
+
+    if (!b || !m || b->getBorrowStatus()) {     // b is a pointer storing address of the book, "->" is used to access members of an object
+        // deleted since the claim: the catalog has the last word
+        bookStates.finish(bookID, (b && b->getBorrowStatus()) ? b->getIssuedTo() : 0);
+        return false;
+    }
 
     // mark as borrowed
     b->modifyBorrowStatus(true);
     b->setIssuedTo(memberID);
     m->borrowBook(bookID);
     // persist changes
-    updateBookStatus(db, *b);
-    updateMemberBorrow(db, memberID, bookID);
+    book status = *b;
+    persist({
+        {bookStatusKey(bookID), [status](sqlite3* conn) { updateBookStatus(conn, status); }},
+        {memberBorrowKey(memberID), [memberID, bookID](sqlite3* conn) { updateMemberBorrow(conn, memberID, bookID); }},
+        {0, [bookID, memberID](sqlite3* conn) { insertLoan(conn, bookID, memberID); }},
+    });
+    logLoan(LoanAction::checkout, bookID, memberID);
+    recommender.recordCheckout(memberID, bookID, status.getGenre());
+    recordChange(ChangeKind::bookStatus, bookID);
+    recordChange(ChangeKind::memberUpdated, memberID);
+    publish(std::move(next));
+    bookStates.finish(bookID, memberID);
     return true;
 }
 
 // PUBLIC: return a book
 bool library::returnBook(int bookID, int memberID)
 {
-    book* b = findBook(bookID);
-    member* m = findMember(memberID);
-
-    if (!b || !m)
-        return false;  // missing
-
-    if (!b->getBorrowStatus())
-        return false; // book is not borrowed
-    if (b->getIssuedTo()==0)
-        return false; // book isn't borrowed
+    TraceSpan span("library", "returnBook");
+    {
+        auto snap = snapshot();
+        if (!snap->findBook(bookID) || !snap->findMember(memberID))
+            return false;  // missing
+    }
+    // Only the holder can move the book back to the shelf
+    if (!bookStates.begin(bookID, memberID, 0))
+        return false;  // book is not borrowed, or out to someone else
+
+    auto lock = lockEdits();
+    auto next = beginEdit();
+    book* b = next->books.edit(bookID);
+    member* m = next->members.edit(memberID);
+
+    if (!b || !m || !b->getBorrowStatus() || b->getIssuedTo() != memberID) {
+        bookStates.finish(bookID, (b && b->getBorrowStatus()) ? b->getIssuedTo() : 0);
+        return false;
+    }
 
     // mark as returned
     b->modifyBorrowStatus(false);
@@ -96,8 +199,18 @@ bool library::returnBook(int bookID, int memberID)
     b->setIssuedTo(0);
 
     // persist changes
-    updateBookStatus(db, *b);
-    updateMemberBorrow(db, memberID, 0);
+    book status = *b;
+    int latest = m->getBorrowedBookID();
+    persist({
+        {bookStatusKey(bookID), [status](sqlite3* conn) { updateBookStatus(conn, status); }},
+        {memberBorrowKey(memberID), [memberID, latest](sqlite3* conn) { updateMemberBorrow(conn, memberID, latest); }},
+        {0, [bookID](sqlite3* conn) { deleteLoan(conn, bookID); }},
+    });
+    logLoan(LoanAction::returned, bookID, memberID);
+    recordChange(ChangeKind::bookStatus, bookID);
+    recordChange(ChangeKind::memberUpdated, memberID);
+    publish(std::move(next));
+    bookStates.finish(bookID, 0);
     return true;
 }
 
@@ -105,108 +218,125 @@ bool library::returnBook(int bookID, int memberID)
 void library::addBook(const std::string& title, const std::string& ISBN, const std::string& author,
                         Genre genre, const std::string& coverUrl)
 {
+    TraceSpan span("library", "addBook");
+    auto lock = lockEdits();
+    // before the insert: while the catalog is loading the new row could be read twice
+    auto next = beginEdit();
     // create book object (issuedTo = 0)
     book b(title, ISBN, author, genre, 0);
     b.setCoverUrl(coverUrl);
-    // insert into DB and get assigned ID
-    int newId = insertBook(db, b);
-
-    if (newId > 0) {
-        // force set id on object then push
-        b.setID(newId);
+    if (writeBehind) {
+        // the row is written later, under the ID chosen now
+        b.setID(++lastBookID);
+        persist({{0, [b](sqlite3* conn) { insertBook(conn, b, true); }}});
+    } else {
+        // insert into DB and get assigned ID
+        int newId = insertBook(db, b);
+
+        if (newId > 0) {
+            // force set id on object then push
+            b.setID(newId);
+        }
     }
-    books.push_back(b);
+    next->books.insert(b);
+    recordChange(ChangeKind::bookAdded, b.getID());
+    publish(std::move(next));
 }
 
 // PUBLIC: add a new member
 void library::addMember(const std::string& name, const std::string& address, int BorrowedBookID /*= 0*/)
 {
+    TraceSpan span("library", "addMember");
+    auto lock = lockEdits();
+    auto next = beginEdit();    // see addBook
     member m(name, address, BorrowedBookID);
-    int newId = insertMember(db, m);
-    if (newId > 0) {
-        m.setID(newId);
+    if (writeBehind) {
+        m.setID(++lastMemberID);
+        persist({{0, [m](sqlite3* conn) { insertMember(conn, m, true); }}});
+    } else {
+        int newId = insertMember(db, m);
+        if (newId > 0) {
+            m.setID(newId);
+        }
     }
-    members.push_back(m);
+    next->members.insert(m);
+    recordChange(ChangeKind::memberAdded, m.getID());
+    publish(std::move(next));
 }
 
 // PUBLIC: delete a book
 void library::deleteBook(int bookID)
 {
-    // Remove from in-memory vector
-    auto it = std::find_if(books.begin(), books.end(),
-                          [bookID](const book& b) { return b.getID() == bookID; });
-    if (it != books.end()) {
-        books.erase(it);
+    TraceSpan span("library", "deleteBook");
+    auto lock = lockEdits();
+    auto next = beginEdit();
+    const book* b = next->findBook(bookID);
+    int holder = (b && b->getBorrowStatus()) ? b->getIssuedTo() : 0;
+
+    PersistOp op;
+    // A book on loan leaves its borrower's list too
+    if (member* m = holder ? next->members.edit(holder) : nullptr) {
+        m->returnBook(bookID);
+        int latest = m->getBorrowedBookID();
+        op.push_back({memberBorrowKey(holder), [holder, latest](sqlite3* conn) { updateMemberBorrow(conn, holder, latest); }});
+        recordChange(ChangeKind::memberUpdated, holder);
     }
+    op.push_back({0, [bookID](sqlite3* conn) { deleteLoan(conn, bookID); }});
+
+    // Remove from in-memory catalog
+    next->books.erase(bookID);
+    bookStates.reset(bookID, 0);
 
     // Delete from database
-    ::deleteBook(db, bookID);
+    op.push_back({0, [bookID](sqlite3* conn) { ::deleteBook(conn, bookID); }});
+    persist(std::move(op));
+    if (holder)
+        logLoan(LoanAction::returned, bookID, holder);
+    recordChange(ChangeKind::bookDeleted, bookID);
+    recommender.forgetBook(bookID);
+    publish(std::move(next));
 }
 
 // PUBLIC: delete a member
 void library::deleteMember(int memberID)
 {
-    // First, return all books borrowed by this member
-    for (auto& b : books) {
-        if (b.getIssuedTo() == memberID) {
-            b.setIssuedTo(0);  // Return the book
-            updateBookStatus(db, b);  // Update in database
+    TraceSpan span("library", "deleteMember");
+    auto lock = lockEdits();
+    auto next = beginEdit();
+
+    // First, return all books borrowed by this member: only the books on
+    // their loan list are touched, and the database releases them in one go
+    const member* m = next->findMember(memberID);
+    std::vector<int> held = m ? m->getLoans() : std::vector<int>();
+    for (int bookID : held) {
+        if (book* b = next->books.edit(bookID)) {
+            b->modifyBorrowStatus(false);  // Return the book
+            b->setIssuedTo(0);
+            bookStates.reset(bookID, 0);
+            recordChange(ChangeKind::bookStatus, bookID);
         }
     }
 
-    // Remove from in-memory vector
-    auto it = std::find_if(members.begin(), members.end(),
-                          [memberID](const member& m) { return m.getID() == memberID; });
-    if (it != members.end()) {
-        members.erase(it);
-    }
+    // Remove from in-memory catalog
+    next->members.erase(memberID);
 
     // Delete from database
-    ::deleteMember(db, memberID);
-}
-
-// PUBLIC: search books by title or author
-std::vector<const book*> library::searchBook(const std::string& query) const
-{
-    std::vector<const book*> results;
-
-    std::string lowerQuery = toLower(query);
-
-    for (const auto& b : books)
-    {
-        std::string title = toLower(b.getTitle()), author = toLower(b.getAuthor()), ISBN = toLower(b.getISBN());
-        if (title.find(lowerQuery) != std::string::npos ||
-            author.find(lowerQuery) != std::string::npos ||
-            ISBN.find(lowerQuery) != std::string::npos)
-        {
-            results.push_back(&b);
-        }
-    }
-    return results;
-}
-
-// PUBLIC: search for a member by ID
-std::vector <const member*> library::searchMember(const std::string& query) const
-{
-    std::string lowerQuery = toLower(query);
-    std::vector<const member*> results;
-
-    for (const auto& m : members)
-    {
-        std::string name = toLower(m.getName()), address = toLower(m.getAddress());
-        if (name.find(lowerQuery) != std::string::npos ||
-            address.find(lowerQuery) != std::string::npos)
-        {
-            results.push_back(&m);
-        }
-    }
-    return results;
+    persist({
+        {0, [memberID](sqlite3* conn) { releaseMemberLoans(conn, memberID); }},
+        {0, [memberID](sqlite3* conn) { ::deleteMember(conn, memberID); }},
+    });
+    for (int bookID : held)
+        logLoan(LoanAction::returned, bookID, memberID);
+    recordChange(ChangeKind::memberDeleted, memberID);
+    recommender.forgetMember(memberID);
+    publish(std::move(next));
 }
 
 // PUBLIC: display all books
 void library::displayBooks() const
 {
-    for (const auto& b : books)
+    auto snap = snapshot();
+    for (const auto& b : snap->books)
     {
         std::cout << "ID: " << b.getID()
                   << ", Title: " << b.getTitle()
@@ -221,7 +351,8 @@ void library::displayBooks() const
 // PUBLIC: display all members
 void library::displayMembers() const
 {
-    for (const auto& m : members)
+    auto snap = snapshot();
+    for (const auto& m : snap->members)
     {
         std::cout << "ID: " << m.getID()
                   << ", Name: " << m.getName()
@@ -233,34 +364,24 @@ void library::displayMembers() const
 // PUBLIC: display books borrowed by a specific member
 void library::displayBorrowedBooks(int memberID) const
  {
-    const member* m = findMember(memberID);
+    auto snap = snapshot();
+    const member* m = snap->findMember(memberID);
     if (!m)
     {
         std::cout << "Member not found.\n";
         return;
     }
 
-    int borrowed = m->getBorrowedBookID();
-
     std::cout << "Borrowed books for member " << m->getName() << ":\n";
 
-    if (borrowed == 0)
+    std::vector<const book*> held = snap->loansOf(memberID);
+    if (held.empty())
     {
         std::cout << "(none)\n";
         return;
     }
 
-    const book* b = nullptr;
-    for (const auto& bk : books)
-    {
-        if (bk.getID() == borrowed)
-        {
-            b = &bk;
-            break;
-        }
-    }
-
-    if (b)
+    for (const book* b : held)
     {
         std::cout << "ID: " << b->getID()
                   << ", Title: " << b->getTitle()
@@ -269,32 +390,292 @@ void library::displayBorrowedBooks(int memberID) const
     }
 }
 
-const std::vector<book>& library::getBooks() const
+// PRIVATE HELPER: bump the catalog version and remember what changed
+void library::recordChange(ChangeKind kind, int id)
 {
-    return books; // Return the books vector
+    std::lock_guard<std::mutex> lock(changeMutex);
+    ++version;
+    CatalogChange change{version, kind, id};
+
+    if (changeLog.size() < CHANGE_LOG_CAPACITY) {
+        changeLog.push_back(change);
+    } else {
+        changeLog[changeHead] = change;     // overwrite the oldest entry
+        changeHead = (changeHead + 1) % CHANGE_LOG_CAPACITY;
+    }
 }
-const std::vector<member>& library::getMembers() const
+
+int library::getVersion() const
 {
-    return members; // Return the members vector
+    std::lock_guard<std::mutex> lock(changeMutex);
+    return version;
+}
+
+// PUBLIC: changes in (since, upTo], oldest first
+bool library::changesSince(int since, int upTo, std::vector<CatalogChange>& out) const
+{
+    std::lock_guard<std::mutex> lock(changeMutex);
+    if (upTo > version)
+        upTo = version;
+    if (since > upTo)
+        return false;   // not a version we handed out
+
+    // The ring holds versions (version - size, version]; anything older is gone
+    int oldestKept = version - static_cast<int>(changeLog.size());
+    if (since < oldestKept)
+        return false;
+
+    size_t wanted = static_cast<size_t>(upTo - since);
+    if (wanted == 0)
+        return true;    // already up to date
+    size_t first = static_cast<size_t>(since - oldestKept);     // offset from the oldest entry
+    size_t oldest = changeLog.size() < CHANGE_LOG_CAPACITY ? 0 : changeHead;
+    for (size_t i = 0; i < wanted; ++i)
+        out.push_back(changeLog[(oldest + first + i) % changeLog.size()]);
+    return true;
+}
+
+void library::enableWriteBehind(const WriteBehindOptions& options)
+{
+    if (writeBehind)
+        return;
+    lastBookID = lastRowID(db, "books");
+    lastMemberID = lastRowID(db, "members");
+
+    // A file gets a connection of its own, so commits never hold up the
+    // main one; an in-memory database has only this one
+    sqlite3* conn = nullptr;
+    if (!openConnection(conn))
+        conn = db;
+    writeBehind.reset(new WriteBehindQueue(conn, conn != db, options));
+    std::cerr << "Write-behind on: up to " << options.maxLag.count() << " ms lag, "
+              << options.maxQueued << " queued mutations" << std::endl;
+}
+
+bool library::openConnection(sqlite3*& conn) const
+{
+    const char* file = sqlite3_db_filename(db, "main");
+    if (!file || !*file)
+        return false;
+    openDatabase(conn, file);
+    if (sqlite3_errcode(conn) != SQLITE_OK) {
+        closeDatabase(conn);
+        conn = nullptr;
+        return false;
+    }
+    sqlite3_busy_timeout(conn, 5000);
+    return true;
+}
+
+void library::flushWrites()
+{
+    if (writeBehind)
+        writeBehind->flush();
+}
+
+bool library::writeBehindStats(WriteBehindQueue::Stats& out) const
+{
+    if (!writeBehind)
+        return false;
+    out = writeBehind->stats();
+    return true;
+}
+
+bool library::saveSnapshot()
+{
+    TraceSpan span("library", "saveSnapshot");
+    waitReady();
+    auto lock = lockEdits();
+    // The file must match the database, so nothing still logged or queued
+    // may change it afterwards
+    compactLoanHistory();
+    uint64_t dataVersion = 0;
+    if (snapshotPath.empty() || !matchesDatabase || !readDataVersion(db, dataVersion))
+        return false;
+    if (dataVersion == snapshotVersion)
+        return true;    // nothing committed since the file was written
+
+    auto start = std::chrono::steady_clock::now();
+    auto snap = snapshot();
+    if (!saveSnapshotFile(snapshotPath, *snap, dataVersion))
+        return false;
+    snapshotVersion = dataVersion;
+    std::cerr << "Saved " << snap->books.size() << " books and " << snap->members.size()
+              << " members to " << snapshotPath << " in " << millisecondsSince(start) << " ms" << std::endl;
+    return true;
 }
 
 void library::clearData()
 {
-    books.clear();
-    members.clear();
+    waitReady();
+    auto lock = lockEdits();
+    matchesDatabase = false;
+    for (const auto& b : snapshot()->books)
+        if (b.getBorrowStatus())
+            bookStates.reset(b.getID(), 0);
+    recommender.clear();
+    auto empty = std::make_shared<Catalog>();
+    publish(std::move(empty));
 }
 
-// Constructor: open DB and load data
-library::library() {
-    openDatabase(db, DB_PATH);
+void library::open(const std::string& dbPath)
+{
+    auto start = std::chrono::steady_clock::now();
+    // Created ahead of the library so that it outlives it: the catalog and
+    // writes still queued at shutdown point into it
+    StringPool::global();
+    epoch = static_cast<int>(std::random_device{}() & 0x7fffffff);
+    openDatabase(db, dbPath);
+    // Loading holds read locks on other connections; let writes made
+    // meanwhile (register) wait for them instead of failing
+    sqlite3_busy_timeout(db, 5000);
     createBooksTable(db);
     createMembersTable(db);
+    createLoansTable(db);
     createUsersTable(db);
-    loadBooks(db, books);
-    loadMembers(db, members);
+
+    // An in-memory database exists only on this connection: load it here.
+    // A file loads in the background, split across threads given the cores.
+    const char* file = sqlite3_db_filename(db, "main");
+    bool onDisk = file && *file;
+    loanLog.open(db, onDisk ? dbPath + LOAN_LOG_SUFFIX : "");
+    phases.push_back({"open", millisecondsBetween(start, std::chrono::steady_clock::now())});
+
+    if (onDisk)
+        loader = std::thread(&library::loadCatalog, this, dbPath, std::thread::hardware_concurrency() > 1, start);
+    else
+        loadCatalog(dbPath, false, start);
+}
+
+// PRIVATE HELPER: fill and publish the first catalog version. With
+// `parallel`, books and members are read at the same time on their own
+// read connections, each side building its chunks and columns as well.
+void library::loadCatalog(const std::string& dbPath, bool parallel, std::chrono::steady_clock::time_point start)
+{
+    Tracer::nameThread("loader");
+    using clock = std::chrono::steady_clock;
+    auto loaded = std::make_shared<Catalog>();
+    auto lap = [](std::vector<StartupPhase>& out, const char* name, clock::time_point& since) {
+        auto now = clock::now();
+        out.push_back({name, millisecondsBetween(since, now)});
+        since = now;
+    };
+    std::vector<StartupPhase> steps;
+    auto t = clock::now();
+
+    // Map the snapshot file if it matches the database exactly
+    uint64_t dataVersion = 0;
+    bool mapped = false;
+    if (readDataVersion(db, dataVersion)) {
+        snapshotPath = dbPath + SNAPSHOT_SUFFIX;
+        std::string reason;
+        mapped = loadSnapshotFile(snapshotPath, dataVersion, *loaded, reason);
+        lap(steps, "snapshot", t);
+        if (mapped) {
+            snapshotVersion = dataVersion;
+            std::cerr << "Loaded " << loaded->books.size() << " books and " << loaded->members.size()
+                      << " members from " << snapshotPath << std::endl;
+        } else {
+            std::cerr << "Not using " << snapshotPath << ": " << reason << std::endl;
+        }
+    }
+
+    if (!mapped) {
+        // Runs `load` on a connection of its own when loading in parallel
+        auto withConnection = [this, &dbPath, parallel](auto load) {
+            sqlite3* conn = nullptr;
+            if (parallel && openReadConnection(conn, dbPath)) {
+                load(conn);
+                closeDatabase(conn);
+            } else {
+                load(db);
+            }
+        };
+
+        std::vector<StartupPhase> bookSteps;
+        auto loadBookSide = [&] {
+            auto bt = clock::now();
+            std::vector<book> books;
+            withConnection([&books](sqlite3* conn) { loadBooks(conn, books); });
+            lap(bookSteps, "books", bt);
+            loaded->books.assign(std::move(books));
+            loaded->books.seal();
+            lap(bookSteps, "book index", bt);
+        };
+        std::thread booksThread;
+        if (parallel)
+            booksThread = std::thread(loadBookSide);
+        else
+            loadBookSide();
+
+        size_t bookStepsAt = steps.size();
+        t = clock::now();
+        std::vector<member> members;
+        std::vector<Loan> loans;
+        withConnection([&members](sqlite3* conn) { loadMembers(conn, members); });
+        lap(steps, "members", t);
+        withConnection([&loans](sqlite3* conn) { loadLoans(conn, loans); });
+        lap(steps, "loans", t);
+
+        // The loans table is authoritative for who holds what
+        std::unordered_map<int, std::vector<int>> held;
+        for (const auto& loan : loans)
+            held[loan.memberID].push_back(loan.bookID);
+        for (auto& m : members) {
+            auto it = held.find(m.getID());
+            m.setLoans(it == held.end() ? std::vector<int>() : std::move(it->second));
+        }
+        loaded->members.assign(std::move(members));
+        lap(steps, "member index", t);
+
+        if (booksThread.joinable())
+            booksThread.join();
+        steps.insert(steps.begin() + static_cast<std::ptrdiff_t>(bookStepsAt), bookSteps.begin(), bookSteps.end());
+        std::cerr << "Loaded " << loaded->books.size() << " books and " << loaded->members.size()
+                  << " members from the database" << (parallel ? " (books and members in parallel)" : "") << std::endl;
+    }
+
+    // Recommendation statistics from the latest checkouts
+    for (const auto& e : loanLog.recentCheckouts(Recommender::REBUILD_CHECKOUTS))
+        if (const book* b = loaded->findBook(e.bookID))
+            recommender.recordCheckout(e.memberID, e.bookID, b->getGenre());
+    lap(steps, "recommendations", t);
+
+    for (const auto& b : loaded->books)
+        if (b.getBorrowStatus())
+            bookStates.reset(b.getID(), b.getIssuedTo());
+    publish(std::move(loaded));
+    phases.insert(phases.end(), steps.begin(), steps.end());
+    phases.push_back({"total", millisecondsBetween(start, clock::now())});
+
+    std::ostringstream report;
+    report << "Startup:";
+    for (size_t i = 0; i < phases.size(); ++i)
+        report << (i ? ", " : " ") << phases[i].name << " " << std::fixed << std::setprecision(1) << phases[i].ms << " ms";
+    std::cerr << report.str() << std::endl;
+
+    {
+        std::lock_guard<std::mutex> lock(readyMutex);
+        ready.store(true, std::memory_order_release);
+    }
+    readyCv.notify_all();
+}
+
+// Constructor: open DB and load data
+library::library() {
+    open(DB_PATH);
+}
+
+library::library(const std::string& dbPath) {
+    open(dbPath);
 }
 
 // Destructor: close DB
 library::~library() {
+    if (loader.joinable())
+        loader.join();
+    writeBehind.reset();    // commits what is still queued
+    loanLog.compact();
+    loanLog.close();
     closeDatabase(db);
-}
\ No newline at end of file
+}
@@ -1,35 +1,136 @@
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include "book.h"
+#include "bookstate.h"
 #include "member.h"
+#include "catalog.h"
 #include "database.h"
+#include "loanlog.h"
+#include "recommender.h"
+#include "writebehind.h"
 #include "external/sqlite/sqlite3.h"
 
+// What happened to which record (see library::changesSince)
+enum class ChangeKind {
+    bookAdded,
+    bookDeleted,
+    bookStatus,
+    memberAdded,
+    memberDeleted,
+    memberUpdated
+};
+
+struct CatalogChange {
+    int version;
+    ChangeKind kind;
+    int id;
+};
+
+// How long one step of opening the library took (see library::startupPhases)
+struct StartupPhase {
+    std::string name;
+    double ms;
+};
+
+// Number of changes kept for delta sync; clients further behind get a full snapshot
+const size_t CHANGE_LOG_CAPACITY = 4096;
+
 class library
 {
     private:
 
-    std::vector<book> books;
-    std::vector<member> members;
+    // Current catalog version. Readers take it with one atomic load
+    // (snapshot()); writers build the next version from it, sharing every
+    // chunk they don't touch, and publish it with one atomic store. Old
+    // versions are freed when their last reader lets go.
+    //
+    // Mutations may come from any thread; editMutex lets one edit at a
+    // time build and publish its version. Reads never take it.
+    std::shared_ptr<const Catalog> current;
+    std::mutex editMutex;
+
+    // Who holds each book. Checkout and return claim the book here with a
+    // compare-and-swap before queueing for editMutex, so a copy can't be
+    // issued twice and a desk asking for a book that is out is answered
+    // without waiting on other desks' edits.
+    BookStateTable bookStates;
     sqlite3* db = nullptr;
 
-    // Object-Pointer Return-Type (?)
+    // Catalog version: bumped on every add, delete or status change.
+    // The epoch changes per process so versions from an older run are never reused.
+    int version = 0;
+    int epoch = 0;
+    mutable std::mutex changeMutex;         // guards the change log and version
+    std::vector<CatalogChange> changeLog;   // ring buffer, CHANGE_LOG_CAPACITY entries
+    size_t changeHead = 0;                  // next slot to overwrite
+
+    void recordChange(ChangeKind kind, int id);
+
+    // Writer side: a private copy of the current catalog to edit, then publish it
+    std::shared_ptr<Catalog> beginEdit() const;
+    std::unique_lock<std::mutex> lockEdits();   // takes editMutex, traced
+    void publish(std::shared_ptr<Catalog> next);
+
+    // Catalog snapshot file next to the database ("" if unavailable, e.g. in memory)
+    std::string snapshotPath;
+    uint64_t snapshotVersion = 0;   // data version the file on disk was taken at
+    bool matchesDatabase = true;    // false after clearData(): never save that
+
+    // Startup: the constructor opens the database and returns; a file's
+    // catalog then loads on `loader` while requests that only need the
+    // database (login, register) are served. snapshot(), and with it every
+    // catalog read and write, waits until the first version is published.
+    std::thread loader;
+    std::atomic<bool> ready{false};
+    mutable std::mutex readyMutex;
+    mutable std::condition_variable readyCv;
+    std::vector<StartupPhase> phases;   // written before `ready` is set
+
+    // Write-behind persistence (see enableWriteBehind); null while every
+    // mutation commits before it returns
+    std::unique_ptr<WriteBehindQueue> writeBehind;
+    int lastBookID = 0;     // with write-behind, IDs are handed out here
+    int lastMemberID = 0;
+
+    // Persists one mutation as a single transaction: now, or queued
+    void persist(PersistOp op);
+
+    // Every checkout and return; the log sits next to the database file
+    LoanLog loanLog;
+    void logLoan(LoanAction action, int bookID, int memberID);
+    void compactLoanHistory();
+
+    // Co-borrow and genre statistics, fed by every checkout
+    Recommender recommender;
+
+    void open(const std::string& dbPath);
+    void loadCatalog(const std::string& dbPath, bool parallel, std::chrono::steady_clock::time_point start);
+    void waitReady() const;
 
     public:
 
-    book* findBook(int bookID);
-    member* findMember(int memberID);
-    const member* findMember(int memberID) const;
-
-
     // constructor / destructor to manage DB
     library();
+    explicit library(const std::string& dbPath);
     ~library();
 
-    // Transaction Functions: 
+    library(const library&) = delete;
+    library& operator=(const library&) = delete;
+
+    // The catalog as of now. Hold on to the pointer for as long as you use
+    // records or search results taken from it; later writes never change it.
+    std::shared_ptr<const Catalog> snapshot() const;
+
+    // Transaction Functions (safe to call from several threads at once):
 
     bool checkOutBook(int bookID, int memberID);
     bool returnBook(int bookID, int memberID);
@@ -44,25 +145,54 @@ class library
     void deleteBook(int bookID);
     void deleteMember(int memberID);
 
-    // Searching Functions:
-    std::vector<const book*> searchBook(const std::string& query) const;
-    std::vector <const member*> searchMember(const std::string& query) const;
-
     // Displaying Functions: 
 
     void displayBooks() const;
     void displayMembers() const;
     void displayBorrowedBooks(int memberID) const;
 
-    // Getting Functions:
-
-    const std::vector<book>& getBooks() const;
-    const std::vector<member>& getMembers() const;
     sqlite3* getDb() const { return db; }
-
+    // Another connection to the database file, for work on other threads
+    // that must stay out of the main connection's transactions and
+    // last-insert rowid; it waits out other connections' commits. False for
+    // an in-memory database, which only the main connection can see.
+    bool openConnection(sqlite3*& conn) const;
+    // Loan history queries; safe from any thread
+    const LoanLog& getLoanLog() const { return loanLog; }
+    // Recommendations; safe from any thread (pass it a snapshot)
+    const Recommender& getRecommender() const { return recommender; }
+
+    // Delta Sync:
+
+    int getVersion() const;
+    int getEpoch() const { return epoch; }
+    // Appends every change in (since, upTo] (oldest first); false if they are no
+    // longer all retained. Pass a snapshot's version as upTo to match its contents.
+    bool changesSince(int since, int upTo, std::vector<CatalogChange>& out) const;
+
+    // Writes the catalog to the snapshot file so the next start can map it
+    // instead of reading SQLite (see snapshotfile.h). Writes wait while it runs.
+    bool saveSnapshot();
+
+    // Write-behind: from now on mutations update the catalog and return,
+    // and a background thread commits them in batches (see writebehind.h).
+    // Call before the first mutation.
+    void enableWriteBehind(const WriteBehindOptions& options);
+    // Blocks until every mutation made so far is in the database
+    void flushWrites();
+    // False while mutations are synchronous
+    bool writeBehindStats(WriteBehindQueue::Stats& out) const;
+
+    // Heap held by each in-memory structure: the current catalog version
+    // (older ones still held by readers are not counted), the string pool,
+    // book states, change log, loan log and recommendation statistics
+    std::vector<MemoryItem> memoryUsage() const;
+
+    // Time spent in each startup step, in order; waits for loading to finish
+    std::vector<StartupPhase> startupPhases() const;
+
+    // Empties the in-memory catalog only (the database is untouched)
     void clearData();
     std::string toLower(const std::string& s) const;
 
-    int countBooksByGenreRecursive(Genre genre, size_t index = 0) const;
-
 };
\ No newline at end of file
@@ -0,0 +1,327 @@
+// Checks of the library against a database file, across restarts.
+//
+// Usage: sem_project_focp_librarycheck [test...]
+//
+//   snapshot    the catalog snapshot file: used when it matches the
+//               database, never once a commit made it stale (a write the
+//               file never saw, as after a crash)
+//   loanlog     the loan log replayed at startup: events not yet compacted
+//               come back, and compacting a second time after a crash
+//               between the commit and truncating the log adds nothing
+//   loans       loans and their history after a clean restart
+//   changes     changesSince: every change in order, the bounds, and
+//               refusing versions that fell out of the change log
+//   recommend   the recommender: co-borrowed books first, nothing on loan
+//               or lately borrowed, the most borrowed for anyone, and the
+//               same after a restart rebuilt it from the loan history
+//
+// Works on librarycheck.db* in the current directory (removed first).
+// Prints one line per test and exits non-zero if any check failed.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "database.h"
+#include "library.h"
+#include "loanlog.h"
+
+namespace {
+
+const std::string DB = "librarycheck.db";
+
+struct Checks {
+    const char* test;
+    int checks = 0;
+    int failures = 0;
+
+    explicit Checks(const char* name) : test(name) {}
+
+    void expect(bool ok, const std::string& what)
+    {
+        ++checks;
+        if (ok)
+            return;
+        ++failures;
+        std::cerr << test << ": " << what << std::endl;
+    }
+
+    int report() const
+    {
+        std::cout << test << ": " << (failures ? "FAIL" : "OK") << " checks=" << checks
+                  << " failures=" << failures << std::endl;
+        return failures ? 1 : 0;
+    }
+};
+
+void removeFiles()
+{
+    for (const char* suffix : {"", ".snap", ".loans", "-journal"})
+        std::remove((DB + suffix).c_str());
+}
+
+// Whether the last start read books from SQLite rather than the snapshot file
+bool loadedFromDatabase(const library& lib)
+{
+    for (const auto& phase : lib.startupPhases())
+        if (phase.name == "books")
+            return true;
+    return false;
+}
+
+std::vector<std::string> titles(const library& lib)
+{
+    auto snap = lib.snapshot();
+    std::vector<std::string> out;
+    for (const auto& b : snap->books)
+        out.emplace_back(b.getTitle());
+    return out;
+}
+
+std::string fileBytes(const std::string& path)
+{
+    std::ifstream in(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+int testSnapshot()
+{
+    Checks c("snapshot");
+    removeFiles();
+    {
+        library lib(DB);
+        lib.addBook("Dune", "isbn-1", "Herbert", Genre::fiction);
+        lib.addBook("Emma", "isbn-2", "Austen", Genre::romance);
+        lib.addMember("Ada", "Street 1");
+        c.expect(lib.checkOutBook(1, 1), "checkout refused");
+        c.expect(lib.saveSnapshot(), "snapshot not saved");
+    }
+    {
+        library lib(DB);
+        c.expect(!loadedFromDatabase(lib), "matching snapshot not used");
+        auto snap = lib.snapshot();
+        const book* dune = snap->findBook(1);
+        c.expect(snap->books.size() == 2 && snap->members.size() == 1 && dune && dune->getIssuedTo() == 1,
+                 "catalog from the snapshot differs");
+        // Committed, but gone before the snapshot is saved again
+        lib.addBook("Ulysses", "isbn-3", "Joyce", Genre::fiction);
+    }
+    {
+        library lib(DB);
+        c.expect(loadedFromDatabase(lib), "stale snapshot used");
+        c.expect(titles(lib) == std::vector<std::string>{"Dune", "Emma", "Ulysses"}, "write lost to a stale snapshot");
+        const book* dune = lib.snapshot()->findBook(1);
+        c.expect(dune && dune->getIssuedTo() == 1, "loan lost after a stale snapshot");
+        c.expect(lib.saveSnapshot(), "snapshot not saved again");
+    }
+    {
+        library lib(DB);
+        c.expect(!loadedFromDatabase(lib), "fresh snapshot not used");
+        c.expect(titles(lib) == std::vector<std::string>{"Dune", "Emma", "Ulysses"}, "fresh snapshot differs");
+    }
+    removeFiles();
+    return c.report();
+}
+
+int testLoanLog()
+{
+    Checks c("loanlog");
+    removeFiles();
+    const std::string logPath = DB + ".loans";
+    sqlite3* db = nullptr;
+    openDatabase(db, DB);
+
+    auto history = [](const LoanLog& log, int memberID) {
+        return log.memberHistory(memberID, 0, UINT32_MAX).size();
+    };
+    {
+        LoanLog log;
+        log.open(db, logPath, 1000);
+        log.append(LoanAction::checkout, 1, 7);
+        log.append(LoanAction::returned, 1, 7);
+        log.append(LoanAction::checkout, 2, 8);
+        log.close();    // as if the process died: nothing compacted
+    }
+    {
+        LoanLog log;
+        log.open(db, logPath, 1000);
+        c.expect(log.pending() == 3, "log not replayed: " + std::to_string(log.pending()) + " pending");
+        c.expect(history(log, 7) == 2 && history(log, 8) == 1, "replayed history differs");
+        auto recent = log.recentCheckouts(10);
+        c.expect(recent.size() == 2 && recent.back().bookID == 2, "recent checkouts differ after replay");
+
+        log.append(LoanAction::returned, 2, 8);
+        std::string beforeCompact = fileBytes(logPath);
+        log.compact();
+        c.expect(log.pending() == 0 && history(log, 8) == 2, "compaction lost events");
+        log.close();
+
+        // A crash after the commit but before the log was truncated
+        std::ofstream(logPath, std::ios::binary | std::ios::trunc) << beforeCompact;
+    }
+    {
+        LoanLog log;
+        log.open(db, logPath, 1000);
+        log.compact();
+        c.expect(history(log, 7) == 2 && history(log, 8) == 2, "second compaction duplicated events");
+        log.append(LoanAction::checkout, 3, 7);
+        c.expect(history(log, 7) == 3, "table and log not combined");
+        log.close();
+    }
+    closeDatabase(db);
+    removeFiles();
+    return c.report();
+}
+
+int testLoans()
+{
+    Checks c("loans");
+    removeFiles();
+    {
+        library lib(DB);
+        lib.addMember("Ada", "Street 1");
+        lib.addMember("Bob", "Street 2");
+        lib.addBook("Dune", "isbn-1", "Herbert", Genre::fiction);
+        lib.addBook("Emma", "isbn-2", "Austen", Genre::romance);
+        c.expect(lib.checkOutBook(1, 1) && lib.returnBook(1, 1) && lib.checkOutBook(1, 2) &&
+                 lib.checkOutBook(2, 2), "circulation refused");
+        c.expect(!lib.checkOutBook(1, 1), "book issued twice");
+    }
+    {
+        library lib(DB);
+        auto snap = lib.snapshot();
+        const member* bob = snap->findMember(2);
+        c.expect(bob && bob->getLoans().size() == 2 && snap->loansOf(2).size() == 2 && snap->loansOf(1).empty(),
+                 "loans lost on restart");
+        c.expect(!lib.checkOutBook(1, 1) && lib.returnBook(1, 2), "book states lost on restart");
+        c.expect(lib.getLoanLog().memberHistory(1, 0, UINT32_MAX).size() == 2 &&
+                 lib.getLoanLog().memberHistory(2, 0, UINT32_MAX).size() == 3, "loan history lost on restart");
+    }
+    removeFiles();
+    return c.report();
+}
+
+int testChanges()
+{
+    Checks c("changes");
+    library lib(":memory:");
+    int start = lib.getVersion();
+    lib.addBook("Dune", "isbn-1", "Herbert", Genre::fiction);
+    lib.addBook("Emma", "isbn-2", "Austen", Genre::romance);
+    lib.addMember("Ada", "Street 1");
+    lib.checkOutBook(2, 1);
+    lib.deleteBook(1);
+    int now = lib.getVersion();
+
+    std::vector<CatalogChange> changes;
+    c.expect(lib.changesSince(start, now, changes), "recent changes refused");
+    const ChangeKind expected[] = {ChangeKind::bookAdded, ChangeKind::bookAdded, ChangeKind::memberAdded,
+                                   ChangeKind::bookStatus, ChangeKind::memberUpdated, ChangeKind::bookDeleted};
+    const int ids[] = {1, 2, 1, 2, 1, 1};
+    bool inOrder = changes.size() == 6;
+    for (size_t i = 0; inOrder && i < changes.size(); ++i)
+        inOrder = changes[i].kind == expected[i] && changes[i].id == ids[i] &&
+                  changes[i].version == start + static_cast<int>(i) + 1;
+    c.expect(inOrder, "changes differ: " + std::to_string(changes.size()) + " of them");
+    c.expect(lib.snapshot()->version == now, "snapshot version differs from the library's");
+
+    changes.clear();
+    c.expect(lib.changesSince(start + 2, start + 4, changes) && changes.size() == 2 &&
+             changes[0].version == start + 3, "a range in the middle");
+    changes.clear();
+    c.expect(lib.changesSince(now, now, changes) && changes.empty(), "up to date, yet changes");
+    c.expect(!lib.changesSince(now + 1, now + 1, changes), "a future version accepted");
+
+    for (size_t i = 0; i <= CHANGE_LOG_CAPACITY; ++i)
+        lib.addMember("Member " + std::to_string(i), "Street");
+    changes.clear();
+    c.expect(!lib.changesSince(now, lib.getVersion(), changes), "a version no longer kept accepted");
+    c.expect(lib.changesSince(now + 1, lib.getVersion(), changes) && changes.size() == CHANGE_LOG_CAPACITY,
+             "the oldest version kept refused");
+    return c.report();
+}
+
+int testRecommend()
+{
+    Checks c("recommend");
+    removeFiles();
+    auto first = [](const library& lib, int memberID, RecommendReason& reason) {
+        auto snap = lib.snapshot();
+        auto picks = lib.getRecommender().recommend(*snap, memberID, 5);
+        if (picks.empty())
+            return 0;
+        reason = picks.front().reason;
+        return picks.front().b->getID();
+    };
+    auto borrow = [](library& lib, int bookID, int memberID) {
+        return lib.checkOutBook(bookID, memberID) && lib.returnBook(bookID, memberID);
+    };
+    {
+        library lib(DB);
+        for (int i = 1; i <= 4; ++i)
+            lib.addBook("Novel " + std::to_string(i), "isbn", "Author", Genre::fiction);
+        lib.addBook("Physics", "isbn", "Author", Genre::science);
+        for (int i = 1; i <= 3; ++i)
+            lib.addMember("Member " + std::to_string(i), "Street");
+
+        // Book 2 goes with book 1 twice, book 3 once
+        c.expect(borrow(lib, 1, 1) && borrow(lib, 2, 1) && borrow(lib, 1, 2) && borrow(lib, 2, 2) &&
+                 borrow(lib, 3, 2) && borrow(lib, 1, 3), "circulation refused");
+
+        RecommendReason reason = RecommendReason::available;
+        c.expect(first(lib, 3, reason) == 2 && reason == RecommendReason::coBorrowed,
+                 "book 2 not first for a reader of book 1");
+        auto snap = lib.snapshot();
+        auto picks = lib.getRecommender().recommend(*snap, 3, 5);
+        bool borrowedLately = false;
+        for (const auto& r : picks)
+            borrowedLately = borrowedLately || r.b->getID() == 1;
+        c.expect(!picks.empty() && !borrowedLately, "recommended what the member just read");
+        c.expect(lib.getRecommender().recommend(*snap, 3, 1).size() == 1, "count not respected");
+
+        c.expect(first(lib, 0, reason) == 1 && reason == RecommendReason::popular,
+                 "most borrowed book not first for anyone");
+
+        // On loan: not on the shelf, so not recommended
+        c.expect(lib.checkOutBook(2, 1), "checkout refused");
+        c.expect(first(lib, 3, reason) == 3, "a book on loan recommended");
+        c.expect(lib.returnBook(2, 1), "return refused");
+    }
+    {
+        library lib(DB);
+        RecommendReason reason = RecommendReason::available;
+        c.expect(first(lib, 3, reason) == 2 && reason == RecommendReason::coBorrowed,
+                 "statistics not rebuilt on restart");
+    }
+    removeFiles();
+    return c.report();
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    std::vector<std::string> tests(argv + 1, argv + argc);
+    if (tests.empty())
+        tests = {"snapshot", "loanlog", "loans", "changes", "recommend"};
+
+    int failed = 0;
+    for (const auto& name : tests) {
+        if (name == "snapshot") failed += testSnapshot();
+        else if (name == "loanlog") failed += testLoanLog();
+        else if (name == "loans") failed += testLoans();
+        else if (name == "changes") failed += testChanges();
+        else if (name == "recommend") failed += testRecommend();
+        else {
+            std::cerr << "Unknown test: " << name << std::endl;
+            return 2;
+        }
+    }
+    return failed ? 1 : 0;
+}
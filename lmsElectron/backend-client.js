@@ -4,41 +4,66 @@
  * Usage:
  *   const backend = new BackendClient(pathToExe);
  *   const books = await backend.call('listBooks');
+ *
+ * Pass { binary: true } to switch the connection to length-prefixed
+ * MessagePack frames right after startup (JSON lines are the default).
+ * { cwd } overrides the backend's working directory (where lms.db lives),
+ * { args } adds command-line flags (e.g. ['--workers', '4']).
+ * { socket } connects to a shared backend started with --listen instead
+ * of spawning a private one.
  */
 
 const { spawn } = require('child_process');
+const net = require('net');
 const path = require('path');
+const msgpack = require('./msgpack');
 
 class BackendClient {
-    constructor(exePath) {
+    constructor(exePath, options = {}) {
         this.exePath = exePath;
+        this.cwd = options.cwd;
+        this.args = options.args || [];
+        this.socketPath = options.socket || null;
+        this.connection = null;
+        this.output = null;        // writable side: child stdin or socket
         this.process = null;
         this.requestId = 0;
         this.pendingRequests = {};
         this.isReady = false;
+        this.token = null;         // session token from login(), sent with every call
+
+        // Wire protocol state
+        this.binary = false;
+        this.switching = null;     // promise while a setProtocol is in flight
+        this.switchId = null;
+        this.switchTo = null;
+        this.caches = {};          // delta-synced lists, see syncBooks()
+        this.chunks = [];          // unparsed stdout bytes
+        this.buffered = 0;
+        this.needed = 0;           // bytes required before a frame can complete
+
         this.initProcess();
+        if (options.binary) {
+            this.useBinaryProtocol().catch(err => {
+                console.error('Failed to enable binary protocol:', err);
+            });
+        }
     }
 
     initProcess() {
+        if (this.socketPath) {
+            this.initSocket();
+            return;
+        }
+
         // Set working directory to build/bin where the database should be
-        const workingDir = path.dirname(this.exePath);
-        this.process = spawn(this.exePath, [], { cwd: workingDir });
+        const workingDir = this.cwd || path.dirname(this.exePath);
+        this.process = spawn(this.exePath, this.args, { cwd: workingDir });
+        this.output = this.process.stdin;
         this.isReady = true;
 
         // Handle stdout (responses from backend)
-        this.process.stdout.on('data', (data) => {
-            const lines = data.toString().split('\n');
-            for (const line of lines) {
-                if (line.trim()) {
-                    try {
-                        const response = JSON.parse(line);
-                        this.handleResponse(response);
-                    } catch (e) {
-                        console.error('Failed to parse backend response:', line);
-                    }
-                }
-            }
-        });
+        this.process.stdout.on('data', (data) => this.onData(data));
 
         // Handle errors
         this.process.stderr.on('data', (data) => {
@@ -56,13 +81,116 @@ class BackendClient {
         });
     }
 
+    initSocket() {
+        // Writes issued before the connection is up are buffered by the socket
+        this.connection = net.createConnection(this.socketPath);
+        this.output = this.connection;
+        this.isReady = true;
+
+        this.connection.on('data', (data) => this.onData(data));
+
+        this.connection.on('error', (err) => {
+            console.error('Backend socket error:', err);
+            this.isReady = false;
+        });
+
+        this.connection.on('close', () => {
+            console.log('Backend connection closed');
+            this.isReady = false;
+        });
+    }
+
+    /**
+     * Buffer stdout until whole messages are available.
+     * A response may arrive split across several chunks (or several
+     * responses in one chunk), so never parse a chunk on its own.
+     */
+    onData(data) {
+        this.chunks.push(data);
+        this.buffered += data.length;
+
+        if (this.buffered < this.needed) return;
+        if (!this.binary && data.indexOf(0x0a) === -1) return;
+
+        const buf = this.chunks.length === 1 ? this.chunks[0] : Buffer.concat(this.chunks, this.buffered);
+        let offset = 0;
+        this.needed = 0;
+
+        while (offset < buf.length) {
+            let response;
+            if (this.binary) {
+                if (buf.length - offset < 4) {
+                    this.needed = 4;
+                    break;
+                }
+                const len = buf.readUInt32BE(offset);
+                if (buf.length - offset - 4 < len) {
+                    this.needed = 4 + len;
+                    break;
+                }
+                const payload = buf.subarray(offset + 4, offset + 4 + len);
+                offset += 4 + len;
+                try {
+                    response = msgpack.decode(payload);
+                    response.data = msgpack.expandTable(response.data);
+                } catch (e) {
+                    console.error('Failed to decode backend frame:', e);
+                    continue;
+                }
+            } else {
+                const nl = buf.indexOf(0x0a, offset);
+                if (nl === -1) break;
+                const line = buf.toString('utf8', offset, nl);
+                offset = nl + 1;
+                if (!line.trim()) continue;
+                try {
+                    response = JSON.parse(line);
+                } catch (e) {
+                    console.error('Failed to parse backend response:', line);
+                    continue;
+                }
+            }
+
+            // The setProtocol acknowledgement is the last message in the old mode
+            if (this.switchId !== null && response.id === this.switchId) {
+                if (response.success) this.binary = (this.switchTo === 'binary');
+                this.switchId = null;
+            }
+            this.handleResponse(response);
+        }
+
+        const rest = buf.subarray(offset);
+        this.chunks = rest.length ? [rest] : [];
+        this.buffered = rest.length;
+    }
+
+    /**
+     * Switch the connection to length-prefixed MessagePack frames.
+     * Calls made while the switch is in flight wait for it to finish.
+     */
+    useBinaryProtocol() {
+        return this.setProtocol('binary');
+    }
+
+    setProtocol(mode) {
+        const switched = this.call('setProtocol', { mode });
+        this.switching = switched.catch(() => {}).then(() => {
+            this.switching = null;
+        });
+        return switched;
+    }
+
     /**
      * Send a request to the backend and await the response
      * @param {string} method - RPC method name
      * @param {object} params - Method parameters
      * @returns {Promise} Resolves to the response data or rejects with error
      */
-    call(method, params = {}) {
+    call(method, params = {}, onChunk = null) {
+        if (this.switching && method !== 'setProtocol') {
+            return this.switching.then(() => this.call(method, params, onChunk));
+        }
+
         return new Promise((resolve, reject) => {
             if (!this.isReady) {
                 reject(new Error('Backend not ready'));
@@ -73,15 +201,19 @@ class BackendClient {
             const request = {
                 id,
                 method,
+                ...(this.token ? { token: this.token } : {}),
                 ...params
             };
 
             // Store the resolver/rejector
-            this.pendingRequests[id] = { resolve, reject };
+            this.pendingRequests[id] = { resolve, reject, onChunk };
+            if (method === 'setProtocol') {
+                this.switchId = id;
+                this.switchTo = params.mode;
+            }
 
             // Send to backend
-            const line = JSON.stringify(request) + '\n';
-            this.process.stdin.write(line, (err) => {
+            this.output.write(this.encodeRequest(request), (err) => {
                 if (err) {
                     delete this.pendingRequests[id];
                     reject(err);
@@ -98,6 +230,17 @@ class BackendClient {
         });
     }
 
+    encodeRequest(request) {
+        if (!this.binary) {
+            return JSON.stringify(request) + '\n';
+        }
+        const payload = msgpack.encode(request);
+        const frame = Buffer.alloc(4 + payload.length);
+        frame.writeUInt32BE(payload.length, 0);
+        payload.copy(frame, 4);
+        return frame;
+    }
+
     handleResponse(response) {
         const { id, success, data, error } = response;
         const handler = this.pendingRequests[id];
@@ -107,26 +250,95 @@ class BackendClient {
             return;
         }
 
+        // Chunks of a streamed list; the request stays pending until "end"
+        if (response.chunk !== undefined) {
+            if (handler.onChunk) handler.onChunk(data, response.chunk);
+            return;
+        }
+
         delete this.pendingRequests[id];
 
-        if (success) {
+        if (success && response.end) {
+            handler.resolve({ chunks: response.chunks, total: response.total });
+        } else if (success) {
             handler.resolve(data);
         } else {
             handler.reject(new Error(error || 'Backend error'));
         }
     }
 
+    /**
+     * Request a list as a sequence of chunks instead of one response.
+     * onChunk(rows, index) runs as each chunk arrives (rows already in the
+     * usual array-of-objects shape); resolves to { chunks, total } once the
+     * backend sends the closing "end" message.
+     */
+    stream(method, params, onChunk, chunkSize) {
+        const request = { ...params, stream: true };
+        if (chunkSize) request.chunkSize = chunkSize;
+        return this.call(method, request, onChunk);
+    }
+
+    streamBooks(onChunk, chunkSize) {
+        return this.stream('listBooks', {}, onChunk, chunkSize);
+    }
+
+    streamMembers(onChunk, chunkSize) {
+        return this.stream('listMembers', {}, onChunk, chunkSize);
+    }
+
     /**
      * Convenience methods
      */
-    listBooks() {
-        return this.call('listBooks');
+    // filter: optional { genre, available } to list only matching books
+    listBooks(filter = {}) {
+        return this.call('listBooks', filter);
     }
 
     listMembers() {
         return this.call('listMembers');
     }
 
+    listBooksSince(since, epoch) {
+        return this.call('listBooksSince', { since, epoch });
+    }
+
+    listMembersSince(since, epoch) {
+        return this.call('listMembersSince', { since, epoch });
+    }
+
+    /**
+     * Same result as listBooks()/listMembers(), but only the records that
+     * changed since the previous call cross the pipe.
+     */
+    syncBooks() {
+        return this.syncCache('books', 'listBooksSince');
+    }
+
+    syncMembers() {
+        return this.syncCache('members', 'listMembersSince');
+    }
+
+    async syncCache(name, method) {
+        if (!this.caches[name]) {
+            this.caches[name] = { epoch: 0, version: -1, byId: new Map() };
+        }
+        const cache = this.caches[name];
+        const delta = await this.call(method, { since: cache.version, epoch: cache.epoch });
+
+        // An overlapping sync already applied something newer
+        if (delta.epoch === cache.epoch && delta.version < cache.version) {
+            return Array.from(cache.byId.values());
+        }
+
+        if (delta.full) cache.byId = new Map();
+        for (const record of delta.changed) cache.byId.set(record.id, record);
+        for (const id of delta.deleted) cache.byId.delete(id);
+        cache.epoch = delta.epoch;
+        cache.version = delta.version;
+        return Array.from(cache.byId.values());
+    }
+
     addBook(title, isbn, author, genre, coverUrl = '') {
         return this.call('addBook', { title, isbn, author, genre, coverUrl });
     }
@@ -147,6 +359,67 @@ class BackendClient {
         return this.call('searchBooks', { query });
     }
 
+    // Books the member currently holds, oldest loan first
+    memberLoans(memberID) {
+        return this.call('memberLoans', { memberID });
+    }
+
+    // Up to `count` books on the shelf for the member, best first;
+    // memberID 0 gets the most borrowed ones
+    recommend(memberID = 0, count = 5) {
+        return this.call('recommend', { memberID, count });
+    }
+
+    // A member's checkouts and returns; from/to are optional Unix times in seconds
+    loanHistory(memberID, range = {}) {
+        return this.call('loanHistory', { memberID, ...range });
+    }
+
+    // Checkouts and returns per UTC day, e.g. loansPerDay({ from: weekAgo })
+    loansPerDay(range = {}) {
+        return this.call('loansPerDay', range);
+    }
+
+    // Resolves once every earlier write is in the database (matters with --write-behind)
+    flush() {
+        return this.call('flush', {});
+    }
+
+    // Per-method request counts and latency quantiles (µs); reset: true starts a new window
+    stats(reset = false) {
+        return this.call('stats', { reset });
+    }
+
+    // Time in SQLite per statement, most total time first; reset: true starts a new window
+    sqlStats(reset = false) {
+        return this.call('sqlStats', { reset });
+    }
+
+    // Signs in and keeps the session token, so later calls are accepted
+    // (with --require-auth) without sending the password again
+    async login(username, password) {
+        const result = await this.call('login', { username, password });
+        if (result && result.token) this.token = result.token;
+        return result;
+    }
+
+    logout() {
+        const token = this.token;
+        this.token = null;
+        return this.call('logout', { token });
+    }
+
+    // Bytes held per in-memory structure, plus SQLite and allocator totals
+    memoryStats() {
+        return this.call('memoryStats', {});
+    }
+
+    // Tracing on or off, and write: true saves the latest spans to the
+    // backend's --trace file (open it in Perfetto)
+    trace(enable, write = false) {
+        return this.call('trace', { enable, write });
+    }
+
     // searchMember can accept either a numeric memberID or a string query (name)
     searchMember(query) {
         if (typeof query === 'number' || (typeof query === 'string' && /^\d+$/.test(query))) {
@@ -159,6 +432,9 @@ class BackendClient {
     }
 
     close() {
+        if (this.connection) {
+            this.connection.end();
+        }
         if (this.process) {
             this.process.kill();
         }
@@ -0,0 +1,110 @@
+/**
+ * Round-trip throughput of listBooks: JSON lines vs binary frames
+ *
+ * Usage:
+ *   node bench/protocol-throughput.js [--exe path] [--books N] [--rounds R] [--dir path]
+ *
+ * Seeds a scratch lms.db with N books (skipped when --dir already holds a
+ * catalog of that size), then times R listBooks calls in each wire mode,
+ * including decode time on the JS side.
+ */
+
+const fs = require('fs');
+const os = require('os');
+const path = require('path');
+const BackendClient = require('../backend-client');
+
+function parseArgs() {
+    const args = {
+        exe: path.join(__dirname, '..', '..', 'build', 'bin',
+            process.platform === 'win32' ? 'sem_project_focp.exe' : 'sem_project_focp'),
+        books: 20000,
+        rounds: 10,
+        dir: null
+    };
+    const argv = process.argv.slice(2);
+    for (let i = 0; i < argv.length; i++) {
+        const next = argv[i + 1];
+        switch (argv[i]) {
+            case '--exe': args.exe = path.resolve(next); i++; break;
+            case '--books': args.books = parseInt(next, 10); i++; break;
+            case '--rounds': args.rounds = parseInt(next, 10); i++; break;
+            case '--dir': args.dir = path.resolve(next); i++; break;
+            default:
+                console.error(`Unknown argument: ${argv[i]}`);
+                process.exit(1);
+        }
+    }
+    return args;
+}
+
+const GENRES = ['fiction', 'nonfiction', 'fantasy', 'mystery', 'adventure', 'romance', 'science', 'history'];
+
+async function seed(client, count) {
+    const existing = (await client.listBooks()).length;
+    const batch = 500;
+    for (let i = existing; i < count; i += batch) {
+        const calls = [];
+        for (let j = i; j < Math.min(i + batch, count); j++) {
+            calls.push(client.addBook(`Benchmark Title ${j}`, `978${String(j).padStart(10, '0')}`,
+                `Author ${j % 997}`, GENRES[j % GENRES.length],
+                `https://covers.example.org/${j}.jpg`));
+        }
+        await Promise.all(calls);
+    }
+}
+
+async function measure(exe, dir, binary, rounds) {
+    const client = new BackendClient(exe, { cwd: dir, binary });
+    let bytes = 0;
+    client.process.stdout.on('data', (d) => { bytes += d.length; });
+
+    // Warm-up round (page cache, JIT)
+    let books = await client.listBooks();
+    bytes = 0;
+
+    const times = [];
+    for (let r = 0; r < rounds; r++) {
+        const start = process.hrtime.bigint();
+        books = await client.listBooks();
+        times.push(Number(process.hrtime.bigint() - start) / 1e6);
+    }
+    client.close();
+
+    times.sort((a, b) => a - b);
+    const mean = times.reduce((a, b) => a + b, 0) / times.length;
+    return {
+        mode: binary ? 'binary' : 'json',
+        books: books.length,
+        meanMs: mean,
+        p50Ms: times[Math.floor(times.length / 2)],
+        booksPerSec: books.length / (mean / 1000),
+        bytesPerCall: bytes / rounds
+    };
+}
+
+async function main() {
+    const args = parseArgs();
+    const dir = args.dir || fs.mkdtempSync(path.join(os.tmpdir(), 'lms-bench-'));
+
+    const seeder = new BackendClient(args.exe, { cwd: dir });
+    await seed(seeder, args.books);
+    seeder.close();
+
+    const results = [];
+    for (const binary of [false, true]) {
+        results.push(await measure(args.exe, dir, binary, args.rounds));
+    }
+
+    console.log(`listBooks round trip, ${results[0].books} books, ${args.rounds} rounds (${dir})`);
+    for (const r of results) {
+        console.log(`${r.mode.padEnd(7)} mean ${r.meanMs.toFixed(1)} ms  p50 ${r.p50Ms.toFixed(1)} ms  ` +
+            `${Math.round(r.booksPerSec)} books/s  ${(r.bytesPerCall / 1024).toFixed(0)} KiB/call`);
+    }
+    console.log(JSON.stringify(results));
+}
+
+main().catch((err) => {
+    console.error(err);
+    process.exit(1);
+});
@@ -0,0 +1,184 @@
+/**
+ * Multi-client load test for the socket server (--listen)
+ *
+ * Usage:
+ *   node bench/server-load.js [--exe path] [--clients C] [--requests R]
+ *                             [--window W] [--workers N] [--books N] [--dir path]
+ *
+ * Starts one backend on a Unix socket, connects C clients and has each keep
+ * W requests in flight until it has completed R: mostly searches, plus a
+ * checkout/return pair on a book only that client touches. Reports overall
+ * throughput and latency percentiles, then checks that every book ended up
+ * returned, i.e. no write was lost or interleaved between connections.
+ */
+
+const fs = require('fs');
+const os = require('os');
+const path = require('path');
+const { spawn } = require('child_process');
+const BackendClient = require('../backend-client');
+
+function parseArgs() {
+    const args = {
+        exe: path.join(__dirname, '..', '..', 'build', 'bin', 'sem_project_focp'),
+        clients: 16,
+        requests: 2000,
+        window: 8,
+        workers: 0,
+        books: 2000,
+        dir: null
+    };
+    const argv = process.argv.slice(2);
+    for (let i = 0; i < argv.length; i++) {
+        const next = argv[i + 1];
+        switch (argv[i]) {
+            case '--exe': args.exe = path.resolve(next); i++; break;
+            case '--clients': args.clients = parseInt(next, 10); i++; break;
+            case '--requests': args.requests = parseInt(next, 10); i++; break;
+            case '--window': args.window = parseInt(next, 10); i++; break;
+            case '--workers': args.workers = parseInt(next, 10); i++; break;
+            case '--books': args.books = parseInt(next, 10); i++; break;
+            case '--dir': args.dir = path.resolve(next); i++; break;
+            default:
+                console.error(`Unknown argument: ${argv[i]}`);
+                process.exit(1);
+        }
+    }
+    return args;
+}
+
+function startServer(exe, dir, socketPath, workers) {
+    const flags = ['--listen', socketPath];
+    if (workers > 0) flags.push('--workers', String(workers));
+    const server = spawn(exe, flags, { cwd: dir });
+
+    return new Promise((resolve, reject) => {
+        let log = '';
+        server.stderr.on('data', (data) => {
+            log += data.toString();
+            if (log.includes('Listening on')) resolve(server);
+        });
+        server.on('error', reject);
+        server.on('close', (code) => reject(new Error(`server exited (${code}): ${log}`)));
+    });
+}
+
+async function seed(client, books, members) {
+    const existing = await client.listBooks();
+    const calls = [];
+    for (let j = existing.length; j < books; j++) {
+        calls.push(client.addBook(`Load Title ${j}`, `979${String(j).padStart(10, '0')}`,
+            `Author ${j % 211}`, 'fiction', ''));
+    }
+    await Promise.all(calls);
+
+    const memberCount = (await client.listMembers()).length;
+    const adds = [];
+    for (let j = memberCount; j < members; j++) {
+        adds.push(client.addMember(`Load Member ${j}`, `${j} Socket Street`));
+    }
+    await Promise.all(adds);
+
+    return {
+        books: (await client.listBooks()).map(b => b.id),
+        members: (await client.listMembers()).map(m => m.id)
+    };
+}
+
+// One connection: keeps `window` requests in flight until `total` are done
+async function runClient(socketPath, index, ids, total, window, latencies) {
+    const client = new BackendClient(null, { socket: socketPath });
+    const ownBook = ids.books[index];
+    const member = ids.members[index];
+    let issued = 0;
+    let failures = 0;
+
+    function nextCall(n) {
+        // Every 10th request is a write, alternating checkout and return so
+        // the client's own book is returned by the time it finishes
+        if (n % 10 === 9) {
+            return (Math.floor(n / 10) % 2 === 0)
+                ? client.checkoutBook(ownBook, member)
+                : client.returnBook(ownBook, member);
+        }
+        if (n % 2 === 0) return client.searchBooks(`Title ${(n * 7 + index) % 500}`);
+        return client.searchMember(ids.members[(n + index) % ids.members.length]);
+    }
+
+    async function lane() {
+        while (issued < total) {
+            const n = issued++;
+            const start = process.hrtime.bigint();
+            try {
+                await nextCall(n);
+            } catch (err) {
+                failures++;     // the backend answered success: false
+            }
+            latencies.push(Number(process.hrtime.bigint() - start) / 1e6);
+        }
+    }
+
+    const lanes = [];
+    for (let w = 0; w < window; w++) lanes.push(lane());
+    await Promise.all(lanes);
+
+    // An odd number of write pairs leaves the book out; return it
+    if (Math.floor(total / 10) % 2 === 1) {
+        await client.returnBook(ownBook, member);
+    }
+    client.close();
+    return failures;
+}
+
+async function main() {
+    const args = parseArgs();
+    const dir = args.dir || fs.mkdtempSync(path.join(os.tmpdir(), 'lms-load-'));
+    const socketPath = path.join(dir, 'lms.sock');
+
+    const server = await startServer(args.exe, dir, socketPath, args.workers);
+    server.removeAllListeners('close');
+
+    const admin = new BackendClient(null, { socket: socketPath });
+    const ids = await seed(admin, Math.max(args.books, args.clients), args.clients);
+
+    const latencies = [];
+    const start = process.hrtime.bigint();
+    const failures = await Promise.all(Array.from({ length: args.clients }, (_, i) =>
+        runClient(socketPath, i, ids, args.requests, args.window, latencies)));
+    const elapsedMs = Number(process.hrtime.bigint() - start) / 1e6;
+
+    const stillOut = (await admin.listBooks()).filter(b => b.borrowed).length;
+    admin.close();
+    server.kill('SIGTERM');
+
+    latencies.sort((a, b) => a - b);
+    const pct = (p) => latencies[Math.min(latencies.length - 1, Math.floor(latencies.length * p))];
+    const result = {
+        clients: args.clients,
+        workers: args.workers,
+        requests: latencies.length,
+        elapsedMs,
+        requestsPerSec: latencies.length / (elapsedMs / 1000),
+        p50Ms: pct(0.5),
+        p99Ms: pct(0.99),
+        maxMs: latencies[latencies.length - 1],
+        failedReplies: failures.reduce((a, b) => a + b, 0),
+        booksStillBorrowed: stillOut
+    };
+
+    console.log(`${result.requests} requests from ${args.clients} clients ` +
+        `(window ${args.window}, workers ${args.workers || 'inline'}) in ${elapsedMs.toFixed(0)} ms`);
+    console.log(`${Math.round(result.requestsPerSec)} req/s  p50 ${result.p50Ms.toFixed(2)} ms  ` +
+        `p99 ${result.p99Ms.toFixed(2)} ms  max ${result.maxMs.toFixed(2)} ms`);
+    console.log(JSON.stringify(result));
+
+    if (result.failedReplies > 0 || stillOut > 0) {
+        console.error(`Inconsistent: ${result.failedReplies} failed replies, ${stillOut} books still borrowed`);
+        process.exit(1);
+    }
+}
+
+main().catch((err) => {
+    console.error(err);
+    process.exit(1);
+});
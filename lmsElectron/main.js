@@ -29,7 +29,9 @@ function createWindow() {
 
 function initBackend() {
     try {
-        backend = new BackendClient(getBackendPath());
+        // LMS_BACKEND_SOCKET: share one backend (started with --listen) across desks
+        const socket = process.env.LMS_BACKEND_SOCKET;
+        backend = new BackendClient(getBackendPath(), socket ? { socket } : {});
         console.log('✅ Backend initialized');
     } catch (err) {
         console.error('❌ Failed to initialize backend:', err);
@@ -48,7 +50,12 @@ function initBackend() {
     });
 
     ipcMain.handle('get-all-books', async (event) => {
-        return backend.listBooks();
+        return backend.syncBooks();
+    });
+
+    // Streams the catalog to the requesting window as 'books-chunk' events
+    ipcMain.handle('stream-books', async (event) => {
+        return backend.streamBooks((rows) => event.sender.send('books-chunk', rows));
     });
 
     ipcMain.handle('delete-book', async (event, id) => {
@@ -62,7 +69,7 @@ function initBackend() {
     });
 
     ipcMain.handle('get-all-members', async (event) => {
-        return backend.listMembers();
+        return backend.syncMembers();
     });
 
     ipcMain.handle('delete-member', async (event, id) => {
@@ -91,18 +98,10 @@ function initBackend() {
     });
 
     // IPC: Recommendations (simple server-side recommendations)
-    ipcMain.handle('get-recommendations', async (event) => {
+    ipcMain.handle('get-recommendations', async (event, memberID) => {
         try {
-            const books = await backend.listBooks();
-            if (!books || books.length === 0) return [];
-            const avail = books.filter(b => !b.borrowed);
-            const candidates = avail.length ? avail : books;
-            // shuffle and pick up to 5
-            for (let i = candidates.length - 1; i > 0; i--) {
-                const j = Math.floor(Math.random() * (i + 1));
-                [candidates[i], candidates[j]] = [candidates[j], candidates[i]];
-            }
-            return candidates.slice(0, Math.min(5, candidates.length));
+            // Ranked by the backend; the catalog stays there
+            return (await backend.recommend(memberID || 0, 5)) || [];
         } catch (err) {
             console.error('get-recommendations error', err);
             return [];
@@ -111,7 +110,7 @@ function initBackend() {
 
     // IPC: Authentication
     ipcMain.handle('login', async (event, username, password) => {
-        return backend.call('login', { username, password });
+        return backend.login(username, password);
     });
 
     ipcMain.handle('register', async (event, username, password) => {
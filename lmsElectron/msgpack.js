@@ -0,0 +1,169 @@
+/**
+ * Minimal MessagePack codec for the backend's binary protocol
+ *
+ * Covers what the protocol actually carries: nil, booleans, integers,
+ * doubles, strings, arrays and string-keyed maps.
+ */
+
+function encode(value) {
+    const parts = [];
+    write(value, parts);
+    return Buffer.concat(parts);
+}
+
+function header(tag, length, bytes) {
+    const buf = Buffer.alloc(1 + bytes);
+    buf[0] = tag;
+    if (bytes === 1) buf.writeUInt8(length, 1);
+    else if (bytes === 2) buf.writeUInt16BE(length, 1);
+    else if (bytes === 4) buf.writeUInt32BE(length, 1);
+    return buf;
+}
+
+function write(value, parts) {
+    if (value === null || value === undefined) {
+        parts.push(Buffer.from([0xc0]));
+    } else if (typeof value === 'boolean') {
+        parts.push(Buffer.from([value ? 0xc3 : 0xc2]));
+    } else if (typeof value === 'number') {
+        if (Number.isInteger(value) && value >= -0x80000000 && value <= 0xffffffff) {
+            if (value >= 0 && value < 0x80) parts.push(Buffer.from([value]));
+            else if (value < 0 && value >= -32) parts.push(Buffer.from([value & 0xff]));
+            else if (value >= 0) parts.push(header(0xce, value, 4));
+            else {
+                const buf = Buffer.alloc(5);
+                buf[0] = 0xd2;
+                buf.writeInt32BE(value, 1);
+                parts.push(buf);
+            }
+        } else {
+            const buf = Buffer.alloc(9);
+            buf[0] = 0xcb;
+            buf.writeDoubleBE(value, 1);
+            parts.push(buf);
+        }
+    } else if (typeof value === 'string') {
+        const bytes = Buffer.from(value, 'utf8');
+        const len = bytes.length;
+        if (len < 32) parts.push(Buffer.from([0xa0 | len]));
+        else if (len < 0x100) parts.push(header(0xd9, len, 1));
+        else if (len < 0x10000) parts.push(header(0xda, len, 2));
+        else parts.push(header(0xdb, len, 4));
+        parts.push(bytes);
+    } else if (Array.isArray(value)) {
+        const len = value.length;
+        if (len < 16) parts.push(Buffer.from([0x90 | len]));
+        else if (len < 0x10000) parts.push(header(0xdc, len, 2));
+        else parts.push(header(0xdd, len, 4));
+        for (const item of value) write(item, parts);
+    } else if (typeof value === 'object') {
+        const keys = Object.keys(value).filter(k => value[k] !== undefined);
+        const len = keys.length;
+        if (len < 16) parts.push(Buffer.from([0x80 | len]));
+        else if (len < 0x10000) parts.push(header(0xde, len, 2));
+        else parts.push(header(0xdf, len, 4));
+        for (const k of keys) {
+            write(k, parts);
+            write(value[k], parts);
+        }
+    } else {
+        throw new TypeError(`Cannot encode ${typeof value} as MessagePack`);
+    }
+}
+
+function decode(buf) {
+    let pos = 0;
+
+    // utf8Slice skips Buffer#toString's argument checks, which dominate
+    // when decoding many short record fields
+    const slice = typeof buf.utf8Slice === 'function'
+        ? (start, end) => buf.utf8Slice(start, end)
+        : (start, end) => buf.toString('utf8', start, end);
+
+    function str(len) {
+        const s = slice(pos, pos + len);
+        pos += len;
+        return s;
+    }
+
+    function arr(len) {
+        const out = new Array(len);
+        for (let i = 0; i < len; i++) out[i] = read();
+        return out;
+    }
+
+    function map(len) {
+        const out = {};
+        for (let i = 0; i < len; i++) {
+            const k = read();
+            out[k] = read();
+        }
+        return out;
+    }
+
+    function read() {
+        const tag = buf[pos++];
+        if (tag <= 0x7f) return tag;
+        if (tag >= 0xe0) return tag - 0x100;
+        if ((tag & 0xf0) === 0x80) return map(tag & 0x0f);
+        if ((tag & 0xf0) === 0x90) return arr(tag & 0x0f);
+        if ((tag & 0xe0) === 0xa0) return str(tag & 0x1f);
+
+        let v;
+        switch (tag) {
+            case 0xc0: return null;
+            case 0xc2: return false;
+            case 0xc3: return true;
+            case 0xcc: v = buf.readUInt8(pos); pos += 1; return v;
+            case 0xcd: v = buf.readUInt16BE(pos); pos += 2; return v;
+            case 0xce: v = buf.readUInt32BE(pos); pos += 4; return v;
+            case 0xd0: v = buf.readInt8(pos); pos += 1; return v;
+            case 0xd1: v = buf.readInt16BE(pos); pos += 2; return v;
+            case 0xd2: v = buf.readInt32BE(pos); pos += 4; return v;
+            case 0xcb: v = buf.readDoubleBE(pos); pos += 8; return v;
+            case 0xd9: v = buf.readUInt8(pos); pos += 1; return str(v);
+            case 0xda: v = buf.readUInt16BE(pos); pos += 2; return str(v);
+            case 0xdb: v = buf.readUInt32BE(pos); pos += 4; return str(v);
+            case 0xdc: v = buf.readUInt16BE(pos); pos += 2; return arr(v);
+            case 0xdd: v = buf.readUInt32BE(pos); pos += 4; return arr(v);
+            case 0xde: v = buf.readUInt16BE(pos); pos += 2; return map(v);
+            case 0xdf: v = buf.readUInt32BE(pos); pos += 4; return map(v);
+            default:
+                throw new Error(`Unsupported MessagePack tag 0x${tag.toString(16)}`);
+        }
+    }
+
+    return read();
+}
+
+function isTable(value) {
+    return value && !Array.isArray(value) && typeof value === 'object' &&
+        Array.isArray(value.fields) && Array.isArray(value.rows);
+}
+
+/**
+ * Binary list responses arrive as { fields: [...], rows: [[...], ...] };
+ * turn them back into the array of objects the JSON protocol returns.
+ * Tables nested one level down (e.g. a delta's `changed`) are expanded too.
+ */
+function expandTable(data) {
+    if (!isTable(data)) {
+        if (data && typeof data === 'object' && !Array.isArray(data)) {
+            for (const key of Object.keys(data)) {
+                if (isTable(data[key])) data[key] = expandTable(data[key]);
+            }
+        }
+        return data;
+    }
+    const { fields, rows } = data;
+    const out = new Array(rows.length);
+    for (let r = 0; r < rows.length; r++) {
+        const row = rows[r];
+        const obj = {};
+        for (let f = 0; f < fields.length; f++) obj[fields[f]] = row[f];
+        out[r] = obj;
+    }
+    return out;
+}
+
+module.exports = { encode, decode, expandTable };
@@ -10,6 +10,17 @@ contextBridge.exposeInMainWorld('api', {
     
     getAllBooks: () =>
         ipcRenderer.invoke('get-all-books'),
+
+    // onChunk(rows) fires per chunk; resolves to { chunks, total }
+    streamBooks: async (onChunk) => {
+        const listener = (event, rows) => onChunk(rows);
+        ipcRenderer.on('books-chunk', listener);
+        try {
+            return await ipcRenderer.invoke('stream-books');
+        } finally {
+            ipcRenderer.removeListener('books-chunk', listener);
+        }
+    },
     
     searchBooks: (query) =>
         ipcRenderer.invoke('search-books', query),
@@ -37,9 +48,9 @@ contextBridge.exposeInMainWorld('api', {
     returnBook: (bookID, memberID) =>
         ipcRenderer.invoke('return-book', bookID, memberID),
     
-    // Recommendations (frontend can also compute, but expose via backend if needed)
-    getRecommendations: () =>
-        ipcRenderer.invoke('get-recommendations'),
+    // Recommendations for a member (omit for the most borrowed books)
+    getRecommendations: (memberID) =>
+        ipcRenderer.invoke('get-recommendations', memberID),
     
     // ✅ Authentication functions
     login: (username, password) =>
@@ -865,11 +865,47 @@ function initViewBooksPage() {
     if (!booksTable) return;
 
     const tbody = booksTable.querySelector('tbody');
+
+    function appendBookRow(book) {
+        const tr = document.createElement('tr');
+        const statusBadge = book.borrowed ? 
+            `<span style="display: inline-block; padding: 4px 12px; background: #f44336; color: white; border-radius: 12px; font-size: 11px; font-weight: bold;">ISSUED TO ${book.issuedTo}</span>` : 
+            '<span style="display: inline-block; padding: 4px 12px; background: #4CAF50; color: white; border-radius: 12px; font-size: 11px; font-weight: bold;">AVAILABLE</span>';
+        const genre = book.genre || 'Unknown';
+        const coverUrl = book.coverUrl || '';
+        const coverHtml = coverUrl ? 
+            `<img src="${coverUrl}" alt="Cover" style="max-width: 50px; max-height: 70px; object-fit: cover; border-radius: 3px;">` : 
+            '<span style="color: #999;">No cover</span>';
+        tr.innerHTML = `<td style="text-align: center;">${coverHtml}</td><td>${book.id}</td><td>${book.title}</td><td>${book.author}</td><td>${book.isbn}</td><td>${genre}</td><td>${statusBadge}</td>`;
+        tr.classList.add('table-row-anim');
+        tbody.appendChild(tr);
+        requestAnimationFrame(() => { tr.classList.add('in'); });
+    }
+
+    // Cold cache: show rows chunk by chunk as the backend streams them
+    // instead of waiting for the whole catalog
+    async function streamBooks() {
+        const streamed = [];
+        tbody.innerHTML = "";
+        await window.api.streamBooks((rows) => {
+            rows.forEach(appendBookRow);
+            streamed.push(...rows);
+        });
+        _bookCache = { ts: Date.now(), data: streamed };
+        books = streamed;
+        if (streamed.length === 0) tbody.innerHTML = "<tr><td colspan='8'>No books found.</td></tr>";
+    }
+
     // loadBooks supports optional sorting
     async function loadBooks(sortKey = null, sortDir = 'asc') {
         try {
             const btn = document.getElementById('refresh-books-btn');
             if (btn) btn.disabled = true;
+            if (!sortKey && !_bookCache.data.length && window.api.streamBooks) {
+                await streamBooks();
+                if (btn) btn.disabled = false;
+                return;
+            }
             const list = await fetchBooksCached();
             books = list || [];
             let rows = books.slice();
@@ -893,21 +929,7 @@ function initViewBooksPage() {
                 return;
             }
 
-            rows.forEach(book => {
-                const tr = document.createElement('tr');
-                const statusBadge = book.borrowed ? 
-                    `<span style="display: inline-block; padding: 4px 12px; background: #f44336; color: white; border-radius: 12px; font-size: 11px; font-weight: bold;">ISSUED TO ${book.issuedTo}</span>` : 
-                    '<span style="display: inline-block; padding: 4px 12px; background: #4CAF50; color: white; border-radius: 12px; font-size: 11px; font-weight: bold;">AVAILABLE</span>';
-                const genre = book.genre || 'Unknown';
-                const coverUrl = book.coverUrl || '';
-                const coverHtml = coverUrl ? 
-                    `<img src="${coverUrl}" alt="Cover" style="max-width: 50px; max-height: 70px; object-fit: cover; border-radius: 3px;">` : 
-                    '<span style="color: #999;">No cover</span>';
-                tr.innerHTML = `<td style="text-align: center;">${coverHtml}</td><td>${book.id}</td><td>${book.title}</td><td>${book.author}</td><td>${book.isbn}</td><td>${genre}</td><td>${statusBadge}</td>`;
-                tr.classList.add('table-row-anim');
-                tbody.appendChild(tr);
-                requestAnimationFrame(() => { tr.classList.add('in'); });
-            });
+            rows.forEach(appendBookRow);
             if (btn) btn.disabled = false;
         } catch (err) {
             tbody.innerHTML = `<tr><td colspan='8'>Error: ${err.message}</td></tr>`;
@@ -1057,7 +1079,7 @@ function initViewMembersPage() {
                 if (Array.isArray(arr)) {
                     arr.forEach(id => {
                         const f = (booksList || []).find(b => b.id === id);
-                        if (f) borrowedTitles.push(f.title);
+                        if (f && !borrowedTitles.includes(f.title)) borrowedTitles.push(f.title);
                     });
                 }
 
@@ -0,0 +1,233 @@
+#include "loanlog.h"
+
+#include <algorithm>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <map>
+
+#include "database.h"
+
+namespace {
+
+// File layout: Header, then LoanEvent records in host byte order
+const char LOG_MAGIC[8] = {'L', 'M', 'S', 'L', 'O', 'A', 'N', 'S'};
+const uint32_t LOG_FORMAT = 1;
+const uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+struct Header {
+    char magic[8];
+    uint32_t format;
+    uint32_t byteOrder;
+    uint64_t firstSeq;      // sequence number of the first record
+};
+
+} // namespace
+
+LoanLog::~LoanLog()
+{
+    close();
+}
+
+void LoanLog::open(sqlite3* database, const std::string& logPath, size_t compactEvery)
+{
+    db = database;
+    path = logPath;
+    compactAt = std::max<size_t>(1, compactEvery);
+    createLoanHistoryTable(db);
+    firstSeq = nextLoanHistorySeq(db);
+    if (path.empty())
+        return;
+
+    // Replay the log; a torn last record (crash mid-append) is dropped
+    std::ifstream in(path, std::ios::binary);
+    Header h;
+    bool valid = in.read(reinterpret_cast<char*>(&h), sizeof(h)) &&
+                 std::memcmp(h.magic, LOG_MAGIC, sizeof(h.magic)) == 0 &&
+                 h.format == LOG_FORMAT && h.byteOrder == BYTE_ORDER_MARK;
+    if (valid) {
+        firstSeq = h.firstSeq;
+        LoanEvent e;
+        while (in.read(reinterpret_cast<char*>(&e), sizeof(e))) {
+            byMember[e.memberID].push_back(static_cast<uint32_t>(tail.size()));
+            tail.push_back(e);
+        }
+    } else if (in) {
+        std::cerr << "Ignoring unreadable loan log " << path << std::endl;
+    }
+    in.close();
+
+    if (!rewriteFile(firstSeq))
+        std::cerr << "Loan history will not be logged to " << path << std::endl;
+}
+
+void LoanLog::close()
+{
+    if (file) {
+        std::fclose(file);
+        file = nullptr;
+    }
+}
+
+// Replaces the file with the header and the current tail, then reopens it for appending
+bool LoanLog::rewriteFile(uint64_t seq)
+{
+    close();
+    std::string tmpPath = path + ".tmp";
+    {
+        std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+        Header h{};
+        std::memcpy(h.magic, LOG_MAGIC, sizeof(h.magic));
+        h.format = LOG_FORMAT;
+        h.byteOrder = BYTE_ORDER_MARK;
+        h.firstSeq = seq;
+        out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+        out.write(reinterpret_cast<const char*>(tail.data()), static_cast<std::streamsize>(tail.size() * sizeof(LoanEvent)));
+        if (!out.flush()) {
+            std::remove(tmpPath.c_str());
+            return false;
+        }
+    }
+    if (std::rename(tmpPath.c_str(), path.c_str()) != 0) {
+        std::remove(tmpPath.c_str());
+        return false;
+    }
+    file = std::fopen(path.c_str(), "ab");
+    return file != nullptr;
+}
+
+bool LoanLog::append(LoanAction action, int bookID, int memberID)
+{
+    LoanEvent e{static_cast<uint32_t>(std::time(nullptr)), bookID, memberID, action};
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!tail.empty() && e.time < tail.back().time)
+        e.time = tail.back().time;      // the clock stepped back: keep the log in time order
+    if (file) {
+        // Flushed to the OS, not synced: a process crash keeps it, a power cut may not
+        std::fwrite(&e, sizeof(e), 1, file);
+        std::fflush(file);
+    }
+    byMember[e.memberID].push_back(static_cast<uint32_t>(tail.size()));
+    tail.push_back(e);
+    return tail.size() >= compactAt;
+}
+
+void LoanLog::compact()
+{
+    // Appends never run alongside compaction (see LoanLog::mutex), so the tail can be read unlocked here
+    if (tail.empty())
+        return;
+    if (!insertLoanHistory(db, firstSeq, tail))
+        return;     // keep the log; the next compaction retries
+
+    uint64_t seq = firstSeq + tail.size();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        tail.clear();
+        byMember.clear();
+        firstSeq = seq;
+    }
+    if (!path.empty() && !rewriteFile(seq))
+        std::cerr << "Failed to truncate loan log " << path << std::endl;
+}
+
+std::vector<LoanEvent> LoanLog::memberHistory(int memberID, uint32_t from, uint32_t to) const
+{
+    std::vector<LoanEvent> recent;
+    uint64_t before;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        before = firstSeq;
+        auto it = byMember.find(memberID);
+        if (it != byMember.end()) {
+            for (uint32_t pos : it->second) {
+                const LoanEvent& e = tail[pos];
+                if (e.time >= from && e.time < to)
+                    recent.push_back(e);
+            }
+        }
+    }
+
+    // Compacted events first: they are all older than the log's
+    std::vector<LoanEvent> events;
+    loadMemberLoanHistory(db, memberID, from, to, before, events);
+    events.insert(events.end(), recent.begin(), recent.end());
+    return events;
+}
+
+std::vector<LoanEvent> LoanLog::recentCheckouts(size_t count) const
+{
+    std::vector<LoanEvent> recent;
+    uint64_t before;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        before = firstSeq;
+        for (auto it = tail.rbegin(); it != tail.rend() && recent.size() < count; ++it)
+            if (it->action == LoanAction::checkout)
+                recent.push_back(*it);
+    }
+    std::reverse(recent.begin(), recent.end());
+
+    // Compacted events first: they are all older than the log's
+    std::vector<LoanEvent> events;
+    if (recent.size() < count)
+        loadRecentCheckouts(db, before, count - recent.size(), events);
+    events.insert(events.end(), recent.begin(), recent.end());
+    return events;
+}
+
+std::vector<LoanDayCount> LoanLog::perDay(uint32_t from, uint32_t to) const
+{
+    std::map<uint32_t, LoanDayCount> days;
+    auto add = [&days](uint32_t day, LoanAction action, int count) {
+        LoanDayCount& d = days[day];
+        d.day = day;
+        (action == LoanAction::checkout ? d.checkouts : d.returns) += count;
+    };
+
+    uint64_t before;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        before = firstSeq;
+        // The log is in time order: binary search the range
+        auto byTime = [](const LoanEvent& e, uint32_t t) { return e.time < t; };
+        auto first = std::lower_bound(tail.begin(), tail.end(), from, byTime);
+        auto last = std::lower_bound(first, tail.end(), to, byTime);
+        for (auto it = first; it != last; ++it)
+            add(it->time / 86400, it->action, 1);
+    }
+
+    std::vector<LoanDayCount> compacted;
+    countLoanHistoryPerDay(db, from, to, before, compacted);
+    for (const auto& d : compacted) {
+        add(d.day, LoanAction::checkout, d.checkouts);
+        add(d.day, LoanAction::returned, d.returns);
+    }
+
+    std::vector<LoanDayCount> out;
+    out.reserve(days.size());
+    for (const auto& entry : days)
+        out.push_back(entry.second);
+    return out;
+}
+
+size_t LoanLog::pending() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return tail.size();
+}
+
+MemoryItem LoanLog::memoryUsage() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    MemoryItem m;
+    m.name = "loanLog";
+    m.count = tail.size();
+    m.used = tail.size() * (sizeof(LoanEvent) + sizeof(uint32_t));
+    m.reserved = tail.capacity() * sizeof(LoanEvent) + hashTableBytes(byMember);
+    for (const auto& entry : byMember)
+        m.reserved += entry.second.capacity() * sizeof(uint32_t);
+    return m;
+}
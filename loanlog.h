@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "external/sqlite/sqlite3.h"
+#include "memstats.h"
+
+// Loan history: every checkout and return, for circulation reports.
+//
+// New events are appended to a binary log next to the database (16 bytes
+// each) and kept in memory until the log is compacted into SQLite's
+// loan_history table, which is indexed by time and by member. Queries
+// combine the two and only touch the requested range; neither side is
+// scanned in full, and the live books/loans tables are not read at all.
+//
+// Every event has a sequence number (its position in the whole history).
+// It is loan_history's key, so compacting the same events twice, e.g.
+// after a crash between the commit and truncating the log, is harmless.
+
+enum class LoanAction : uint32_t {
+    checkout = 0,
+    returned = 1
+};
+
+struct LoanEvent {
+    uint32_t time;          // seconds since 1970 (UTC); never decreases along the log
+    int32_t bookID;
+    int32_t memberID;
+    LoanAction action;
+};
+static_assert(sizeof(LoanEvent) == 16, "LoanEvent is the on-disk record");
+
+struct LoanDayCount {
+    uint32_t day;           // days since 1970 (time / 86400)
+    int checkouts = 0;
+    int returns = 0;
+};
+
+// Events between compactions; the log file never grows much past this
+const size_t LOAN_LOG_COMPACT_AT = 4096;
+
+class LoanLog
+{
+    private:
+
+    sqlite3* db = nullptr;
+    std::string path;                   // "" keeps the log in memory only
+    std::FILE* file = nullptr;
+    size_t compactAt = LOAN_LOG_COMPACT_AT;
+
+    // The uncompacted events. Appends and compaction are made one at a time
+    // (the library holds its edit lock); queries may run on any thread and
+    // copy out under the lock.
+    mutable std::mutex mutex;
+    std::vector<LoanEvent> tail;                            // in log order
+    uint64_t firstSeq = 0;                                  // sequence number of tail[0]
+    std::unordered_map<int, std::vector<uint32_t>> byMember; // member -> tail positions
+
+    bool rewriteFile(uint64_t seq);
+
+    public:
+
+    LoanLog() = default;
+    ~LoanLog();
+
+    LoanLog(const LoanLog&) = delete;
+    LoanLog& operator=(const LoanLog&) = delete;
+
+    // Creates loan_history in `db` and replays the log at `logPath`
+    void open(sqlite3* db, const std::string& logPath, size_t compactEvery = LOAN_LOG_COMPACT_AT);
+    void close();
+
+    // Records one event stamped now; true once compact() is due
+    bool append(LoanAction action, int bookID, int memberID);
+
+    // Moves every logged event into loan_history and empties the log. The
+    // caller makes sure no other transaction is open on `db`.
+    void compact();
+
+    // A member's events with from <= time < to, oldest first
+    std::vector<LoanEvent> memberHistory(int memberID, uint32_t from, uint32_t to) const;
+    // Checkouts and returns per day for from <= time < to, days in order
+    std::vector<LoanDayCount> perDay(uint32_t from, uint32_t to) const;
+    // The last `count` checkouts, oldest first
+    std::vector<LoanEvent> recentCheckouts(size_t count) const;
+
+    size_t pending() const;
+    // The uncompacted events and their per-member index
+    MemoryItem memoryUsage() const;
+};
@@ -1,28 +1,44 @@
 #include "member.h"
+#include "stringpool.h"
 #include <iostream>
 #include <vector>
 #include <algorithm>
 
 int member:: nextID=1000;
 
-member::member(const std::string& name, const std::string& address, int BorrowedBookID):
-    name(name), address(address), BorrowedBookID(BorrowedBookID)
+member::member(std::string_view name, std::string_view address, int BorrowedBookID):
+    name(StringPool::global().store(name)),
+    address(StringPool::global().store(address)),
+    BorrowedBookID(BorrowedBookID)
 {
     this -> ID = member::nextID++;
 }
 
+member::member(int id, std::string_view name, std::string_view address, int BorrowedBookID):
+    ID(id),
+    name(StringPool::global().store(name)),
+    address(StringPool::global().store(address)),
+    BorrowedBookID(BorrowedBookID)
+{
+}
+
+member::member(PooledText, int id, std::string_view name, std::string_view address, int BorrowedBookID):
+    ID(id), name(name), address(address), BorrowedBookID(BorrowedBookID)
+{
+}
+
 int member::getID() const
 {
     return this -> ID;
 }
 
-std::string member::getName() const
+std::string_view member::getName() const
 {
     return this -> name;
 }
 
 
-std::string member::getAddress() const
+std::string_view member::getAddress() const
 {
     return this -> address;
 }
@@ -32,14 +48,29 @@ int member::getBorrowedBookID() const
     return this -> BorrowedBookID;
 }
 
+const std::vector<int>& member::getLoans() const
+{
+    return this -> loans;
+}
+
 void member::borrowBook(int bookID) 
 {
+    if (std::find(loans.begin(), loans.end(), bookID) == loans.end())
+        loans.push_back(bookID);
     BorrowedBookID = bookID;
 }
 
 void member::returnBook(int bookID) 
 {
-    BorrowedBookID = 0;
+    loans.erase(std::remove(loans.begin(), loans.end(), bookID), loans.end());
+    BorrowedBookID = loans.empty() ? 0 : loans.back();
+}
+
+// Replaces the loan list (used when loading from the loans table)
+void member::setLoans(std::vector<int> bookIDs)
+{
+    loans = std::move(bookIDs);
+    BorrowedBookID = loans.empty() ? 0 : loans.back();
 }
 
 void member::setID(int id)
@@ -1,18 +1,22 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <vector>
 #include <chrono>
 
+#include "stringpool.h"
+
 class member
 {
     private:
 
     int ID;
-    std::string name;
-    std::string address;
+    std::string_view name;          // in StringPool::global()
+    std::string_view address;
 
-    int BorrowedBookID;
+    int BorrowedBookID;             // most recent loan, 0 if none
+    std::vector<int> loans;         // every book currently held, oldest first
 
     // Auto-Assigning Member IDs (?)
     static int nextID;
@@ -20,18 +24,24 @@ class member
 
     public:
     // Member Constructor
-    member(const std::string& name, const std::string& address, int BorrowedBookID = 0);
+    member(std::string_view name, std::string_view address, int BorrowedBookID = 0);
+    // Restores a stored member under its own ID (used by the bulk loader)
+    member(int id, std::string_view name, std::string_view address, int BorrowedBookID);
+    // As above, for text that is already pooled (e.g. a mapped snapshot file)
+    member(PooledText, int id, std::string_view name, std::string_view address, int BorrowedBookID);
 
 
     void setID(int id);
 
     // Data Fetchers
     int getID() const;
-    std::string getName() const;
-    std::string getAddress() const;
+    std::string_view getName() const;
+    std::string_view getAddress() const;
     int getBorrowedBookID() const;
+    const std::vector<int>& getLoans() const;
 
     // Borrowing Books
     void borrowBook(int bookID);
     void returnBook (int bookID);
+    void setLoans(std::vector<int> bookIDs);
 };
\ No newline at end of file
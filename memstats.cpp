@@ -0,0 +1,48 @@
+#include "memstats.h"
+
+#include <fstream>
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
+// Constant-initialized, so operator new may count before any constructor runs
+AllocationCounters allocationCounters;
+
+HeapTotals heapTotals()
+{
+    HeapTotals h;
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    struct mallinfo2 info = mallinfo2();
+    h.available = true;
+    h.inUse = info.uordblks + info.hblkhd;
+    h.free = info.fordblks;
+    h.mapped = info.hblkhd;
+#endif
+    return h;
+}
+
+size_t residentBytes()
+{
+#ifdef __linux__
+    // statm: total and resident size, in pages
+    std::ifstream statm("/proc/self/statm");
+    size_t total = 0, resident = 0;
+    if (statm >> total >> resident)
+        return resident * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#endif
+    return 0;
+}
+
+AllocationCounts allocationCounts()
+{
+    AllocationCounts c;
+    c.allocations = allocationCounters.allocations.load(std::memory_order_relaxed);
+    c.frees = allocationCounters.frees.load(std::memory_order_relaxed);
+    c.bytesAllocated = allocationCounters.bytesAllocated.load(std::memory_order_relaxed);
+    c.bytesFreed = allocationCounters.bytesFreed.load(std::memory_order_relaxed);
+    return c;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Memory accounting for the memoryStats method.
+//
+// Each in-memory structure reports what it holds as a MemoryItem. The
+// figures are computed from sizes and capacities, not measured, so they
+// leave out allocator overhead; heapTotals() and residentBytes() give the
+// process-wide numbers to hold them against.
+
+// Heap held by one structure. `used` is what its contents need; `reserved`
+// adds spare capacity and bookkeeping, and is what it actually holds.
+struct MemoryItem {
+    std::string name;
+    size_t count = 0;       // elements: records, strings, events, ...
+    size_t used = 0;
+    size_t reserved = 0;
+};
+
+// Approximate heap bytes of a node-based hash container: one node per
+// element (value, next pointer, cached hash) plus the bucket array
+template <typename HashTable>
+size_t hashTableBytes(const HashTable& table)
+{
+    return table.size() * (sizeof(typename HashTable::value_type) + 2 * sizeof(void*)) +
+           table.bucket_count() * sizeof(void*);
+}
+
+// What the C allocator reports (glibc only; available false elsewhere)
+struct HeapTotals {
+    bool available = false;
+    size_t inUse = 0;       // handed out by malloc and not yet freed
+    size_t free = 0;        // kept by the allocator for reuse
+    size_t mapped = 0;      // of inUse, in blocks mmap'ed on their own
+};
+HeapTotals heapTotals();
+
+// Resident set size of the process (Linux only; 0 elsewhere)
+size_t residentBytes();
+
+// Counts kept by the replacement operator new and delete in alloccount.cpp.
+// Only programs that link that file count (the benchmarks, and the backend
+// when built with LMS_COUNT_ALLOCATIONS); `linked` tells which. Aligned
+// allocations (over-aligned types) are not counted.
+struct AllocationCounters {
+    std::atomic<bool> linked{false};
+    std::atomic<bool> on{true};             // counting can be paused
+    std::atomic<uint64_t> allocations{0};
+    std::atomic<uint64_t> frees{0};
+    std::atomic<uint64_t> bytesAllocated{0};
+    std::atomic<uint64_t> bytesFreed{0};
+};
+extern AllocationCounters allocationCounters;
+
+// A copy of the counters at one moment
+struct AllocationCounts {
+    uint64_t allocations = 0;
+    uint64_t frees = 0;
+    uint64_t bytesAllocated = 0;
+    uint64_t bytesFreed = 0;
+};
+AllocationCounts allocationCounts();
@@ -0,0 +1,207 @@
+#include "metrics.h"
+
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+
+// ---------------------------------------------------------------------------
+// LatencyHistogram
+// ---------------------------------------------------------------------------
+
+static unsigned highestBit(uint64_t v)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return 63u - static_cast<unsigned>(__builtin_clzll(v));
+#else
+    unsigned bit = 0;
+    while (v >>= 1) ++bit;
+    return bit;
+#endif
+}
+
+// Exact below SUB_BUCKETS; above, the top SUB_BITS + 1 bits pick the bucket
+size_t LatencyHistogram::bucketOf(uint64_t micros)
+{
+    micros = std::min(micros, (uint64_t(1) << MAX_BITS) - 1);
+    if (micros < SUB_BUCKETS)
+        return static_cast<size_t>(micros);
+    unsigned shift = highestBit(micros) - SUB_BITS;
+    return static_cast<size_t>(SUB_BUCKETS * shift + (micros >> shift));
+}
+
+uint64_t LatencyHistogram::highestIn(size_t bucket)
+{
+    if (bucket < SUB_BUCKETS)
+        return bucket;
+    uint64_t shift = bucket / SUB_BUCKETS - 1;
+    uint64_t top = bucket % SUB_BUCKETS + SUB_BUCKETS;
+    return ((top + 1) << shift) - 1;
+}
+
+void LatencyHistogram::record(uint64_t micros)
+{
+    counts[bucketOf(micros)].fetch_add(1, std::memory_order_relaxed);
+    total.fetch_add(1, std::memory_order_relaxed);
+    sum.fetch_add(micros, std::memory_order_relaxed);
+    uint64_t seen = maximum.load(std::memory_order_relaxed);
+    while (micros > seen && !maximum.compare_exchange_weak(seen, micros, std::memory_order_relaxed)) {
+    }
+}
+
+void LatencyHistogram::reset()
+{
+    for (auto& c : counts)
+        c.store(0, std::memory_order_relaxed);
+    total.store(0, std::memory_order_relaxed);
+    sum.store(0, std::memory_order_relaxed);
+    maximum.store(0, std::memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::mean() const
+{
+    uint64_t n = count();
+    return n ? sum.load(std::memory_order_relaxed) / n : 0;
+}
+
+uint64_t LatencyHistogram::quantile(double q) const
+{
+    uint64_t n = count();
+    if (n == 0)
+        return 0;
+    uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(q * static_cast<double>(n) + 0.5));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < BUCKETS; ++i) {
+        seen += counts[i].load(std::memory_order_relaxed);
+        if (seen >= rank)
+            return std::min(highestIn(i), max());
+    }
+    return max();     // records landed while we walked
+}
+
+// ---------------------------------------------------------------------------
+// RpcMetrics
+// ---------------------------------------------------------------------------
+
+RpcMetrics::RpcMetrics()
+    : since(std::chrono::steady_clock::now())
+{
+    methods.emplace(OTHER_METHODS, std::unique_ptr<Method>(new Method()));
+}
+
+RpcMetrics::Method& RpcMetrics::find(const std::string& method)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = methods.find(method);
+    if (it != methods.end())
+        return *it->second;
+    if (methods.size() >= MAX_METHODS)
+        return *methods[OTHER_METHODS];
+    return *methods.emplace(method, std::unique_ptr<Method>(new Method())).first->second;
+}
+
+void RpcMetrics::record(const std::string& method, std::chrono::steady_clock::duration elapsed, bool failed)
+{
+    Method& m = find(method);
+    auto micros = std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+    m.latency.record(static_cast<uint64_t>(std::max<long long>(0, micros)));
+    if (failed)
+        m.errors.fetch_add(1, std::memory_order_relaxed);
+}
+
+std::vector<MethodStats> RpcMetrics::snapshot() const
+{
+    std::vector<MethodStats> out;
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const auto& entry : methods) {
+        const LatencyHistogram& h = entry.second->latency;
+        if (h.count() == 0)
+            continue;
+        MethodStats s;
+        s.method = entry.first;
+        s.count = h.count();
+        s.errors = entry.second->errors.load(std::memory_order_relaxed);
+        s.p50 = h.quantile(0.50);
+        s.p90 = h.quantile(0.90);
+        s.p99 = h.quantile(0.99);
+        s.max = h.max();
+        s.mean = h.mean();
+        out.push_back(s);
+    }
+    std::sort(out.begin(), out.end(), [](const MethodStats& a, const MethodStats& b) {
+        return a.count != b.count ? a.count > b.count : a.method < b.method;
+    });
+    return out;
+}
+
+void RpcMetrics::reset()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto& entry : methods) {
+        entry.second->latency.reset();
+        entry.second->errors.store(0, std::memory_order_relaxed);
+    }
+    since = std::chrono::steady_clock::now();
+}
+
+uint64_t RpcMetrics::requests() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    uint64_t n = 0;
+    for (const auto& entry : methods)
+        n += entry.second->latency.count();
+    return n;
+}
+
+uint64_t RpcMetrics::errors() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    uint64_t n = 0;
+    for (const auto& entry : methods)
+        n += entry.second->errors.load(std::memory_order_relaxed);
+    return n;
+}
+
+std::chrono::steady_clock::duration RpcMetrics::window() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return std::chrono::steady_clock::now() - since;
+}
+
+// ---------------------------------------------------------------------------
+// MetricsReporter
+// ---------------------------------------------------------------------------
+
+MetricsReporter::MetricsReporter(const RpcMetrics& m, std::chrono::seconds every)
+    : metrics(m), interval(every), thread(&MetricsReporter::run, this)
+{
+}
+
+MetricsReporter::~MetricsReporter()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    thread.join();
+}
+
+void MetricsReporter::run()
+{
+    uint64_t reported = 0;
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!wake.wait_for(lock, interval, [this] { return stopping; })) {
+        uint64_t requests = metrics.requests();
+        if (requests == reported)
+            continue;   // nothing new: keep the log quiet
+        reported = requests;
+
+        std::ostringstream line;
+        line << "RPC stats over " << std::chrono::duration_cast<std::chrono::seconds>(metrics.window()).count()
+             << " s: " << requests << " requests, " << metrics.errors() << " errors";
+        for (const auto& s : metrics.snapshot())
+            line << "; " << s.method << " " << s.count << "x p50 " << s.p50 << " p90 " << s.p90
+                 << " p99 " << s.p99 << " max " << s.max << " us";
+        std::cerr << line.str() << std::endl;
+    }
+}
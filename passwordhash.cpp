@@ -0,0 +1,337 @@
+#include "passwordhash.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+namespace {
+
+// SHA-256 (FIPS 180-4), for PBKDF2-HMAC-SHA256 inside scrypt
+class Sha256
+{
+    public:
+
+    static const size_t SIZE = 32;
+
+    void update(const uint8_t* data, size_t len)
+    {
+        total += len;
+        while (len > 0) {
+            size_t take = std::min(len, sizeof(block) - used);
+            std::memcpy(block + used, data, take);
+            used += take;
+            data += take;
+            len -= take;
+            if (used == sizeof(block)) {
+                compress(block);
+                used = 0;
+            }
+        }
+    }
+
+    void finish(uint8_t out[SIZE])
+    {
+        uint64_t bits = total * 8;
+        uint8_t pad = 0x80;
+        update(&pad, 1);
+        pad = 0;
+        while (used != 56)
+            update(&pad, 1);
+        uint8_t length[8];
+        for (int i = 0; i < 8; ++i)
+            length[i] = static_cast<uint8_t>(bits >> (56 - 8 * i));
+        update(length, 8);
+        for (int i = 0; i < 8; ++i)
+            for (int j = 0; j < 4; ++j)
+                out[4 * i + j] = static_cast<uint8_t>(state[i] >> (24 - 8 * j));
+    }
+
+    private:
+
+    uint32_t state[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+                         0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+    uint8_t block[64];
+    size_t used = 0;
+    uint64_t total = 0;
+
+    static uint32_t rotr(uint32_t x, int n) { return (x >> n) | (x << (32 - n)); }
+
+    void compress(const uint8_t* p)
+    {
+        static const uint32_t K[64] = {
+            0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+            0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+            0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+            0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+            0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+            0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+            0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+            0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+        uint32_t w[64];
+        for (int i = 0; i < 16; ++i)
+            w[i] = (uint32_t(p[4 * i]) << 24) | (uint32_t(p[4 * i + 1]) << 16) |
+                   (uint32_t(p[4 * i + 2]) << 8) | uint32_t(p[4 * i + 3]);
+        for (int i = 16; i < 64; ++i) {
+            uint32_t s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+            uint32_t s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+            w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+        }
+        uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+        uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+        for (int i = 0; i < 64; ++i) {
+            uint32_t t1 = h + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) + ((e & f) ^ (~e & g)) + K[i] + w[i];
+            uint32_t t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+            h = g; g = f; f = e; e = d + t1;
+            d = c; c = b; b = a; a = t1 + t2;
+        }
+        state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+        state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+    }
+};
+
+// HMAC-SHA256 with the key's inner and outer states prepared once
+class HmacSha256
+{
+    public:
+
+    HmacSha256(const uint8_t* key, size_t keyLen)
+    {
+        uint8_t k[64] = {};
+        if (keyLen > sizeof(k)) {
+            Sha256 h;
+            h.update(key, keyLen);
+            h.finish(k);
+        } else {
+            std::memcpy(k, key, keyLen);
+        }
+        uint8_t pad[64];
+        for (int i = 0; i < 64; ++i) pad[i] = k[i] ^ 0x36;
+        inner.update(pad, 64);
+        for (int i = 0; i < 64; ++i) pad[i] = k[i] ^ 0x5c;
+        outer.update(pad, 64);
+    }
+
+    // MAC of the concatenation of two messages
+    void mac(const uint8_t* a, size_t aLen, const uint8_t* b, size_t bLen, uint8_t out[Sha256::SIZE]) const
+    {
+        Sha256 h = inner;
+        h.update(a, aLen);
+        h.update(b, bLen);
+        uint8_t digest[Sha256::SIZE];
+        h.finish(digest);
+        Sha256 o = outer;
+        o.update(digest, sizeof(digest));
+        o.finish(out);
+    }
+
+    private:
+
+    Sha256 inner, outer;
+};
+
+} // namespace
+
+void pbkdf2Sha256(const std::string& password, const uint8_t* salt, size_t saltLen, uint8_t* out, size_t outLen)
+{
+    HmacSha256 hmac(reinterpret_cast<const uint8_t*>(password.data()), password.size());
+    std::vector<uint8_t> block(saltLen + 4);
+    if (saltLen)
+        std::memcpy(block.data(), salt, saltLen);
+    for (uint32_t i = 1; outLen > 0; ++i) {
+        uint8_t counter[4] = {uint8_t(i >> 24), uint8_t(i >> 16), uint8_t(i >> 8), uint8_t(i)};
+        uint8_t t[Sha256::SIZE];
+        hmac.mac(block.data(), saltLen, counter, 4, t);
+        size_t take = std::min(outLen, sizeof(t));
+        std::memcpy(out, t, take);
+        out += take;
+        outLen -= take;
+    }
+}
+
+namespace {
+
+inline uint32_t rotl(uint32_t x, int n) { return (x << n) | (x >> (32 - n)); }
+
+// Salsa20/8 core on 16 words, in place
+void salsa8(uint32_t b[16])
+{
+    uint32_t x[16];
+    std::memcpy(x, b, sizeof(x));
+    for (int i = 0; i < 8; i += 2) {
+        x[ 4] ^= rotl(x[ 0] + x[12],  7);  x[ 8] ^= rotl(x[ 4] + x[ 0],  9);
+        x[12] ^= rotl(x[ 8] + x[ 4], 13);  x[ 0] ^= rotl(x[12] + x[ 8], 18);
+        x[ 9] ^= rotl(x[ 5] + x[ 1],  7);  x[13] ^= rotl(x[ 9] + x[ 5],  9);
+        x[ 1] ^= rotl(x[13] + x[ 9], 13);  x[ 5] ^= rotl(x[ 1] + x[13], 18);
+        x[14] ^= rotl(x[10] + x[ 6],  7);  x[ 2] ^= rotl(x[14] + x[10],  9);
+        x[ 6] ^= rotl(x[ 2] + x[14], 13);  x[10] ^= rotl(x[ 6] + x[ 2], 18);
+        x[ 3] ^= rotl(x[15] + x[11],  7);  x[ 7] ^= rotl(x[ 3] + x[15],  9);
+        x[11] ^= rotl(x[ 7] + x[ 3], 13);  x[15] ^= rotl(x[11] + x[ 7], 18);
+        x[ 1] ^= rotl(x[ 0] + x[ 3],  7);  x[ 2] ^= rotl(x[ 1] + x[ 0],  9);
+        x[ 3] ^= rotl(x[ 2] + x[ 1], 13);  x[ 0] ^= rotl(x[ 3] + x[ 2], 18);
+        x[ 6] ^= rotl(x[ 5] + x[ 4],  7);  x[ 7] ^= rotl(x[ 6] + x[ 5],  9);
+        x[ 4] ^= rotl(x[ 7] + x[ 6], 13);  x[ 5] ^= rotl(x[ 4] + x[ 7], 18);
+        x[11] ^= rotl(x[10] + x[ 9],  7);  x[ 8] ^= rotl(x[11] + x[10],  9);
+        x[ 9] ^= rotl(x[ 8] + x[11], 13);  x[10] ^= rotl(x[ 9] + x[ 8], 18);
+        x[12] ^= rotl(x[15] + x[14],  7);  x[13] ^= rotl(x[12] + x[15],  9);
+        x[14] ^= rotl(x[13] + x[12], 13);  x[15] ^= rotl(x[14] + x[13], 18);
+    }
+    for (int i = 0; i < 16; ++i)
+        b[i] += x[i];
+}
+
+// scryptBlockMix on 2r 64-byte blocks: `in` to `out`
+void blockMix(const uint32_t* in, uint32_t* out, uint32_t r)
+{
+    uint32_t x[16];
+    std::memcpy(x, in + (2 * r - 1) * 16, sizeof(x));
+    for (uint32_t i = 0; i < 2 * r; ++i) {
+        for (int k = 0; k < 16; ++k)
+            x[k] ^= in[i * 16 + k];
+        salsa8(x);
+        // Even blocks to the first half, odd ones to the second
+        std::memcpy(out + ((i & 1) * r + i / 2) * 16, x, sizeof(x));
+    }
+}
+
+// scryptROMix on one 128r-byte block, as little-endian words
+void roMix(uint8_t* block, uint64_t N, uint32_t r, std::vector<uint32_t>& v)
+{
+    const size_t words = 32 * r;
+    std::vector<uint32_t> x(words), y(words);
+    for (size_t i = 0; i < words; ++i)
+        x[i] = uint32_t(block[4 * i]) | (uint32_t(block[4 * i + 1]) << 8) |
+               (uint32_t(block[4 * i + 2]) << 16) | (uint32_t(block[4 * i + 3]) << 24);
+
+    for (uint64_t i = 0; i < N; ++i) {
+        std::memcpy(&v[i * words], x.data(), words * 4);
+        blockMix(x.data(), y.data(), r);
+        x.swap(y);
+    }
+    for (uint64_t i = 0; i < N; ++i) {
+        // Integerify: the first word of the last 64-byte block (N <= 2^32)
+        uint64_t j = x[(2 * r - 1) * 16] & (N - 1);
+        const uint32_t* vj = &v[j * words];
+        for (size_t k = 0; k < words; ++k)
+            x[k] ^= vj[k];
+        blockMix(x.data(), y.data(), r);
+        x.swap(y);
+    }
+
+    for (size_t i = 0; i < words; ++i)
+        for (int k = 0; k < 4; ++k)
+            block[4 * i + k] = static_cast<uint8_t>(x[i] >> (8 * k));
+}
+
+const size_t SALT_BYTES = 16;
+const size_t HASH_BYTES = 32;
+const uint32_t BLOCK_R = 8;
+const char* const PREFIX = "$scrypt$";
+
+std::string toHex(const uint8_t* data, size_t len)
+{
+    static const char digits[] = "0123456789abcdef";
+    std::string out;
+    out.reserve(len * 2);
+    for (size_t i = 0; i < len; ++i) {
+        out += digits[data[i] >> 4];
+        out += digits[data[i] & 15];
+    }
+    return out;
+}
+
+bool fromHex(const std::string& hex, std::vector<uint8_t>& out)
+{
+    if (hex.size() % 2)
+        return false;
+    out.clear();
+    for (size_t i = 0; i < hex.size(); i += 2) {
+        unsigned value;
+        if (std::sscanf(hex.c_str() + i, "%2x", &value) != 1)
+            return false;
+        out.push_back(static_cast<uint8_t>(value));
+    }
+    return true;
+}
+
+// Compares without an early exit, so timing doesn't tell how much matched
+bool sameBytes(const uint8_t* a, const uint8_t* b, size_t len)
+{
+    uint8_t diff = 0;
+    for (size_t i = 0; i < len; ++i)
+        diff |= a[i] ^ b[i];
+    return diff == 0;
+}
+
+std::string encode(int cost, uint32_t r, uint32_t p, const uint8_t* salt, const uint8_t* hash)
+{
+    return std::string(PREFIX) + "ln=" + std::to_string(cost) + ",r=" + std::to_string(r) +
+           ",p=" + std::to_string(p) + "$" + toHex(salt, SALT_BYTES) + "$" + toHex(hash, HASH_BYTES);
+}
+
+} // namespace
+
+void scrypt(const std::string& password, const uint8_t* salt, size_t saltLen,
+            uint64_t N, uint32_t r, uint32_t p, uint8_t* out, size_t outLen)
+{
+    const size_t blockBytes = 128 * static_cast<size_t>(r);
+    std::vector<uint8_t> b(blockBytes * p);
+    pbkdf2Sha256(password, salt, saltLen, b.data(), b.size());
+    std::vector<uint32_t> v(static_cast<size_t>(N) * 32 * r);
+    for (uint32_t i = 0; i < p; ++i)
+        roMix(&b[i * blockBytes], N, r, v);
+    pbkdf2Sha256(password, b.data(), b.size(), out, outLen);
+}
+
+std::string randomHex(size_t bytes)
+{
+    static thread_local std::random_device device;
+    std::vector<uint8_t> data(bytes);
+    for (size_t i = 0; i < bytes; i += 4) {
+        unsigned int word = device();
+        for (size_t k = 0; k < 4 && i + k < bytes; ++k)
+            data[i + k] = static_cast<uint8_t>(word >> (8 * k));
+    }
+    return toHex(data.data(), data.size());
+}
+
+std::string hashPassword(const std::string& password, int cost)
+{
+    std::vector<uint8_t> salt;
+    fromHex(randomHex(SALT_BYTES), salt);
+    uint8_t hash[HASH_BYTES];
+    scrypt(password, salt.data(), salt.size(), uint64_t(1) << cost, BLOCK_R, 1, hash, sizeof(hash));
+    return encode(cost, BLOCK_R, 1, salt.data(), hash);
+}
+
+bool verifyPassword(const std::string& password, const std::string& stored, int cost, bool& rehash)
+{
+    rehash = false;
+    if (stored.compare(0, std::strlen(PREFIX), PREFIX) != 0) {
+        // Stored before passwords were hashed
+        bool match = stored.size() == password.size() &&
+                     sameBytes(reinterpret_cast<const uint8_t*>(stored.data()),
+                               reinterpret_cast<const uint8_t*>(password.data()), stored.size());
+        rehash = match;
+        return match;
+    }
+
+    int storedCost = 0;
+    unsigned r = 0, p = 0;
+    char saltHex[2 * SALT_BYTES + 1], hashHex[2 * HASH_BYTES + 1];
+    if (std::sscanf(stored.c_str() + std::strlen(PREFIX), "ln=%d,r=%u,p=%u$%32[0-9a-f]$%64[0-9a-f]",
+                    &storedCost, &r, &p, saltHex, hashHex) != 5 ||
+        storedCost < 1 || storedCost > MAX_HASH_COST || r == 0 || p == 0 || p > 16 ||
+        (uint64_t(128) * r << storedCost) > (uint64_t(1) << 30))
+        return false;   // malformed, or would need over 1 GiB
+    std::vector<uint8_t> salt, expected;
+    if (!fromHex(saltHex, salt) || !fromHex(hashHex, expected) || expected.size() != HASH_BYTES)
+        return false;
+
+    uint8_t hash[HASH_BYTES];
+    scrypt(password, salt.data(), salt.size(), uint64_t(1) << storedCost, r, p, hash, sizeof(hash));
+    bool match = sameBytes(hash, expected.data(), HASH_BYTES);
+    rehash = match && (storedCost != cost || r != BLOCK_R || p != 1);
+    return match;
+}
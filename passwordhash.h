@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Password hashing for the users table.
+//
+// Passwords are stored as scrypt hashes (RFC 7914) with a random salt per
+// user. scrypt is memory-hard: every guess needs 128 * r * N bytes of
+// memory as well as the time, so guessing on GPUs gains little. Hashing
+// takes tens of milliseconds by design; the backend does it on its own
+// threads (see cli.cpp) so other requests don't wait on it.
+//
+// Stored form: "$scrypt$ln=<log2 N>,r=<r>,p=<p>$<salt hex>$<hash hex>", so
+// hashes made at another cost still verify after the cost changes.
+
+// log2 of scrypt's N by default: 16 MiB and ~50 ms per hash with r = 8
+const int DEFAULT_HASH_COST = 14;
+const int MIN_HASH_COST = 10;
+const int MAX_HASH_COST = 20;
+
+// A new salted hash of `password` with N = 2^cost, r = 8, p = 1
+std::string hashPassword(const std::string& password, int cost = DEFAULT_HASH_COST);
+
+// True if `password` matches `stored`. `rehash` is set when the match was
+// made against an outdated form: another cost, or a plaintext password from
+// before hashing (compared as it is, once, so the user isn't locked out).
+bool verifyPassword(const std::string& password, const std::string& stored, int cost, bool& rehash);
+
+// PBKDF2-HMAC-SHA256 with one iteration, all scrypt needs
+void pbkdf2Sha256(const std::string& password, const uint8_t* salt, size_t saltLen, uint8_t* out, size_t outLen);
+
+// scrypt(password, salt, N, r, p) into out[0, outLen)
+void scrypt(const std::string& password, const uint8_t* salt, size_t saltLen,
+            uint64_t N, uint32_t r, uint32_t p, uint8_t* out, size_t outLen);
+
+// `bytes` random bytes from the system's generator, as hex
+std::string randomHex(size_t bytes);
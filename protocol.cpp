@@ -0,0 +1,626 @@
+#include "protocol.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+// ---------------------------------------------------------------------------
+// JSON encoder
+// ---------------------------------------------------------------------------
+
+void JsonEncoder::separator()
+{
+    if (afterKey) {         // value directly follows its key
+        afterKey = false;
+        return;
+    }
+    if (!first.empty()) {
+        if (!first.back()) out += ',';
+        first.back() = false;
+    }
+}
+
+void JsonEncoder::beginObject(size_t)
+{
+    separator();
+    out += '{';
+    first.push_back(true);
+}
+
+void JsonEncoder::endObject()
+{
+    out += '}';
+    first.pop_back();
+}
+
+void JsonEncoder::beginArray(size_t)
+{
+    separator();
+    out += '[';
+    first.push_back(true);
+}
+
+void JsonEncoder::endArray()
+{
+    out += ']';
+    first.pop_back();
+}
+
+void JsonEncoder::key(const char* k)
+{
+    separator();
+    out += '"';
+    out += k;
+    out += "\":";
+    afterKey = true;
+}
+
+void JsonEncoder::value(std::string_view s)
+{
+    separator();
+    out += '"';
+    JSON::escapeTo(out, s);
+    out += '"';
+}
+
+void JsonEncoder::value(const char* s)
+{
+    value(std::string_view(s));
+}
+
+void JsonEncoder::value(int v)
+{
+    separator();
+    out += std::to_string(v);
+}
+
+void JsonEncoder::value(uint64_t v)
+{
+    separator();
+    out += std::to_string(v);
+}
+
+void JsonEncoder::value(bool v)
+{
+    separator();
+    out += v ? "true" : "false";
+}
+
+// ---------------------------------------------------------------------------
+// MessagePack encoder (only the subset our responses use)
+// ---------------------------------------------------------------------------
+
+static void putBE(std::string& out, uint32_t v, int bytes)
+{
+    for (int shift = (bytes - 1) * 8; shift >= 0; shift -= 8)
+        out += static_cast<char>((v >> shift) & 0xff);
+}
+
+void MsgpackEncoder::writeString(const char* s, size_t len)
+{
+    if (len < 32) {
+        out += static_cast<char>(0xa0 | len);
+    } else if (len < 0x100) {
+        out += static_cast<char>(0xd9);
+        putBE(out, static_cast<uint32_t>(len), 1);
+    } else if (len < 0x10000) {
+        out += static_cast<char>(0xda);
+        putBE(out, static_cast<uint32_t>(len), 2);
+    } else {
+        out += static_cast<char>(0xdb);
+        putBE(out, static_cast<uint32_t>(len), 4);
+    }
+    out.append(s, len);
+}
+
+void MsgpackEncoder::beginObject(size_t fields)
+{
+    if (fields < 16) {
+        out += static_cast<char>(0x80 | fields);
+    } else if (fields < 0x10000) {
+        out += static_cast<char>(0xde);
+        putBE(out, static_cast<uint32_t>(fields), 2);
+    } else {
+        out += static_cast<char>(0xdf);
+        putBE(out, static_cast<uint32_t>(fields), 4);
+    }
+}
+
+void MsgpackEncoder::beginArray(size_t items)
+{
+    if (items < 16) {
+        out += static_cast<char>(0x90 | items);
+    } else if (items < 0x10000) {
+        out += static_cast<char>(0xdc);
+        putBE(out, static_cast<uint32_t>(items), 2);
+    } else {
+        out += static_cast<char>(0xdd);
+        putBE(out, static_cast<uint32_t>(items), 4);
+    }
+}
+
+void MsgpackEncoder::beginTable(size_t rows, const char* const* fields, size_t fieldCount)
+{
+    beginObject(2);
+    key("fields");
+    beginArray(fieldCount);
+    for (size_t i = 0; i < fieldCount; ++i)
+        key(fields[i]);
+    key("rows");
+    beginArray(rows);
+    tableDepth++;
+}
+
+void MsgpackEncoder::beginRecord(size_t fields)
+{
+    if (tableDepth > 0) beginArray(fields);
+    else beginObject(fields);
+}
+
+void MsgpackEncoder::field(const char* k)
+{
+    if (tableDepth == 0) key(k);
+}
+
+void MsgpackEncoder::key(const char* k)
+{
+    writeString(k, std::strlen(k));
+}
+
+void MsgpackEncoder::value(std::string_view s)
+{
+    writeString(s.data(), s.size());
+}
+
+void MsgpackEncoder::value(const char* s)
+{
+    writeString(s, std::strlen(s));
+}
+
+void MsgpackEncoder::value(int v)
+{
+    if (v >= 0) {
+        uint32_t u = static_cast<uint32_t>(v);
+        if (u < 0x80) {
+            out += static_cast<char>(u);
+        } else if (u < 0x100) {
+            out += static_cast<char>(0xcc);
+            putBE(out, u, 1);
+        } else if (u < 0x10000) {
+            out += static_cast<char>(0xcd);
+            putBE(out, u, 2);
+        } else {
+            out += static_cast<char>(0xce);
+            putBE(out, u, 4);
+        }
+    } else if (v >= -32) {
+        out += static_cast<char>(v);    // negative fixint
+    } else if (v >= -128) {
+        out += static_cast<char>(0xd0);
+        putBE(out, static_cast<uint32_t>(v), 1);
+    } else if (v >= -32768) {
+        out += static_cast<char>(0xd1);
+        putBE(out, static_cast<uint32_t>(v), 2);
+    } else {
+        out += static_cast<char>(0xd2);
+        putBE(out, static_cast<uint32_t>(v), 4);
+    }
+}
+
+void MsgpackEncoder::value(uint64_t v)
+{
+    if (v <= 0x7fffffff) {
+        value(static_cast<int>(v));
+        return;
+    }
+    out += static_cast<char>(0xcf);
+    putBE(out, static_cast<uint32_t>(v >> 32), 4);
+    putBE(out, static_cast<uint32_t>(v), 4);
+}
+
+void MsgpackEncoder::value(bool v)
+{
+    out += static_cast<char>(v ? 0xc3 : 0xc2);
+}
+
+// ---------------------------------------------------------------------------
+// Records
+// ---------------------------------------------------------------------------
+
+const char* const BOOK_FIELDS[8] = {
+    "id", "title", "author", "isbn", "genre", "coverUrl", "borrowed", "issuedTo"
+};
+
+const char* const MEMBER_FIELDS[5] = {
+    "id", "name", "address", "borrowedBookId", "borrowedBooks"
+};
+
+void writeBook(Encoder& enc, const book& b, bool withIssuedTo)
+{
+    enc.beginRecord(withIssuedTo ? 8 : 7);
+    enc.field("id");       enc.value(b.getID());
+    enc.field("title");    enc.value(b.getTitle());
+    enc.field("author");   enc.value(b.getAuthor());
+    enc.field("isbn");     enc.value(b.getISBN());
+    enc.field("genre");    enc.value(book::genretoString(b.getGenre()));
+    enc.field("coverUrl"); enc.value(b.getCoverUrl());
+    enc.field("borrowed"); enc.value(b.getBorrowStatus());
+    if (withIssuedTo) {
+        enc.field("issuedTo"); enc.value(b.getIssuedTo());
+    }
+    enc.endRecord();
+}
+
+void writeMember(Encoder& enc, const member& m)
+{
+    enc.beginRecord(5);
+    enc.field("id");             enc.value(m.getID());
+    enc.field("name");           enc.value(m.getName());
+    enc.field("address");        enc.value(m.getAddress());
+    enc.field("borrowedBookId"); enc.value(m.getBorrowedBookID());
+    enc.field("borrowedBooks");
+    enc.beginArray(m.getLoans().size());
+    for (int bookID : m.getLoans())
+        enc.value(bookID);
+    enc.endArray();
+    enc.endRecord();
+}
+
+const char* const LOAN_EVENT_FIELDS[4] = {
+    "time", "bookId", "memberId", "action"
+};
+
+const char* const LOAN_DAY_FIELDS[3] = {
+    "day", "checkouts", "returns"
+};
+
+void writeLoanEvent(Encoder& enc, const LoanEvent& e)
+{
+    enc.beginRecord(4);
+    enc.field("time");     enc.value(static_cast<int>(e.time));
+    enc.field("bookId");   enc.value(e.bookID);
+    enc.field("memberId"); enc.value(e.memberID);
+    enc.field("action");   enc.value(e.action == LoanAction::checkout ? "checkout" : "return");
+    enc.endRecord();
+}
+
+// Days since 1970-01-01 as a proleptic Gregorian date (H. Hinnant's civil_from_days)
+static std::string isoDate(uint32_t day)
+{
+    long z = static_cast<long>(day) + 719468;
+    long era = z / 146097;
+    long doe = z - era * 146097;
+    long yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    long doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    long mp = (5 * doy + 2) / 153;
+    long d = doy - (153 * mp + 2) / 5 + 1;
+    long m = mp < 10 ? mp + 3 : mp - 9;
+    long y = yoe + era * 400 + (m <= 2 ? 1 : 0);
+    char buf[40];
+    std::snprintf(buf, sizeof(buf), "%04ld-%02ld-%02ld", y, m, d);
+    return buf;
+}
+
+void writeLoanDay(Encoder& enc, const LoanDayCount& d)
+{
+    enc.beginRecord(3);
+    enc.field("day");       enc.value(isoDate(d.day));
+    enc.field("checkouts"); enc.value(d.checkouts);
+    enc.field("returns");   enc.value(d.returns);
+    enc.endRecord();
+}
+
+void beginBookTable(Encoder& enc, size_t rows, bool withIssuedTo)
+{
+    enc.beginTable(rows, BOOK_FIELDS, withIssuedTo ? 8 : 7);
+}
+
+void beginMemberTable(Encoder& enc, size_t rows)
+{
+    enc.beginTable(rows, MEMBER_FIELDS, 5);
+}
+
+// ---------------------------------------------------------------------------
+// Framing
+// ---------------------------------------------------------------------------
+
+void appendFrame(std::string& out, const std::string& payload)
+{
+    putBE(out, static_cast<uint32_t>(payload.size()), 4);
+    out += payload;
+}
+
+bool readFrame(std::istream& in, std::string& payload)
+{
+    unsigned char header[4];
+    if (!in.read(reinterpret_cast<char*>(header), 4))
+        return false;
+
+    uint32_t len = (uint32_t(header[0]) << 24) | (uint32_t(header[1]) << 16) |
+                   (uint32_t(header[2]) << 8) | uint32_t(header[3]);
+    if (len > MAX_FRAME_SIZE)
+        throw std::runtime_error("Frame too large: " + std::to_string(len));
+
+    payload.resize(len);
+    return len == 0 || static_cast<bool>(in.read(&payload[0], len));
+}
+
+bool nextRequest(const std::string& buffer, size_t& offset, WireMode mode, std::string& request)
+{
+    if (mode == WireMode::binary) {
+        if (buffer.size() - offset < 4)
+            return false;
+        const unsigned char* h = reinterpret_cast<const unsigned char*>(buffer.data() + offset);
+        uint32_t len = (uint32_t(h[0]) << 24) | (uint32_t(h[1]) << 16) | (uint32_t(h[2]) << 8) | uint32_t(h[3]);
+        if (len > MAX_FRAME_SIZE)
+            throw std::runtime_error("Frame too large: " + std::to_string(len));
+        if (buffer.size() - offset - 4 < len)
+            return false;
+        request.assign(buffer, offset + 4, len);
+        offset += 4 + len;
+        return true;
+    }
+
+    size_t nl = buffer.find('\n', offset);
+    if (nl == std::string::npos)
+        return false;
+    size_t end = (nl > offset && buffer[nl - 1] == '\r') ? nl - 1 : nl;
+    request.assign(buffer, offset, end - offset);
+    offset = nl + 1;
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// Parsers
+// ---------------------------------------------------------------------------
+
+int SimpleParser::getInt(const std::string& key, int defaultVal) const
+{
+    std::string search = "\"" + key + "\":";
+    size_t pos = raw.find(search);
+    if (pos == std::string::npos) return defaultVal;
+
+    size_t start = pos + search.length();
+    size_t end = raw.find_first_of(",}", start);
+    std::string numStr = raw.substr(start, end - start);
+
+    try {
+        return std::stoi(numStr);
+    } catch (...) {
+        return defaultVal;
+    }
+}
+
+std::string SimpleParser::getString(const std::string& key, const std::string& defaultVal) const
+{
+    std::string search = "\"" + key + "\":\"";
+    size_t pos = raw.find(search);
+    if (pos == std::string::npos) return defaultVal;
+
+    size_t start = pos + search.length();
+    size_t end = raw.find("\"", start);
+    if (end == std::string::npos) return defaultVal;
+
+    return raw.substr(start, end - start);
+}
+
+// Accepts true/false as well as numbers (non-zero is true)
+bool SimpleParser::getBool(const std::string& key, bool defaultVal) const
+{
+    std::string search = "\"" + key + "\":";
+    size_t pos = raw.find(search);
+    if (pos == std::string::npos) return defaultVal;
+
+    size_t start = raw.find_first_not_of(' ', pos + search.length());
+    if (start == std::string::npos) return defaultVal;
+    if (raw.compare(start, 4, "true") == 0) return true;
+    if (raw.compare(start, 5, "false") == 0) return false;
+    return getInt(key, defaultVal ? 1 : 0) != 0;
+}
+
+namespace {
+
+// Containers nested deeper than this are rejected rather than recursed into
+const int MAX_NESTING = 64;
+
+// Cursor over a MessagePack buffer
+struct MsgpackReader {
+    const std::string& buf;
+    size_t pos = 0;
+
+    explicit MsgpackReader(const std::string& b) : buf(b) {}
+
+    uint8_t byte() {
+        if (pos >= buf.size()) throw std::runtime_error("Truncated MessagePack payload");
+        return static_cast<uint8_t>(buf[pos++]);
+    }
+
+    uint64_t be(int bytes) {
+        uint64_t v = 0;
+        for (int i = 0; i < bytes; ++i) v = (v << 8) | byte();
+        return v;
+    }
+
+    std::string text(size_t len) {
+        if (buf.size() - pos < len) throw std::runtime_error("Truncated MessagePack string");
+        std::string s = buf.substr(pos, len);
+        pos += len;
+        return s;
+    }
+
+    void skipBytes(size_t len) {
+        if (buf.size() - pos < len) throw std::runtime_error("Truncated MessagePack payload");
+        pos += len;
+    }
+
+    // Reads a string header and returns its length, or throws if not a string
+    size_t stringLength(uint8_t tag) {
+        if ((tag & 0xe0) == 0xa0) return tag & 0x1f;
+        if (tag == 0xd9) return be(1);
+        if (tag == 0xda) return be(2);
+        if (tag == 0xdb) return be(4);
+        throw std::runtime_error("Expected MessagePack string");
+    }
+
+    // Skips one complete value (including nested containers)
+    void skip(int depth = 0) {
+        uint8_t tag = byte();
+        if (tag <= 0x7f || tag >= 0xe0 || tag == 0xc0 || tag == 0xc2 || tag == 0xc3) return;
+        bool container = (tag & 0xe0) == 0x80 || (tag >= 0xdc && tag <= 0xdf);
+        if (container && ++depth > MAX_NESTING)
+            throw std::runtime_error("MessagePack nesting too deep");
+        if ((tag & 0xf0) == 0x80) { for (int i = 0; i < 2 * (tag & 0x0f); ++i) skip(depth); return; }
+        if ((tag & 0xf0) == 0x90) { for (int i = 0; i < (tag & 0x0f); ++i) skip(depth); return; }
+        switch (tag) {
+            case 0xcc: case 0xd0: skipBytes(1); return;
+            case 0xcd: case 0xd1: skipBytes(2); return;
+            case 0xce: case 0xd2: case 0xca: skipBytes(4); return;
+            case 0xcf: case 0xd3: case 0xcb: skipBytes(8); return;
+            case 0xc4: skipBytes(be(1)); return;
+            case 0xc5: skipBytes(be(2)); return;
+            case 0xc6: skipBytes(be(4)); return;
+            case 0xdc: { uint64_t n = be(2); for (uint64_t i = 0; i < n; ++i) skip(depth); return; }
+            case 0xdd: { uint64_t n = be(4); for (uint64_t i = 0; i < n; ++i) skip(depth); return; }
+            case 0xde: { uint64_t n = be(2); for (uint64_t i = 0; i < 2 * n; ++i) skip(depth); return; }
+            case 0xdf: { uint64_t n = be(4); for (uint64_t i = 0; i < 2 * n; ++i) skip(depth); return; }
+            default: skipBytes(stringLength(tag)); return;
+        }
+    }
+};
+
+} // namespace
+
+MsgpackParser::MsgpackParser(const std::string& payload)
+{
+    MsgpackReader r(payload);
+
+    uint8_t tag = r.byte();
+    uint64_t count;
+    if ((tag & 0xf0) == 0x80) count = tag & 0x0f;
+    else if (tag == 0xde) count = r.be(2);
+    else if (tag == 0xdf) count = r.be(4);
+    else throw std::runtime_error("Request must be a MessagePack map");
+
+    for (uint64_t i = 0; i < count; ++i) {
+        Field f;
+        f.key = r.text(r.stringLength(r.byte()));
+
+        uint8_t t = static_cast<uint8_t>(payload.at(r.pos));
+        if (t <= 0x7f) { f.number = t; r.pos++; }
+        else if (t >= 0xe0) { f.number = static_cast<int8_t>(t); r.pos++; }
+        else if (t == 0xc2 || t == 0xc3) { f.number = (t == 0xc3); r.pos++; }
+        else if (t >= 0xcc && t <= 0xcf) {
+            r.pos++;
+            uint64_t value = r.be(1 << (t - 0xcc));
+            if (value > static_cast<uint64_t>(LLONG_MAX)) continue;    // out of range: treated as absent
+            f.number = static_cast<long long>(value);
+        }
+        else if (t >= 0xd0 && t <= 0xd3) {
+            r.pos++;
+            int bytes = 1 << (t - 0xd0);
+            uint64_t raw = r.be(bytes);
+            int shift = 64 - bytes * 8;
+            f.number = static_cast<long long>(raw << shift) >> shift;   // sign-extend
+        }
+        else if (t == 0xcb) {
+            r.pos++;
+            uint64_t bits = r.be(8);
+            double d;
+            std::memcpy(&d, &bits, sizeof d);
+            if (!(d >= -9.2e18 && d <= 9.2e18)) continue;   // NaN, infinite or out of range
+            f.number = static_cast<long long>(d);
+        }
+        else if ((t & 0xe0) == 0xa0 || t == 0xd9 || t == 0xda || t == 0xdb) {
+            r.pos++;
+            f.isString = true;
+            f.text = r.text(r.stringLength(t));
+        }
+        else { r.skip(); continue; }    // nil, nested containers, binary: ignored
+
+        fields.push_back(std::move(f));
+    }
+}
+
+const MsgpackParser::Field* MsgpackParser::find(const std::string& key) const
+{
+    for (const auto& f : fields)
+        if (f.key == key) return &f;
+    return nullptr;
+}
+
+int MsgpackParser::getInt(const std::string& key, int defaultVal) const
+{
+    const Field* f = find(key);
+    if (!f) return defaultVal;
+    if (!f->isString)
+        return f->number < INT_MIN || f->number > INT_MAX ? defaultVal : static_cast<int>(f->number);
+    try {
+        return std::stoi(f->text);
+    } catch (...) {
+        return defaultVal;
+    }
+}
+
+std::string MsgpackParser::getString(const std::string& key, const std::string& defaultVal) const
+{
+    const Field* f = find(key);
+    if (!f || !f->isString) return defaultVal;
+    return f->text;
+}
+
+bool MsgpackParser::getBool(const std::string& key, bool defaultVal) const
+{
+    const Field* f = find(key);
+    if (!f || f->isString) return defaultVal;
+    return f->number != 0;
+}
+
+bool maskFields(std::string& request, WireMode mode, const std::vector<std::string>& keys)
+{
+    if (mode == WireMode::json) {
+        for (const auto& key : keys) {
+            std::string search = "\"" + key + "\"";
+            for (size_t pos = request.find(search); pos != std::string::npos; pos = request.find(search, pos)) {
+                pos = request.find_first_not_of(' ', pos + search.size());
+                if (pos == std::string::npos || request[pos] != ':') continue;
+                pos = request.find_first_not_of(' ', pos + 1);
+                if (pos == std::string::npos || request[pos] != '"') continue;
+                for (++pos; pos < request.size() && request[pos] != '"'; ++pos) {
+                    if (request[pos] == '\\' && pos + 1 < request.size())
+                        request[pos++] = '*';
+                    request[pos] = '*';
+                }
+            }
+        }
+        return true;
+    }
+
+    try {
+        MsgpackReader r(request);
+        uint8_t tag = r.byte();
+        uint64_t count;
+        if ((tag & 0xf0) == 0x80) count = tag & 0x0f;
+        else if (tag == 0xde) count = r.be(2);
+        else if (tag == 0xdf) count = r.be(4);
+        else return false;
+
+        for (uint64_t i = 0; i < count; ++i) {
+            std::string key = r.text(r.stringLength(r.byte()));
+            uint8_t t = static_cast<uint8_t>(request.at(r.pos));
+            if (std::find(keys.begin(), keys.end(), key) == keys.end() ||
+                !((t & 0xe0) == 0xa0 || t == 0xd9 || t == 0xda || t == 0xdb)) {
+                r.skip();
+                continue;
+            }
+            r.pos++;
+            size_t len = r.stringLength(t);
+            r.skipBytes(len);
+            std::fill(request.begin() + (r.pos - len), request.begin() + r.pos, '*');
+        }
+        return true;
+    } catch (const std::exception&) {
+        return false;
+    }
+}
@@ -0,0 +1,226 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include <istream>
+#include <functional>
+
+#include "book.h"
+#include "member.h"
+#include "loanlog.h"
+
+// Minimal JSON builder (no external dependency)
+class JSON {
+public:
+    std::string data;
+
+    JSON() : data("{}") {}
+
+    static JSON object() { JSON j; j.data = "{}"; return j; }
+    static JSON array() { JSON j; j.data = "[]"; return j; }
+
+    static std::string escape(const std::string& s) {
+        std::string result;
+        escapeTo(result, s);
+        return result;
+    }
+
+    // Appends the escaped form of s to out (no temporary string)
+    static void escapeTo(std::string& out, std::string_view s) {
+        for (char c : s) {
+            switch (c) {
+                case '"': out += "\\\""; break;
+                case '\\': out += "\\\\"; break;
+                case '\n': out += "\\n"; break;
+                case '\r': out += "\\r"; break;
+                case '\t': out += "\\t"; break;
+                default: out += c;
+            }
+        }
+    }
+
+    static std::string stringify(const std::string& key, const std::string& value) {
+        return "\"" + key + "\":\"" + escape(value) + "\"";
+    }
+
+    static std::string stringify(const std::string& key, int value) {
+        return "\"" + key + "\":" + std::to_string(value);
+    }
+
+    static std::string stringify(const std::string& key, bool value) {
+        return "\"" + key + "\":" + (value ? "true" : "false");
+    }
+};
+
+// How a session talks to us: newline-delimited JSON (the default) or
+// length-prefixed frames carrying MessagePack (negotiated via setProtocol).
+enum class WireMode {
+    json,
+    binary
+};
+
+// One connected client: its negotiated wire mode and where its replies go.
+// `send` receives complete, already framed messages and must be thread-safe.
+struct Session {
+    WireMode mode = WireMode::json;
+    std::function<void(const std::string& bytes)> send;
+};
+
+// Writes one response value into `out`.
+// Containers declare their element count up front because MessagePack
+// needs it; the JSON writer simply ignores the counts.
+//
+// Lists of records go through beginTable/beginRecord/field: JSON writes an
+// array of objects as before, MessagePack writes the field names once and
+// then one positional array per row.
+class Encoder {
+public:
+    std::string out;
+
+    virtual ~Encoder() = default;
+
+    virtual void beginTable(size_t rows, const char* const* fields, size_t fieldCount) = 0;
+    virtual void endTable() = 0;
+    virtual void beginRecord(size_t fields) = 0;
+    virtual void endRecord() = 0;
+    virtual void field(const char* k) = 0;
+
+    virtual void beginObject(size_t fields) = 0;
+    virtual void endObject() = 0;
+    virtual void beginArray(size_t items) = 0;
+    virtual void endArray() = 0;
+    virtual void key(const char* k) = 0;
+    virtual void value(std::string_view s) = 0;
+    virtual void value(const char* s) = 0;
+    virtual void value(int v) = 0;
+    virtual void value(uint64_t v) = 0;     // counts and byte sizes past INT_MAX
+    virtual void value(bool v) = 0;
+};
+
+class JsonEncoder : public Encoder {
+    std::vector<bool> first;   // one entry per open container
+    bool afterKey = false;
+
+    void separator();
+
+public:
+    void beginTable(size_t rows, const char* const*, size_t) override { beginArray(rows); }
+    void endTable() override { endArray(); }
+    void beginRecord(size_t fields) override { beginObject(fields); }
+    void endRecord() override { endObject(); }
+    void field(const char* k) override { key(k); }
+    void beginObject(size_t fields) override;
+    void endObject() override;
+    void beginArray(size_t items) override;
+    void endArray() override;
+    void key(const char* k) override;
+    void value(std::string_view s) override;
+    void value(const char* s) override;
+    void value(int v) override;
+    void value(uint64_t v) override;
+    void value(bool v) override;
+};
+
+class MsgpackEncoder : public Encoder {
+    int tableDepth = 0;    // records inside a table are written without keys
+
+    void writeString(const char* s, size_t len);
+
+public:
+    void beginTable(size_t rows, const char* const* fields, size_t fieldCount) override;
+    void endTable() override { tableDepth--; }
+    void beginRecord(size_t fields) override;
+    void endRecord() override {}
+    void field(const char* k) override;
+    void beginObject(size_t fields) override;
+    void endObject() override {}
+    void beginArray(size_t items) override;
+    void endArray() override {}
+    void key(const char* k) override;
+    void value(std::string_view s) override;
+    void value(const char* s) override;
+    void value(int v) override;
+    void value(uint64_t v) override;
+    void value(bool v) override;
+};
+
+// Record encoders shared by every list/search response.
+// searchBooks has never reported issuedTo, so it is optional here.
+// borrowedBookId is the member's most recent loan, borrowedBooks all of them.
+extern const char* const BOOK_FIELDS[8];
+extern const char* const MEMBER_FIELDS[5];
+
+void writeBook(Encoder& enc, const book& b, bool withIssuedTo = true);
+void writeMember(Encoder& enc, const member& m);
+
+void beginBookTable(Encoder& enc, size_t rows, bool withIssuedTo = true);
+void beginMemberTable(Encoder& enc, size_t rows);
+
+// Loan history: time in seconds since 1970, action "checkout" or "return";
+// day counts are keyed by UTC date ("2024-05-31")
+extern const char* const LOAN_EVENT_FIELDS[4];
+extern const char* const LOAN_DAY_FIELDS[3];
+
+void writeLoanEvent(Encoder& enc, const LoanEvent& e);
+void writeLoanDay(Encoder& enc, const LoanDayCount& d);
+
+// Binary framing: 4-byte big-endian payload length, then the payload.
+const uint32_t MAX_FRAME_SIZE = 64u * 1024u * 1024u;
+
+void appendFrame(std::string& out, const std::string& payload);
+bool readFrame(std::istream& in, std::string& payload);
+
+// Takes the next complete request (line or frame) from buffer[offset...] and
+// advances offset past it; false if the buffer ends mid-request.
+bool nextRequest(const std::string& buffer, size_t& offset, WireMode mode, std::string& request);
+
+// Field access for one incoming request, independent of its encoding.
+class RequestParser {
+public:
+    virtual ~RequestParser() = default;
+
+    virtual int getInt(const std::string& key, int defaultVal = 0) const = 0;
+    virtual std::string getString(const std::string& key, const std::string& defaultVal = "") const = 0;
+    virtual bool getBool(const std::string& key, bool defaultVal = false) const = 0;
+};
+
+// Simple JSON parser (extracts basic fields)
+class SimpleParser : public RequestParser {
+public:
+    std::string raw;
+
+    SimpleParser(const std::string& input) : raw(input) {}
+
+    int getInt(const std::string& key, int defaultVal = 0) const override;
+    std::string getString(const std::string& key, const std::string& defaultVal = "") const override;
+    bool getBool(const std::string& key, bool defaultVal = false) const override;
+};
+
+// Decodes a flat MessagePack map (string keys, scalar values).
+// Nested values are skipped (up to 64 levels deep), as are numbers outside
+// the range of long long; malformed input throws std::runtime_error.
+class MsgpackParser : public RequestParser {
+    struct Field {
+        std::string key;
+        bool isString = false;
+        long long number = 0;
+        std::string text;
+    };
+    std::vector<Field> fields;
+
+    const Field* find(const std::string& key) const;
+
+public:
+    MsgpackParser(const std::string& payload);
+
+    int getInt(const std::string& key, int defaultVal = 0) const override;
+    std::string getString(const std::string& key, const std::string& defaultVal = "") const override;
+    bool getBool(const std::string& key, bool defaultVal = false) const override;
+};
+
+// Overwrites the string values of the top-level `keys` of a request with '*'
+// in place, keeping its length and so its framing. False if a binary request
+// is malformed; it may then be partly overwritten.
+bool maskFields(std::string& request, WireMode mode, const std::vector<std::string>& keys);
@@ -0,0 +1,261 @@
+// Checks of the wire protocol (see protocol.h).
+//
+// Usage: sem_project_focp_protocolcheck [test...]
+//
+//   msgpack     MsgpackParser on every integer width, floats, strings and
+//               nested values, including numbers out of range, NaN, too
+//               deep nesting and truncated or non-map payloads
+//   framing     appendFrame, readFrame and nextRequest: frames and lines
+//               split anywhere, several in one buffer, oversized headers
+//   masking     maskFields on JSON and MessagePack requests
+//
+// Prints one line per test and exits non-zero if any check failed.
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "protocol.h"
+
+namespace {
+
+struct Checks {
+    const char* test;
+    int checks = 0;
+    int failures = 0;
+
+    explicit Checks(const char* name) : test(name) {}
+
+    void expect(bool ok, const std::string& what)
+    {
+        ++checks;
+        if (ok)
+            return;
+        ++failures;
+        std::cerr << test << ": " << what << std::endl;
+    }
+
+    int report() const
+    {
+        std::cout << test << ": " << (failures ? "FAIL" : "OK") << " checks=" << checks
+                  << " failures=" << failures << std::endl;
+        return failures ? 1 : 0;
+    }
+};
+
+// Hand-built MessagePack, for what MsgpackEncoder never writes
+struct Pack {
+    std::string out;
+
+    Pack& map(uint8_t entries) { out += static_cast<char>(0x80 | entries); return *this; }
+    Pack& str(const std::string& s)
+    {
+        out += static_cast<char>(0xa0 | s.size());
+        out += s;
+        return *this;
+    }
+    Pack& tagged(uint8_t tag, uint64_t bits, int bytes)
+    {
+        out += static_cast<char>(tag);
+        for (int i = bytes - 1; i >= 0; --i)
+            out += static_cast<char>((bits >> (8 * i)) & 0xff);
+        return *this;
+    }
+    Pack& float64(double d)
+    {
+        uint64_t bits;
+        std::memcpy(&bits, &d, sizeof bits);
+        return tagged(0xcb, bits, 8);
+    }
+};
+
+bool throws(const std::string& payload)
+{
+    try {
+        MsgpackParser p(payload);
+    } catch (const std::runtime_error&) {
+        return true;
+    }
+    return false;
+}
+
+int testMsgpack()
+{
+    Checks c("msgpack");
+
+    MsgpackEncoder enc;
+    enc.beginObject(8);
+    enc.key("id");     enc.value(7);
+    enc.key("neg");    enc.value(-40000);
+    enc.key("big");    enc.value(static_cast<uint64_t>(1) << 40);
+    enc.key("name");   enc.value(std::string(300, 'x'));
+    enc.key("flag");   enc.value(true);
+    enc.key("list");   enc.beginArray(2); enc.value(1); enc.value("two"); enc.endArray();
+    enc.key("nested"); enc.beginObject(1); enc.key("id"); enc.value(99); enc.endObject();
+    enc.key("small");  enc.value(-5);
+    enc.endObject();
+    MsgpackParser p(enc.out);
+    c.expect(p.getInt("id") == 7, "fixint");
+    c.expect(p.getInt("neg") == -40000, "int32");
+    c.expect(p.getInt("small") == -5, "negative fixint");
+    c.expect(p.getInt("big", 99) == 99, "2^40 read as an int");
+    c.expect(p.getString("name") == std::string(300, 'x'), "str16");
+    c.expect(p.getBool("flag") && !p.getBool("missing"), "bool");
+    c.expect(p.getString("list", "none") == "none" && p.getInt("list", -1) == -1, "array not skipped");
+    c.expect(p.getInt("id") == 7, "nested id replaced the top-level one");
+
+    // Every integer width, then floats
+    Pack widths;
+    widths.map(8).str("u8").tagged(0xcc, 200, 1).str("u16").tagged(0xcd, 60000, 2)
+          .str("u32").tagged(0xce, 2000000000, 4).str("u64").tagged(0xcf, 12345, 8)
+          .str("i8").tagged(0xd0, 0x80, 1).str("i16").tagged(0xd1, 0x8000, 2)
+          .str("i32").tagged(0xd2, 0x80000000u, 4).str("i64").tagged(0xd3, static_cast<uint64_t>(-3), 8);
+    MsgpackParser w(widths.out);
+    c.expect(w.getInt("u8") == 200 && w.getInt("u16") == 60000 && w.getInt("u32") == 2000000000 &&
+             w.getInt("u64") == 12345, "unsigned widths");
+    c.expect(w.getInt("i8") == -128 && w.getInt("i16") == -32768 && w.getInt("i32") == INT32_MIN &&
+             w.getInt("i64") == -3, "signed widths");
+
+    // Out of range for int, or for long long: the default, not a wrapped value
+    Pack range;
+    range.map(7).str("u32").tagged(0xce, 0xffffffffu, 4).str("u64").tagged(0xcf, UINT64_MAX, 8)
+         .str("f").float64(42.9).str("nan").float64(std::nan(""))
+         .str("inf").float64(std::numeric_limits<double>::infinity()).str("huge").float64(1e300)
+         .str("i64").tagged(0xd3, static_cast<uint64_t>(INT64_MIN), 8);
+    MsgpackParser r(range.out);
+    c.expect(r.getInt("u32", 99) == 99, "uint32 past INT_MAX wrapped");
+    c.expect(r.getInt("u64", 99) == 99 && !r.getBool("u64"), "uint64 past LLONG_MAX kept");
+    c.expect(r.getInt("f") == 42, "float64 not truncated to 42");
+    c.expect(r.getInt("nan", 99) == 99 && r.getInt("inf", 99) == 99 && r.getInt("huge", 99) == 99,
+             "NaN, infinity or 1e300 read as a number");
+    c.expect(r.getInt("i64", 99) == 99, "INT64_MIN wrapped");
+
+    // Malformed
+    std::string deep = "\x81\xa1x";
+    for (int i = 0; i < 100; ++i)
+        deep += '\x91';
+    deep += '\x01';
+    c.expect(throws(deep), "100 levels of nesting accepted");
+    c.expect(!throws("\x81\xa1x" + std::string(60, '\x91') + "\x01"), "60 levels of nesting refused");
+    c.expect(throws("\x92\x01\x02"), "array accepted as a request");
+    c.expect(throws("\x82\xa2id\x01"), "missing entry accepted");
+    c.expect(throws("\x81\xa4name\xa5" "ab"), "truncated string accepted");
+    c.expect(throws("\x81\xa1x\xcd\x01"), "truncated uint16 accepted");
+    c.expect(throws(""), "empty payload accepted");
+    return c.report();
+}
+
+int testFraming()
+{
+    Checks c("framing");
+
+    std::string stream;
+    appendFrame(stream, "first");
+    appendFrame(stream, "");
+    appendFrame(stream, std::string(70000, 'z'));
+    c.expect(stream.size() == 4 + 5 + 4 + 4 + 70000 && stream.compare(0, 4, std::string("\0\0\0\5", 4)) == 0,
+             "frame header");
+
+    // Fed a byte at a time, every frame comes out whole, once
+    std::string buffer, request;
+    std::vector<std::string> got;
+    size_t offset = 0;
+    for (char ch : stream) {
+        buffer += ch;
+        while (nextRequest(buffer, offset, WireMode::binary, request))
+            got.push_back(request);
+    }
+    c.expect(got.size() == 3 && got[0] == "first" && got[1].empty() && got[2] == std::string(70000, 'z') &&
+             offset == buffer.size(), "frames split byte by byte");
+
+    std::istringstream in(stream);
+    bool ok = readFrame(in, request) && request == "first" && readFrame(in, request) && request.empty() &&
+              readFrame(in, request) && request.size() == 70000 && !readFrame(in, request);
+    c.expect(ok, "readFrame");
+    std::istringstream truncated(stream.substr(0, 7));
+    c.expect(!readFrame(truncated, request), "truncated frame read");
+
+    std::string oversized("\x04\x00\x00\x01", 4);
+    offset = 0;
+    bool threw = false;
+    try {
+        nextRequest(oversized, offset, WireMode::binary, request);
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    c.expect(threw && offset == 0, "64 MiB + 1 frame accepted by nextRequest");
+    std::istringstream big(oversized);
+    threw = false;
+    try {
+        readFrame(big, request);
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    c.expect(threw, "64 MiB + 1 frame accepted by readFrame");
+
+    // JSON lines: CRLF trimmed, a partial line waits
+    std::string lines = "{\"id\":1}\r\n\n{\"id\":2}\n{\"id\"";
+    offset = 0;
+    got.clear();
+    while (nextRequest(lines, offset, WireMode::json, request))
+        got.push_back(request);
+    c.expect(got.size() == 3 && got[0] == "{\"id\":1}" && got[1].empty() && got[2] == "{\"id\":2}" &&
+             lines.compare(offset, std::string::npos, "{\"id\"") == 0, "JSON lines");
+    return c.report();
+}
+
+int testMasking()
+{
+    Checks c("masking");
+    const std::vector<std::string> keys = {"password", "token"};
+
+    std::string json = "{\"id\":1,\"method\":\"login\",\"username\":\"password\",\"password\": \"se\\\"cret\",\"token\":\"t0k\"}";
+    std::string masked = json;
+    c.expect(maskFields(masked, WireMode::json, keys), "JSON refused");
+    c.expect(masked == "{\"id\":1,\"method\":\"login\",\"username\":\"password\",\"password\": \"********\",\"token\":\"***\"}",
+             "JSON: " + masked);
+
+    MsgpackEncoder enc;
+    enc.beginObject(4);
+    enc.key("id");       enc.value(2);
+    enc.key("username"); enc.value("token");
+    enc.key("password"); enc.value("hunter2");
+    enc.key("nested");   enc.beginObject(1); enc.key("token"); enc.value("deep"); enc.endObject();
+    enc.endObject();
+    std::string binary = enc.out;
+    c.expect(maskFields(binary, WireMode::binary, keys), "MessagePack refused");
+    MsgpackParser p(binary);
+    c.expect(binary.size() == enc.out.size() && p.getString("password") == "*******" &&
+             p.getString("username") == "token" && p.getInt("id") == 2, "MessagePack fields");
+
+    std::string broken = "\x81\xa8password\xa5" "ab";
+    c.expect(!maskFields(broken, WireMode::binary, keys), "truncated MessagePack masked");
+    return c.report();
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    std::vector<std::string> tests(argv + 1, argv + argc);
+    if (tests.empty())
+        tests = {"msgpack", "framing", "masking"};
+
+    int failed = 0;
+    for (const auto& name : tests) {
+        if (name == "msgpack") failed += testMsgpack();
+        else if (name == "framing") failed += testFraming();
+        else if (name == "masking") failed += testMasking();
+        else {
+            std::cerr << "Unknown test: " << name << std::endl;
+            return 2;
+        }
+    }
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,242 @@
+#include "recommender.h"
+
+#include <algorithm>
+
+namespace {
+
+// Weights of the three scores, each scaled to 0..1 before they are added
+const double CO_BORROW_WEIGHT = 0.6;
+const double GENRE_WEIGHT = 0.3;
+const double POPULAR_WEIGHT = 0.1;
+
+// Books looked at when too few candidates are on the shelf
+const size_t FALLBACK_SCAN = 4096;
+
+} // namespace
+
+void Recommender::addNeighbour(std::vector<Counted>& list, int bookID)
+{
+    for (auto& n : list) {
+        if (n.bookID == bookID) {
+            ++n.count;
+            return;
+        }
+    }
+    if (list.size() < NEIGHBOURS) {
+        list.push_back({bookID, 1});
+        return;
+    }
+    auto least = std::min_element(list.begin(), list.end(),
+                                  [](const Counted& a, const Counted& b) { return a.count < b.count; });
+    *least = {bookID, least->count + 1};
+}
+
+void Recommender::updatePopular(int bookID, const BookStats& stats)
+{
+    // Counts only grow, so a book enters the list as soon as it passes the
+    // least borrowed one there; the list stays the true top POPULAR
+    std::vector<Counted>& list = popular[static_cast<size_t>(stats.genre)];
+    for (auto& p : list) {
+        if (p.bookID == bookID) {
+            p.count = stats.borrowed;
+            return;
+        }
+    }
+    if (list.size() < POPULAR) {
+        list.push_back({bookID, stats.borrowed});
+        return;
+    }
+    auto least = std::min_element(list.begin(), list.end(),
+                                  [](const Counted& a, const Counted& b) { return a.count < b.count; });
+    if (stats.borrowed > least->count)
+        *least = {bookID, stats.borrowed};
+}
+
+void Recommender::recordCheckout(int memberID, int bookID, Genre genre)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    BookStats& stats = books[bookID];
+    stats.genre = genre;
+    ++stats.borrowed;
+    MemberStats& m = members[memberID];
+    ++m.genres[static_cast<size_t>(genre)];
+
+    // Pair the book with each distinct one the member borrowed lately
+    for (size_t i = 0; i < m.recent.size(); ++i) {
+        int other = m.recent[i];
+        if (other == bookID || std::find(m.recent.begin(), m.recent.begin() + static_cast<std::ptrdiff_t>(i), other) !=
+                                   m.recent.begin() + static_cast<std::ptrdiff_t>(i))
+            continue;
+        addNeighbour(stats.neighbours, other);
+        auto it = books.find(other);
+        if (it != books.end())
+            addNeighbour(it->second.neighbours, bookID);
+    }
+    if (m.recent.size() < HISTORY) {
+        m.recent.push_back(bookID);
+    } else {
+        m.recent[m.next] = bookID;
+        m.next = (m.next + 1) % HISTORY;
+    }
+    updatePopular(bookID, stats);
+}
+
+void Recommender::forgetBook(int bookID)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    // Other books' neighbour lists may still name it; recommend() skips
+    // whatever is no longer in the catalog
+    books.erase(bookID);
+    for (auto& list : popular)
+        list.erase(std::remove_if(list.begin(), list.end(), [bookID](const Counted& p) { return p.bookID == bookID; }),
+                   list.end());
+}
+
+void Recommender::forgetMember(int memberID)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    members.erase(memberID);
+}
+
+void Recommender::clear()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    members.clear();
+    books.clear();
+    for (auto& list : popular)
+        list.clear();
+}
+
+std::vector<Recommendation> Recommender::recommend(const Catalog& snap, int memberID, size_t count) const
+{
+    std::vector<Recommendation> picks;
+    if (count == 0)
+        return picks;
+
+    // Candidate -> co-borrow, genre and popularity scores
+    std::unordered_map<int, std::array<double, 3>> candidates;
+    std::vector<int> recent;
+    size_t favourite = GENRES;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto m = members.find(memberID);
+        if (m != members.end()) {
+            const MemberStats& ms = m->second;
+            recent = ms.recent;
+
+            // Books borrowed with the member's own, later checkouts weighing more
+            double coMax = 0;
+            for (size_t i = 0; i < recent.size(); ++i) {
+                size_t age = (ms.next + recent.size() - 1 - i) % recent.size();     // 0: latest
+                double weight = 1.0 - 0.5 * static_cast<double>(age) / HISTORY;
+                auto b = books.find(recent[i]);
+                if (b == books.end())
+                    continue;
+                for (const auto& n : b->second.neighbours) {
+                    double& s = candidates[n.bookID][0];
+                    s += weight * n.count;
+                    coMax = std::max(coMax, s);
+                }
+            }
+            if (coMax > 0)
+                for (auto& c : candidates)
+                    c.second[0] /= coMax;
+
+            // The popular books of each genre, by the member's share of it
+            uint32_t total = 0;
+            for (size_t g = 0; g < GENRES; ++g) {
+                total += ms.genres[g];
+                if (favourite == GENRES || ms.genres[g] > ms.genres[favourite])
+                    favourite = g;
+            }
+            for (size_t g = 0; g < GENRES && total > 0; ++g) {
+                if (ms.genres[g] == 0 || popular[g].empty())
+                    continue;
+                double share = static_cast<double>(ms.genres[g]) / total;
+                uint32_t top = 0;
+                for (const auto& p : popular[g])
+                    top = std::max(top, p.count);
+                for (const auto& p : popular[g])
+                    candidates[p.bookID][1] += share * p.count / top;
+            }
+        }
+
+        uint32_t top = 0;
+        for (const auto& list : popular)
+            for (const auto& p : list)
+                top = std::max(top, p.count);
+        for (const auto& list : popular)
+            for (const auto& p : list)
+                candidates[p.bookID][2] = static_cast<double>(p.count) / top;
+    }
+
+    auto wanted = [&](int bookID) -> const book* {
+        if (std::find(recent.begin(), recent.end(), bookID) != recent.end())
+            return nullptr;
+        const book* b = snap.findBook(bookID);
+        return (b && !b->getBorrowStatus()) ? b : nullptr;
+    };
+
+    for (const auto& c : candidates) {
+        const book* b = wanted(c.first);
+        if (!b)
+            continue;
+        double parts[3] = {CO_BORROW_WEIGHT * c.second[0], GENRE_WEIGHT * c.second[1], POPULAR_WEIGHT * c.second[2]};
+        size_t best = static_cast<size_t>(std::max_element(parts, parts + 3) - parts);
+        picks.push_back({b, parts[0] + parts[1] + parts[2], static_cast<RecommendReason>(best)});
+    }
+    std::sort(picks.begin(), picks.end(), [](const Recommendation& a, const Recommendation& b) {
+        return a.score != b.score ? a.score > b.score : a.b->getID() < b.b->getID();
+    });
+    if (picks.size() > count)
+        picks.resize(count);
+
+    // Too little history: fill up from the shelf, the member's genre first
+    if (picks.size() < count) {
+        std::vector<const book*> sameGenre, other;
+        size_t scanned = 0;
+        for (const auto& b : snap.books) {
+            if (++scanned > FALLBACK_SCAN)
+                break;
+            if (candidates.count(b.getID()) || !wanted(b.getID()))
+                continue;
+            if (static_cast<size_t>(b.getGenre()) == favourite)
+                sameGenre.push_back(&b);
+            else
+                other.push_back(&b);
+        }
+        for (const auto* list : {&sameGenre, &other})
+            for (const book* b : *list)
+                if (picks.size() < count)
+                    picks.push_back({b, 0.0, RecommendReason::available});
+    }
+    return picks;
+}
+
+void Recommender::memoryUsage(std::vector<MemoryItem>& out) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    MemoryItem m;
+    m.name = "recommender.members";
+    m.count = members.size();
+    m.used = m.reserved = hashTableBytes(members);
+    for (const auto& entry : members) {
+        m.used += entry.second.recent.size() * sizeof(int);
+        m.reserved += entry.second.recent.capacity() * sizeof(int);
+    }
+    out.push_back(m);
+
+    MemoryItem b;
+    b.name = "recommender.books";
+    b.count = books.size();
+    b.used = b.reserved = hashTableBytes(books);
+    for (const auto& entry : books) {
+        b.used += entry.second.neighbours.size() * sizeof(Counted);
+        b.reserved += entry.second.neighbours.capacity() * sizeof(Counted);
+    }
+    for (const auto& list : popular) {
+        b.used += list.size() * sizeof(Counted);
+        b.reserved += list.capacity() * sizeof(Counted);
+    }
+    out.push_back(b);
+}
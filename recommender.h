@@ -0,0 +1,97 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "book.h"
+#include "catalog.h"
+#include "memstats.h"
+
+// Book recommendations for the recommend method.
+//
+// Two kinds of statistics are kept, both updated on every checkout:
+//  - co-borrowing: for each book, the books most often borrowed by the same
+//    members (within each member's last HISTORY checkouts);
+//  - genre affinity: how many of each member's checkouts fall in each
+//    genre, and the most borrowed books of every genre.
+// Every list is capped, so memory grows with the books and members that
+// circulate, and a recommendation looks at no more than
+// HISTORY * NEIGHBOURS + GENRES * POPULAR candidates, however large the
+// catalog. At startup the statistics are rebuilt from the latest
+// checkouts in the loan history (see library::loadCatalog).
+//
+// Neighbour lists are bounded with the space-saving scheme: a new book
+// takes the place of the least counted one and inherits its count, so
+// books borrowed together often stay in and one-off pairs churn.
+
+const size_t GENRES = static_cast<size_t>(Genre::unknown) + 1;
+
+// Why a book was recommended
+enum class RecommendReason {
+    coBorrowed,     // borrowed by members who borrowed the member's books
+    genre,          // popular in a genre the member reads
+    popular,        // popular overall
+    available       // on the shelf; only when too little else qualified
+};
+
+struct Recommendation {
+    const book* b;          // in the snapshot passed to recommend()
+    double score;
+    RecommendReason reason;
+};
+
+class Recommender
+{
+    public:
+
+    static const size_t HISTORY = 32;       // checkouts remembered per member
+    static const size_t NEIGHBOURS = 24;    // co-borrowed books kept per book
+    static const size_t POPULAR = 64;       // most borrowed books kept per genre
+    // Checkouts read back from the loan history at startup; replaying one
+    // costs a few microseconds, so this keeps it to tens of milliseconds
+    static const size_t REBUILD_CHECKOUTS = 50000;
+
+    void recordCheckout(int memberID, int bookID, Genre genre);
+    void forgetBook(int bookID);
+    void forgetMember(int memberID);
+    void clear();
+
+    // Up to `count` books on the shelf in `snap` for `memberID` (0, or a
+    // member without history: the most borrowed ones), best first. Books
+    // the member borrowed lately are left out.
+    std::vector<Recommendation> recommend(const Catalog& snap, int memberID, size_t count) const;
+
+    // The member table, the co-borrow lists and the counts
+    void memoryUsage(std::vector<MemoryItem>& out) const;
+
+    private:
+
+    struct Counted {
+        int bookID;
+        uint32_t count;
+    };
+
+    struct MemberStats {
+        std::vector<int> recent;                // last HISTORY checkouts, a ring
+        size_t next = 0;                        // ring slot to overwrite
+        std::array<uint32_t, GENRES> genres{};  // checkouts per genre
+    };
+
+    struct BookStats {
+        uint32_t borrowed = 0;
+        Genre genre = Genre::unknown;
+        std::vector<Counted> neighbours;        // at most NEIGHBOURS
+    };
+
+    mutable std::mutex mutex;
+    std::unordered_map<int, MemberStats> members;
+    std::unordered_map<int, BookStats> books;
+    std::array<std::vector<Counted>, GENRES> popular;  // at most POPULAR each
+
+    static void addNeighbour(std::vector<Counted>& list, int bookID);
+    void updatePopular(int bookID, const BookStats& stats);
+};
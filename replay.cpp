@@ -0,0 +1,482 @@
+// Replays a request capture (see capture.h) against a running backend and
+// reports how it coped.
+//
+// Usage: sem_project_focp_replay CAPTURE SOCKET [--speed X] [--fast] [--timeout S]
+//
+//   --speed X    X times the captured pace (default 1: as captured)
+//   --fast       send each request as soon as the one before it is sent
+//   --timeout S  wait at most S seconds for replies after the last request
+//                has gone out (default 30)
+//
+// The backend must be listening on SOCKET (--listen). Each captured session
+// gets a connection of its own, so concurrent clients stay concurrent.
+// Unix only, like --listen; CMake builds it only there.
+// To reproduce production traffic locally, run the backend in a scratch
+// directory on a copy of its database (lms.db and the lms.db.* files next
+// to it):
+//
+//   cd /tmp/replay && cp ~/lms/lms.db* . && sem_project_focp --listen lms.sock --workers 4 &
+//   sem_project_focp_replay capture.jsonl /tmp/replay/lms.sock --speed 4
+//
+// The capture has passwords and session tokens overwritten (see capture.h),
+// so login and register are not sent, and a backend started with
+// --require-auth would refuse most requests: replay stops at the first
+// "Not signed in". Replay against one started without it.
+//
+// Latency runs from sending a request to its final reply. A reply whose
+// success differs from the one captured is reported (the first few in
+// full); the exit status is 1 if any did or if a reply never came.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "metrics.h"
+#include "protocol.h"
+
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+// One captured request
+struct Event {
+    uint64_t t = 0;         // µs since the capture started
+    uint64_t session = 0;
+    std::string method;
+    bool ok = false;        // what the backend answered then
+    bool binary = false;    // payload is a MessagePack frame body
+    std::string payload;
+};
+
+// The string value of `key` in a capture line, unescaped (see JSON::escapeTo)
+bool stringField(const std::string& line, const char* key, std::string& value)
+{
+    std::string search = std::string("\"") + key + "\":\"";
+    size_t pos = line.find(search);
+    if (pos == std::string::npos)
+        return false;
+    value.clear();
+    for (size_t i = pos + search.size(); i < line.size(); ++i) {
+        char c = line[i];
+        if (c == '"')
+            return true;
+        if (c == '\\' && i + 1 < line.size()) {
+            c = line[++i];
+            if (c == 'n') c = '\n';
+            else if (c == 'r') c = '\r';
+            else if (c == 't') c = '\t';
+        }
+        value += c;
+    }
+    return false;
+}
+
+bool numberField(const std::string& line, const char* key, uint64_t& value)
+{
+    std::string search = std::string("\"") + key + "\":";
+    size_t pos = line.find(search);
+    if (pos == std::string::npos)
+        return false;
+    value = std::strtoull(line.c_str() + pos + search.size(), nullptr, 10);
+    return true;
+}
+
+int hexDigit(char c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+bool parseEvent(const std::string& line, Event& e)
+{
+    // Our fields come before the request, so find() meets them first
+    if (!numberField(line, "t", e.t) || !numberField(line, "session", e.session) ||
+        !stringField(line, "method", e.method))
+        return false;
+    e.ok = line.find("\"ok\":true") != std::string::npos;
+    if (stringField(line, "request", e.payload))
+        return true;
+    std::string hex;
+    if (!stringField(line, "msgpack", hex) || hex.size() % 2 != 0)
+        return false;
+    e.binary = true;
+    e.payload.clear();
+    for (size_t i = 0; i < hex.size(); i += 2) {
+        int high = hexDigit(hex[i]), low = hexDigit(hex[i + 1]);
+        if (high < 0 || low < 0)
+            return false;
+        e.payload += static_cast<char>(high * 16 + low);
+    }
+    return true;
+}
+
+struct Pending {
+    Clock::time_point sent;
+    const Event* event;
+    WireMode switchTo;      // the mode a setProtocol request asks for
+};
+
+struct Options {
+    double speed = 1.0;
+    bool fast = false;
+    std::chrono::seconds timeout{30};
+};
+
+// Shared results; the histograms take concurrent records
+struct Results {
+    RpcMetrics perMethod;
+    LatencyHistogram overall;
+    std::atomic<uint64_t> mismatches{0};
+    std::atomic<uint64_t> unexpected{0};
+    std::atomic<bool> signInRequired{false};    // the backend runs with --require-auth
+    std::mutex logMutex;
+};
+
+const int MISMATCHES_SHOWN = 10;
+
+// One captured session's connection; a reader thread matches its replies
+class Connection
+{
+    public:
+
+    Connection(int socket, Results& r) : fd(socket), results(r), reader(&Connection::read, this) {}
+
+    ~Connection()
+    {
+        ::shutdown(fd, SHUT_RDWR);
+        reader.join();
+        ::close(fd);
+    }
+
+    bool send(const Event& e)
+    {
+        std::string bytes;
+        if (e.binary) {
+            appendFrame(bytes, e.payload);
+        } else {
+            bytes = e.payload;
+            bytes += '\n';
+        }
+
+        // Requests the backend could not read get no reply
+        if (e.method != "(unreadable)") {
+            int id = 0;
+            WireMode switchTo = WireMode::json;
+            if (e.binary) {
+                id = MsgpackParser(e.payload).getInt("id", 0);
+            } else {
+                SimpleParser fields(e.payload);
+                id = fields.getInt("id", 0);
+                if (e.method == "setProtocol" && fields.getString("mode") == "binary")
+                    switchTo = WireMode::binary;
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            if (closed)
+                return false;
+            pending[id].push_back(Pending{Clock::now(), &e, switchTo});
+            ++outstanding;
+        }
+
+        size_t done = 0;
+        while (done < bytes.size()) {
+            ssize_t n = ::send(fd, bytes.data() + done, bytes.size() - done, MSG_NOSIGNAL);
+            if (n <= 0)
+                return false;
+            done += static_cast<size_t>(n);
+        }
+        return true;
+    }
+
+    // Waits until every request sent has its reply; false on timeout
+    bool wait(Clock::time_point deadline)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        return replied.wait_until(lock, deadline, [this] { return outstanding == 0 || closed; }) &&
+               outstanding == 0;
+    }
+
+    size_t unanswered()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return outstanding;
+    }
+
+    private:
+
+    int fd;
+    Results& results;
+    std::mutex mutex;
+    std::condition_variable replied;
+    std::unordered_map<int, std::deque<Pending>> pending;
+    size_t outstanding = 0;
+    WireMode mode = WireMode::json;     // of the replies
+    bool closed = false;
+    std::thread reader;
+
+    void read()
+    {
+        std::string buffer, message;
+        char chunk[65536];
+        for (;;) {
+            ssize_t n = ::recv(fd, chunk, sizeof chunk, 0);
+            if (n <= 0)
+                break;
+            buffer.append(chunk, static_cast<size_t>(n));
+            size_t offset = 0;
+            while (nextRequest(buffer, offset, currentMode(), message))
+                handle(message);
+            buffer.erase(0, offset);
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+        replied.notify_all();
+    }
+
+    WireMode currentMode()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return mode;
+    }
+
+    void handle(const std::string& message)
+    {
+        auto now = Clock::now();
+        std::unique_ptr<RequestParser> reply;
+        try {
+            if (currentMode() == WireMode::binary)
+                reply.reset(new MsgpackParser(message));
+            else
+                reply.reset(new SimpleParser(message));
+        } catch (const std::exception&) {
+            results.unexpected.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        if (reply->getInt("chunk", -1) >= 0)
+            return;     // part of a streamed list; its end message follows
+        int id = reply->getInt("id", 0);
+        bool success = reply->getBool("success", false);
+
+        Pending p;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = pending.find(id);
+            if (it == pending.end() || it->second.empty()) {
+                results.unexpected.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            p = it->second.front();
+            it->second.pop_front();
+            if (it->second.empty())
+                pending.erase(it);
+            // The acknowledgement was the last message in the old mode
+            if (p.event->method == "setProtocol" && success)
+                mode = p.switchTo;
+            --outstanding;
+        }
+        replied.notify_all();
+
+        auto elapsed = now - p.sent;
+        results.perMethod.record(p.event->method, elapsed, !success);
+        results.overall.record(static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count()));
+        if (!success && reply->getString("error") == "Not signed in")
+            results.signInRequired.store(true, std::memory_order_relaxed);
+        if (success == p.event->ok)
+            return;
+        if (results.mismatches.fetch_add(1, std::memory_order_relaxed) < MISMATCHES_SHOWN) {
+            std::lock_guard<std::mutex> lock(results.logMutex);
+            std::cerr << "Session " << p.event->session << " at " << p.event->t / 1000 << " ms: "
+                      << p.event->method << " " << (p.event->ok ? "succeeded" : "failed") << " when captured, now "
+                      << (success ? "succeeds" : "fails: " + reply->getString("error")) << std::endl;
+        }
+    }
+};
+
+// A whole flag value as a number; false (and a message) on anything else
+bool parseNumber(const std::string& flag, const char* text, double& value)
+{
+    char* end = nullptr;
+    errno = 0;
+    value = std::strtod(text, &end);
+    if (end == text || *end != '\0' || errno == ERANGE || !(value >= 0)) {
+        std::cerr << "Invalid value for " << flag << ": " << text << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Requests whose passwords the capture no longer has
+bool needsPassword(const std::string& method)
+{
+    return method == "login" || method == "register";
+}
+
+std::unique_ptr<Connection> connectTo(const std::string& path, Results& results)
+{
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof addr.sun_path) {
+        std::cerr << "Socket path too long: " << path << std::endl;
+        return nullptr;
+    }
+    std::strcpy(addr.sun_path, path.c_str());
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || ::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof addr) != 0) {
+        std::cerr << "Cannot connect to " << path << ": " << std::strerror(errno) << std::endl;
+        if (fd >= 0)
+            ::close(fd);
+        return nullptr;
+    }
+    return std::unique_ptr<Connection>(new Connection(fd, results));
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    Options opt;
+    std::vector<std::string> paths;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        double value = 0;
+        if (arg == "--speed" && i + 1 < argc) {
+            if (!parseNumber(arg, argv[++i], opt.speed))
+                return 2;
+        }
+        else if (arg == "--fast") opt.fast = true;
+        else if (arg == "--timeout" && i + 1 < argc) {
+            if (!parseNumber(arg, argv[++i], value))
+                return 2;
+            opt.timeout = std::chrono::seconds(static_cast<long>(value));
+        }
+        else if (arg.rfind("--", 0) == 0) {
+            std::cerr << "Unknown argument: " << arg << std::endl;
+            return 2;
+        }
+        else paths.push_back(arg);
+    }
+    if (paths.size() != 2 || opt.speed <= 0) {
+        std::cerr << "Usage: sem_project_focp_replay CAPTURE SOCKET [--speed X] [--fast] [--timeout S]" << std::endl;
+        return 2;
+    }
+
+    std::ifstream in(paths[0]);
+    if (!in) {
+        std::cerr << "Cannot read " << paths[0] << std::endl;
+        return 2;
+    }
+    std::vector<Event> events;
+    std::string line;
+    size_t lineNumber = 0, skipped = 0;
+    while (std::getline(in, line)) {
+        ++lineNumber;
+        if (line.empty())
+            continue;
+        Event e;
+        if (parseEvent(line, e))
+            events.push_back(std::move(e));
+        else if (skipped++ < 3)
+            std::cerr << paths[0] << ":" << lineNumber << ": not a captured request" << std::endl;
+    }
+    // Lines were written as requests completed; send them as they arrived
+    std::stable_sort(events.begin(), events.end(), [](const Event& a, const Event& b) { return a.t < b.t; });
+    if (events.empty()) {
+        std::cerr << "No requests in " << paths[0] << std::endl;
+        return 2;
+    }
+
+    Results results;
+    std::map<uint64_t, std::unique_ptr<Connection>> connections;
+    uint64_t sent = 0, capturedErrors = 0, failedSends = 0, withPassword = 0;
+    Clock::duration lag{};
+    uint64_t firstT = events.front().t;
+    auto start = Clock::now();
+
+    for (const Event& e : events) {
+        if (results.signInRequired.load(std::memory_order_relaxed))
+            break;
+        if (needsPassword(e.method)) {
+            ++withPassword;
+            continue;
+        }
+        if (!opt.fast) {
+            auto due = start + std::chrono::microseconds(static_cast<int64_t>((e.t - firstT) / opt.speed));
+            std::this_thread::sleep_until(due);
+            lag = std::max(lag, Clock::now() - due);
+        }
+        auto& conn = connections[e.session];
+        if (!conn && !(conn = connectTo(paths[1], results)))
+            return 1;
+        if (!conn->send(e)) {
+            ++failedSends;
+            continue;
+        }
+        ++sent;
+        capturedErrors += e.ok ? 0 : 1;
+        // A client waits for this acknowledgement before it switches modes
+        if (e.method == "setProtocol")
+            conn->wait(Clock::now() + opt.timeout);
+    }
+
+    auto deadline = Clock::now() + opt.timeout;
+    for (auto& c : connections)
+        c.second->wait(deadline);
+    auto elapsed = Clock::now() - start;
+    uint64_t unanswered = 0;
+    for (auto& c : connections)
+        unanswered += c.second->unanswered();
+    size_t sessions = connections.size();
+    connections.clear();
+    if (results.signInRequired.load()) {
+        std::cerr << "The backend requires sign-in (--require-auth), which a capture without tokens cannot give; "
+                     "replay against one started without it" << std::endl;
+        return 2;
+    }
+
+    double seconds = std::chrono::duration<double>(elapsed).count();
+    double captured = static_cast<double>(events.back().t - firstT) / 1e6;
+    std::printf("Replayed %llu requests over %zu sessions in %.2f s (%.0f requests/s); the capture spanned %.2f s\n",
+                static_cast<unsigned long long>(sent), sessions, seconds, seconds > 0 ? static_cast<double>(sent) / seconds : 0.0, captured);
+    if (!opt.fast)
+        std::printf("Fell behind the captured pace by up to %.1f ms\n",
+                    std::chrono::duration<double, std::milli>(lag).count());
+    const LatencyHistogram& all = results.overall;
+    std::printf("Latency (us): p50 %llu, p90 %llu, p99 %llu, max %llu\n",
+                static_cast<unsigned long long>(all.quantile(0.50)), static_cast<unsigned long long>(all.quantile(0.90)),
+                static_cast<unsigned long long>(all.quantile(0.99)), static_cast<unsigned long long>(all.max()));
+    std::printf("%-20s %8s %7s %9s %9s %9s %9s\n", "method", "count", "errors", "p50 us", "p90 us", "p99 us", "max us");
+    for (const auto& m : results.perMethod.snapshot())
+        std::printf("%-20s %8llu %7llu %9llu %9llu %9llu %9llu\n", m.method.c_str(),
+                    static_cast<unsigned long long>(m.count), static_cast<unsigned long long>(m.errors),
+                    static_cast<unsigned long long>(m.p50), static_cast<unsigned long long>(m.p90),
+                    static_cast<unsigned long long>(m.p99), static_cast<unsigned long long>(m.max));
+    uint64_t mismatches = results.mismatches.load();
+    std::printf("Errors %llu (captured %llu); success differs from the capture: %llu; unanswered: %llu; "
+                "unexpected replies: %llu; not sent: %llu (%llu more with passwords)\n",
+                static_cast<unsigned long long>(results.perMethod.errors()), static_cast<unsigned long long>(capturedErrors),
+                static_cast<unsigned long long>(mismatches), static_cast<unsigned long long>(unanswered),
+                static_cast<unsigned long long>(results.unexpected.load()), static_cast<unsigned long long>(failedSends),
+                static_cast<unsigned long long>(withPassword));
+    return mismatches || unanswered || failedSends ? 1 : 0;
+}
@@ -0,0 +1,489 @@
+#include "server.h"
+
+#include <iostream>
+
+#ifdef __linux__
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+volatile std::sig_atomic_t stopRequested = 0;
+
+void onStopSignal(int)
+{
+    stopRequested = 1;
+}
+
+// Unwritten reply bytes past which a sender waits for the client to catch
+// up, and how long it waits without the client taking anything before the
+// client is dropped. Bounds what a slow reader of a streamed list costs.
+const size_t OUTBOX_HIGH_WATER = 4 * 1024 * 1024;
+const auto OUTBOX_STALL_TIMEOUT = std::chrono::seconds(30);
+
+// Replies waiting to be written to one client. Shared with the client's
+// Session so workers can queue replies while the loop does something else.
+struct Outbox {
+    std::mutex mutex;
+    std::condition_variable room;   // the client took some bytes, or is gone
+    std::string pending;
+    size_t sent = 0;        // bytes of `pending` already written
+    bool closed = false;    // client gone: drop further replies
+
+    size_t backlog() const { return pending.size() - sent; }
+
+    // After a write: forgets what was sent and wakes waiting senders
+    void consumed()
+    {
+        if (sent == pending.size()) {
+            pending.clear();
+            sent = 0;
+        } else if (sent > OUTBOX_HIGH_WATER) {
+            pending.erase(0, sent);
+            sent = 0;
+        }
+        room.notify_all();
+    }
+};
+
+struct Client {
+    int fd = -1;
+    std::string inbox;      // bytes received but not yet a full request
+    std::shared_ptr<Session> session;
+    std::shared_ptr<Outbox> outbox;
+    bool watchingWrites = false;
+    bool peerClosed = false;    // EOF seen; close once every reply is out
+};
+
+class Server
+{
+    private:
+
+    const RequestHandler& onRequest;
+    int listenFd = -1;
+    int epollFd = -1;
+    int wakeFd = -1;        // eventfd: some outbox has new data
+    std::unordered_map<int, Client> clients;
+
+    std::mutex dirtyMutex;
+    std::vector<int> dirty; // clients with queued replies
+
+    std::thread::id loopThread;
+
+    static const size_t READ_CHUNK = 64 * 1024;
+    // Bytes taken from one client per wakeup; epoll reports the rest later,
+    // so a client sending a flood cannot starve the others
+    static const size_t READ_BUDGET = 16 * READ_CHUNK;
+
+    void acceptClients();
+    void readClient(Client& c);
+    void flushClient(Client& c);
+    void flushDirty();
+    void closeClient(int fd);
+    bool closeIfFinished(Client& c);
+    void sweepClosed();
+    void watchWrites(Client& c, bool on);
+
+    public:
+
+    explicit Server(const RequestHandler& handler) : onRequest(handler) {}
+    ~Server();
+
+    bool listenOn(const std::string& path);
+    void run();
+
+    // Called with the client's outbox locked (see Session::send below)
+    void markDirty(int fd);
+    void waitForRoom(int fd, Outbox& out, std::unique_lock<std::mutex>& lock);
+};
+
+Server::~Server()
+{
+    for (auto& entry : clients) {
+        {
+            std::lock_guard<std::mutex> lock(entry.second.outbox->mutex);
+            entry.second.outbox->closed = true;
+            entry.second.outbox->room.notify_all();
+        }
+        close(entry.first);
+    }
+    if (wakeFd >= 0) close(wakeFd);
+    if (epollFd >= 0) close(epollFd);
+    if (listenFd >= 0) close(listenFd);
+}
+
+bool Server::listenOn(const std::string& path)
+{
+    sockaddr_un addr{};
+    if (path.size() >= sizeof(addr.sun_path)) {
+        std::cerr << "Socket path too long: " << path << std::endl;
+        return false;
+    }
+    addr.sun_family = AF_UNIX;
+    std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+
+    listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listenFd < 0) {
+        std::cerr << "socket() failed: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+
+    unlink(path.c_str());   // stale socket from a previous run
+    if (bind(listenFd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 ||
+        listen(listenFd, SOMAXCONN) < 0) {
+        std::cerr << "Cannot listen on " << path << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epollFd < 0 || wakeFd < 0) {
+        std::cerr << "epoll/eventfd setup failed: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.fd = listenFd;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &ev);
+    ev.data.fd = wakeFd;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &ev);
+    return true;
+}
+
+void Server::markDirty(int fd)
+{
+    bool wasEmpty;
+    {
+        std::lock_guard<std::mutex> lock(dirtyMutex);
+        wasEmpty = dirty.empty();
+        dirty.push_back(fd);
+    }
+    if (wasEmpty) {
+        uint64_t one = 1;
+        ssize_t ignored = write(wakeFd, &one, sizeof(one));
+        (void)ignored;
+    }
+}
+
+// Holds a sender while the client is more than OUTBOX_HIGH_WATER behind.
+// On the loop thread (requests run inline, without --workers) nobody else
+// would write, so it writes here itself.
+void Server::waitForRoom(int fd, Outbox& out, std::unique_lock<std::mutex>& lock)
+{
+    auto deadline = std::chrono::steady_clock::now() + OUTBOX_STALL_TIMEOUT;
+    while (!out.closed && out.backlog() > OUTBOX_HIGH_WATER)
+    {
+        size_t before = out.backlog();
+        if (std::this_thread::get_id() == loopThread) {
+            ssize_t n = send(fd, out.pending.data() + out.sent, out.backlog(), MSG_NOSIGNAL);
+            if (n > 0) {
+                out.sent += static_cast<size_t>(n);
+                out.consumed();
+            } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+                    deadline - std::chrono::steady_clock::now());
+                pollfd p{fd, POLLOUT, 0};
+                poll(&p, 1, static_cast<int>(std::max<long long>(left.count(), 0)));
+            } else if (!(n < 0 && errno == EINTR)) {
+                break;      // dead peer: the loop finds out and closes it
+            }
+        } else {
+            out.room.wait_until(lock, deadline);
+        }
+
+        if (out.backlog() < before)
+            deadline = std::chrono::steady_clock::now() + OUTBOX_STALL_TIMEOUT;
+        else if (std::chrono::steady_clock::now() >= deadline) {
+            std::cerr << "Dropping client: not reading its replies" << std::endl;
+            out.closed = true;
+            out.room.notify_all();
+            markDirty(fd);  // the loop closes it
+        }
+    }
+}
+
+void Server::acceptClients()
+{
+    for (;;)
+    {
+        int fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+                std::cerr << "accept() failed: " << std::strerror(errno) << std::endl;
+            return;
+        }
+
+        Client& c = clients[fd];
+        c.fd = fd;
+        c.outbox = std::make_shared<Outbox>();
+        c.session = std::make_shared<Session>();
+
+        std::shared_ptr<Outbox> outbox = c.outbox;
+        Server* self = this;
+        c.session->send = [outbox, self, fd](const std::string& bytes) {
+            // Stay under the outbox lock while touching the server: once the
+            // server marks an outbox closed it knows no sender is still inside.
+            std::unique_lock<std::mutex> lock(outbox->mutex);
+            if (outbox->closed) return;
+            bool wasEmpty = outbox->backlog() == 0;
+            outbox->pending += bytes;
+            if (wasEmpty) self->markDirty(fd);
+            if (outbox->backlog() > OUTBOX_HIGH_WATER)
+                self->waitForRoom(fd, *outbox, lock);
+        };
+
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.fd = fd;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev);
+    }
+}
+
+void Server::readClient(Client& c)
+{
+    char buf[READ_CHUNK];
+    // Beyond one request of the largest size, stop: the check below drops
+    // the client unless the buffer holds whole requests
+    for (size_t taken = 0; taken < READ_BUDGET && c.inbox.size() <= MAX_FRAME_SIZE + 4;)
+    {
+        ssize_t n = recv(c.fd, buf, sizeof(buf), 0);
+        if (n > 0) {
+            c.inbox.append(buf, static_cast<size_t>(n));
+            taken += static_cast<size_t>(n);
+            continue;
+        }
+        if (n == 0) {       // peer is done sending; still owed its replies
+            c.peerClosed = true;
+            break;
+        }
+        if (errno == EINTR) continue;
+        if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+        closeClient(c.fd);
+        return;
+    }
+
+    int fd = c.fd;
+    std::shared_ptr<Session> session = c.session;
+    size_t offset = 0;
+    std::string request;
+    try {
+        // session->mode is re-read per request: setProtocol switches it mid-buffer
+        while (nextRequest(c.inbox, offset, session->mode, request)) {
+            if (!request.empty())
+                onRequest(session, request);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Dropping client: " << e.what() << std::endl;
+        closeClient(fd);
+        return;
+    }
+    c.inbox.erase(0, offset);
+
+    if (c.inbox.size() > MAX_FRAME_SIZE + 4) {
+        std::cerr << "Dropping client: request exceeds " << MAX_FRAME_SIZE << " bytes" << std::endl;
+        closeClient(fd);
+        return;
+    }
+    if (c.peerClosed) {
+        watchWrites(c, c.watchingWrites);   // refresh interest set without EPOLLIN
+        closeIfFinished(c);
+    }
+}
+
+void Server::watchWrites(Client& c, bool on)
+{
+    epoll_event ev{};
+    ev.events = (c.peerClosed ? 0u : static_cast<uint32_t>(EPOLLIN)) | (on ? static_cast<uint32_t>(EPOLLOUT) : 0u);
+    ev.data.fd = c.fd;
+    epoll_ctl(epollFd, EPOLL_CTL_MOD, c.fd, &ev);
+    c.watchingWrites = on;
+}
+
+void Server::flushClient(Client& c)
+{
+    bool drained, abandoned;
+    {
+        std::lock_guard<std::mutex> lock(c.outbox->mutex);
+        Outbox& out = *c.outbox;
+        abandoned = out.closed;     // by waitForRoom
+        while (!abandoned && out.sent < out.pending.size())
+        {
+            ssize_t n = send(c.fd, out.pending.data() + out.sent, out.pending.size() - out.sent, MSG_NOSIGNAL);
+            if (n > 0) {
+                out.sent += static_cast<size_t>(n);
+                continue;
+            }
+            if (n < 0 && errno == EINTR) continue;
+            break;      // EAGAIN (wait for EPOLLOUT) or a dead peer (EPOLLHUP follows)
+        }
+        out.consumed();
+        drained = out.backlog() == 0;
+    }
+    if (abandoned) {
+        closeClient(c.fd);
+        return;
+    }
+    if (c.watchingWrites != !drained)
+        watchWrites(c, !drained);
+    if (drained)
+        closeIfFinished(c);
+}
+
+// A half-closed client is closed once its outbox is empty and no worker
+// still holds its session (i.e. no request of its is in flight)
+bool Server::closeIfFinished(Client& c)
+{
+    if (!c.peerClosed || c.session.use_count() > 1)
+        return false;
+    {
+        std::lock_guard<std::mutex> lock(c.outbox->mutex);
+        if (c.outbox->backlog() != 0)
+            return false;
+    }
+    closeClient(c.fd);
+    return true;
+}
+
+void Server::sweepClosed()
+{
+    std::vector<int> fds;
+    for (auto& entry : clients)
+        if (entry.second.peerClosed)
+            fds.push_back(entry.first);
+    for (int fd : fds) {
+        auto it = clients.find(fd);
+        if (it != clients.end())
+            closeIfFinished(it->second);
+    }
+}
+
+void Server::flushDirty()
+{
+    std::vector<int> fds;
+    {
+        std::lock_guard<std::mutex> lock(dirtyMutex);
+        fds.swap(dirty);
+    }
+    for (int fd : fds) {
+        auto it = clients.find(fd);
+        if (it != clients.end())
+            flushClient(it->second);
+    }
+}
+
+void Server::closeClient(int fd)
+{
+    auto it = clients.find(fd);
+    if (it == clients.end()) return;
+    {
+        std::lock_guard<std::mutex> lock(it->second.outbox->mutex);
+        it->second.outbox->closed = true;
+        it->second.outbox->room.notify_all();
+    }
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+    close(fd);
+    clients.erase(it);
+}
+
+void Server::run()
+{
+    const int MAX_EVENTS = 64;
+    epoll_event events[MAX_EVENTS];
+    loopThread = std::this_thread::get_id();
+
+    while (!stopRequested)
+    {
+        // Poll while half-closed clients wait for in-flight replies
+        bool lingering = false;
+        for (const auto& entry : clients)
+            lingering = lingering || entry.second.peerClosed;
+
+        int n = epoll_wait(epollFd, events, MAX_EVENTS, lingering ? 50 : -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            std::cerr << "epoll_wait() failed: " << std::strerror(errno) << std::endl;
+            return;
+        }
+
+        for (int i = 0; i < n; ++i)
+        {
+            int fd = events[i].data.fd;
+            uint32_t what = events[i].events;
+
+            if (fd == listenFd) {
+                acceptClients();
+            } else if (fd == wakeFd) {
+                uint64_t count;
+                ssize_t ignored = read(wakeFd, &count, sizeof(count));
+                (void)ignored;
+            } else {
+                auto it = clients.find(fd);
+                if (it == clients.end()) continue;
+                if (what & EPOLLIN) {
+                    readClient(it->second);
+                    it = clients.find(fd);
+                    if (it == clients.end()) continue;
+                }
+                if (what & EPOLLOUT)
+                    flushClient(it->second);
+                if (what & EPOLLERR)
+                    closeClient(fd);
+                else if ((what & EPOLLHUP) && !(what & EPOLLIN))
+                    closeClient(fd);    // gone entirely, nothing left to read
+            }
+        }
+
+        // Replies produced inline above or by workers since the last pass
+        flushDirty();
+        if (lingering)
+            sweepClosed();
+    }
+}
+
+} // namespace
+
+int runServer(const std::string& socketPath, const RequestHandler& onRequest)
+{
+    struct sigaction sa{};
+    sa.sa_handler = onStopSignal;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, nullptr);    // no SA_RESTART: epoll_wait returns EINTR
+    sigaction(SIGTERM, &sa, nullptr);
+
+    Server server(onRequest);
+    if (!server.listenOn(socketPath))
+        return 1;
+
+    std::cerr << "Listening on " << socketPath << std::endl;
+    server.run();
+    unlink(socketPath.c_str());
+    return 0;
+}
+
+#else
+
+int runServer(const std::string& socketPath, const RequestHandler&)
+{
+    std::cerr << "Server mode (--listen " << socketPath << ") needs Linux epoll" << std::endl;
+    return 1;
+}
+
+#endif
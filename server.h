@@ -0,0 +1,16 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "protocol.h"
+
+// Called once per complete request received from a client
+using RequestHandler = std::function<void(const std::shared_ptr<Session>& session, const std::string& request)>;
+
+// Serves many clients on a Unix domain socket from one non-blocking epoll
+// loop (Linux only), speaking the same protocol as stdio: JSON lines, or
+// frames after setProtocol. Replies may be sent from any thread.
+// Runs until SIGINT/SIGTERM; returns the process exit code.
+int runServer(const std::string& socketPath, const RequestHandler& onRequest);
@@ -0,0 +1,67 @@
+#include "sessiontokens.h"
+
+#include "passwordhash.h"
+
+// 256 bits: not guessable, however many are out
+static const size_t TOKEN_BYTES = 32;
+
+SessionTokens::SessionTokens(std::chrono::seconds idleLimit)
+    : idle(idleLimit)
+{
+}
+
+std::string SessionTokens::issue(const std::string& username)
+{
+    std::string token = randomHex(TOKEN_BYTES);
+    auto now = clock::now();
+    std::lock_guard<std::mutex> lock(mutex);
+    if (tokens.size() >= MAX_TOKENS)
+        makeRoom(now);
+    tokens[token] = Entry{username, now};
+    return token;
+}
+
+bool SessionTokens::check(const std::string& token, std::string& username)
+{
+    auto now = clock::now();
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = tokens.find(token);
+    if (it == tokens.end())
+        return false;
+    if (now - it->second.lastUsed > idle) {
+        tokens.erase(it);
+        return false;
+    }
+    it->second.lastUsed = now;
+    username = it->second.username;
+    return true;
+}
+
+void SessionTokens::revoke(const std::string& token)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    tokens.erase(token);
+}
+
+size_t SessionTokens::size() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return tokens.size();
+}
+
+void SessionTokens::makeRoom(clock::time_point now)
+{
+    for (auto it = tokens.begin(); it != tokens.end();) {
+        if (now - it->second.lastUsed > idle)
+            it = tokens.erase(it);
+        else
+            ++it;
+    }
+    if (tokens.size() < MAX_TOKENS)
+        return;
+    auto oldest = tokens.begin();
+    for (auto it = tokens.begin(); it != tokens.end(); ++it)
+        if (it->second.lastUsed < oldest->second.lastUsed)
+            oldest = it;
+    tokens.erase(oldest);
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// Signed-in users, by session token.
+//
+// A successful login (see cli.cpp) issues a random token; clients send it
+// with later requests instead of the password, which is checked here with
+// one hash lookup rather than another scrypt run. Tokens live in memory
+// only, so a restart signs everyone out, and lapse after `idle` without
+// use. Safe to use from any thread.
+class SessionTokens
+{
+    public:
+
+    // Tokens kept at most; issuing past it drops the least recently used
+    static const size_t MAX_TOKENS = 65536;
+
+    explicit SessionTokens(std::chrono::seconds idle = std::chrono::hours(12));
+
+    // A new token for `username`
+    std::string issue(const std::string& username);
+    // The token's user, if it is still valid; using it extends its life
+    bool check(const std::string& token, std::string& username);
+    void revoke(const std::string& token);
+    size_t size() const;
+
+    std::chrono::seconds idleLimit() const { return idle; }
+
+    private:
+
+    using clock = std::chrono::steady_clock;
+
+    struct Entry {
+        std::string username;
+        clock::time_point lastUsed;
+    };
+
+    mutable std::mutex mutex;
+    std::unordered_map<std::string, Entry> tokens;
+    std::chrono::seconds idle;
+
+    // Drops lapsed tokens, then the oldest if still full; caller holds the mutex
+    void makeRoom(clock::time_point now);
+};
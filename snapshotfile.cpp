@@ -0,0 +1,334 @@
+#include "snapshotfile.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// File layout, all integers in host byte order (checked via `byteOrder`):
+//
+//   Header
+//   TextRef    [authorCount]   distinct author names
+//   SnapBook   [bookCount]     in ID order
+//   SnapMember [memberCount]   in ID order
+//   int32_t    [loanCount]     members' loans, oldest first, by member
+//   char       [textSize]      every string
+//
+// Sections start on 8-byte boundaries.
+
+const char SNAPSHOT_MAGIC[8] = {'L', 'M', 'S', 'S', 'N', 'A', 'P', '\0'};
+const uint32_t SNAPSHOT_FORMAT = 1;
+const uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+struct TextRef {
+    uint32_t offset;
+    uint32_t size;
+};
+
+struct Header {
+    char magic[8];
+    uint32_t format;
+    uint32_t byteOrder;
+    uint64_t dataVersion;
+    uint64_t authorCount;
+    uint64_t bookCount;
+    uint64_t memberCount;
+    uint64_t loanCount;
+    uint64_t textSize;
+    uint64_t authorsOffset;
+    uint64_t booksOffset;
+    uint64_t membersOffset;
+    uint64_t loansOffset;
+    uint64_t textOffset;
+};
+
+struct SnapBook {
+    int32_t id;
+    int32_t issuedTo;
+    uint8_t genre;
+    uint8_t borrowed;
+    uint16_t reserved;
+    uint32_t author;        // index into the author table
+    TextRef title;
+    TextRef isbn;
+    TextRef coverUrl;
+};
+
+struct SnapMember {
+    int32_t id;
+    int32_t borrowedBookID;
+    TextRef name;
+    TextRef address;
+    uint32_t firstLoan;
+    uint32_t loanCount;
+};
+
+uint64_t aligned(uint64_t offset)
+{
+    return (offset + 7) & ~uint64_t(7);
+}
+
+// Builds the text section and the author table (each author once)
+class TextWriter
+{
+    std::string text;
+    std::vector<TextRef> authorRefs;
+    std::unordered_map<std::string_view, uint32_t> authorIndex;
+
+    public:
+
+    TextRef add(std::string_view s)
+    {
+        TextRef ref{static_cast<uint32_t>(text.size()), static_cast<uint32_t>(s.size())};
+        text.append(s.data(), s.size());
+        return ref;
+    }
+
+    uint32_t addAuthor(std::string_view s)
+    {
+        // s points into the catalog, which outlives the writer
+        auto inserted = authorIndex.emplace(s, static_cast<uint32_t>(authorRefs.size()));
+        if (inserted.second)
+            authorRefs.push_back(add(s));
+        return inserted.first->second;
+    }
+
+    const std::string& data() const { return text; }
+    const std::vector<TextRef>& authors() const { return authorRefs; }
+};
+
+template <typename T>
+void appendRaw(std::string& out, const T& value)
+{
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+// The file's bytes, mapped read-only where possible
+std::shared_ptr<const void> mapFile(const std::string& path, size_t& size)
+{
+#ifndef _WIN32
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return nullptr;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        ::close(fd);
+        return nullptr;
+    }
+    size = static_cast<size_t>(st.st_size);
+    void* base = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (base == MAP_FAILED)
+        return nullptr;
+    return std::shared_ptr<const void>(base, [size](const void* p) { munmap(const_cast<void*>(p), size); });
+#else
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file)
+        return nullptr;
+    size = static_cast<size_t>(file.tellg());
+    std::shared_ptr<char> buffer(new char[size], std::default_delete<char[]>());
+    file.seekg(0);
+    if (!file.read(buffer.get(), static_cast<std::streamsize>(size)))
+        return nullptr;
+    return buffer;
+#endif
+}
+
+} // namespace
+
+bool saveSnapshotFile(const std::string& path, const Catalog& catalog, uint64_t dataVersion)
+{
+    TextWriter text;
+    std::vector<int32_t> loans;
+
+    std::string books;
+    books.reserve(catalog.books.size() * sizeof(SnapBook));
+    for (const auto& b : catalog.books) {
+        SnapBook sb{};
+        sb.id = b.getID();
+        sb.issuedTo = b.getIssuedTo();
+        sb.genre = static_cast<uint8_t>(b.getGenre());
+        sb.borrowed = b.getBorrowStatus() ? 1 : 0;
+        sb.title = text.add(b.getTitle());
+        sb.isbn = text.add(b.getISBN());
+        sb.author = text.addAuthor(b.getAuthor());
+        sb.coverUrl = text.add(b.getCoverUrl());
+        appendRaw(books, sb);
+    }
+
+    std::string members;
+    members.reserve(catalog.members.size() * sizeof(SnapMember));
+    for (const auto& m : catalog.members) {
+        SnapMember sm{};
+        sm.id = m.getID();
+        sm.borrowedBookID = m.getBorrowedBookID();
+        sm.name = text.add(m.getName());
+        sm.address = text.add(m.getAddress());
+        sm.firstLoan = static_cast<uint32_t>(loans.size());
+        sm.loanCount = static_cast<uint32_t>(m.getLoans().size());
+        loans.insert(loans.end(), m.getLoans().begin(), m.getLoans().end());
+        appendRaw(members, sm);
+    }
+
+    if (text.data().size() > UINT32_MAX) {
+        std::cerr << "Catalog text too large for a snapshot file" << std::endl;
+        return false;
+    }
+
+    Header h{};
+    std::memcpy(h.magic, SNAPSHOT_MAGIC, sizeof(h.magic));
+    h.format = SNAPSHOT_FORMAT;
+    h.byteOrder = BYTE_ORDER_MARK;
+    h.dataVersion = dataVersion;
+    h.authorCount = text.authors().size();
+    h.bookCount = catalog.books.size();
+    h.memberCount = catalog.members.size();
+    h.loanCount = loans.size();
+    h.textSize = text.data().size();
+    h.authorsOffset = aligned(sizeof(Header));
+    h.booksOffset = aligned(h.authorsOffset + h.authorCount * sizeof(TextRef));
+    h.membersOffset = aligned(h.booksOffset + books.size());
+    h.loansOffset = aligned(h.membersOffset + members.size());
+    h.textOffset = aligned(h.loansOffset + loans.size() * sizeof(int32_t));
+
+    std::string tmpPath = path + ".tmp";
+    {
+        std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+        auto section = [&out](uint64_t offset, const char* data, size_t size) {
+            std::string pad(static_cast<size_t>(offset) - static_cast<size_t>(out.tellp()), '\0');
+            out.write(pad.data(), static_cast<std::streamsize>(pad.size()));
+            out.write(data, static_cast<std::streamsize>(size));
+        };
+        out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+        section(h.authorsOffset, reinterpret_cast<const char*>(text.authors().data()), h.authorCount * sizeof(TextRef));
+        section(h.booksOffset, books.data(), books.size());
+        section(h.membersOffset, members.data(), members.size());
+        section(h.loansOffset, reinterpret_cast<const char*>(loans.data()), loans.size() * sizeof(int32_t));
+        section(h.textOffset, text.data().data(), text.data().size());
+        if (!out.flush()) {
+            std::cerr << "Failed to write snapshot file " << tmpPath << std::endl;
+            std::remove(tmpPath.c_str());
+            return false;
+        }
+    }
+    if (std::rename(tmpPath.c_str(), path.c_str()) != 0) {
+        std::cerr << "Failed to replace snapshot file " << path << std::endl;
+        std::remove(tmpPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool loadSnapshotFile(const std::string& path, uint64_t dataVersion, Catalog& catalog, std::string& reason)
+{
+    size_t size = 0;
+    std::shared_ptr<const void> region = mapFile(path, size);
+    if (!region) {
+        reason = "no snapshot file";
+        return false;
+    }
+    const char* base = static_cast<const char*>(region.get());
+
+    Header h;
+    if (size < sizeof(h)) {
+        reason = "truncated header";
+        return false;
+    }
+    std::memcpy(&h, base, sizeof(h));
+    if (std::memcmp(h.magic, SNAPSHOT_MAGIC, sizeof(h.magic)) != 0 ||
+        h.format != SNAPSHOT_FORMAT || h.byteOrder != BYTE_ORDER_MARK) {
+        reason = "unknown format";
+        return false;
+    }
+    if (h.dataVersion != dataVersion) {
+        reason = "database changed since it was written";
+        return false;
+    }
+
+    auto fits = [size](uint64_t offset, uint64_t count, uint64_t width) {
+        return offset <= size && count <= (size - offset) / width;
+    };
+    if (!fits(h.authorsOffset, h.authorCount, sizeof(TextRef)) ||
+        !fits(h.booksOffset, h.bookCount, sizeof(SnapBook)) ||
+        !fits(h.membersOffset, h.memberCount, sizeof(SnapMember)) ||
+        !fits(h.loansOffset, h.loanCount, sizeof(int32_t)) ||
+        !fits(h.textOffset, h.textSize, 1)) {
+        reason = "truncated";
+        return false;
+    }
+
+    const char* textBase = base + h.textOffset;
+    bool intact = true;
+    auto text = [&](const TextRef& ref) {
+        if (uint64_t(ref.offset) + ref.size > h.textSize) {
+            intact = false;
+            return std::string_view("", 0);
+        }
+        return std::string_view(textBase + ref.offset, ref.size);
+    };
+
+    // Authors were written once each; those copies become the interned ones
+    StringPool& pool = StringPool::global();
+    std::vector<std::string_view> authors(static_cast<size_t>(h.authorCount));
+    for (size_t i = 0; i < authors.size(); ++i) {
+        TextRef ref;
+        std::memcpy(&ref, base + h.authorsOffset + i * sizeof(TextRef), sizeof(ref));
+        authors[i] = text(ref);
+    }
+
+    // Records go straight into catalog chunks, which need them in ID order
+    Catalog loaded;
+    bool ordered = true;
+    for (uint64_t i = 0; ordered && i < h.bookCount; ++i) {
+        SnapBook sb;
+        std::memcpy(&sb, base + h.booksOffset + i * sizeof(SnapBook), sizeof(sb));
+        if (sb.author >= authors.size()) {
+            intact = false;
+            break;
+        }
+        ordered = loaded.books.emplaceBack(PooledText{}, sb.id, text(sb.title), text(sb.isbn), authors[sb.author],
+                                           static_cast<Genre>(sb.genre), text(sb.coverUrl), sb.borrowed != 0, sb.issuedTo);
+    }
+
+    const char* loanBase = base + h.loansOffset;
+    for (uint64_t i = 0; ordered && i < h.memberCount; ++i) {
+        SnapMember sm;
+        std::memcpy(&sm, base + h.membersOffset + i * sizeof(SnapMember), sizeof(sm));
+        if (uint64_t(sm.firstLoan) + sm.loanCount > h.loanCount) {
+            intact = false;
+            break;
+        }
+        std::vector<int> held(sm.loanCount);
+        std::memcpy(held.data(), loanBase + uint64_t(sm.firstLoan) * sizeof(int32_t), sm.loanCount * sizeof(int32_t));
+        member m(PooledText{}, sm.id, text(sm.name), text(sm.address), sm.borrowedBookID);
+        m.setLoans(std::move(held));
+        ordered = loaded.members.emplaceBack(std::move(m));
+    }
+
+    if (!intact || !ordered) {
+        reason = intact ? "records out of order" : "corrupt text or loan references";
+        return false;
+    }
+
+    // From here on records point into the mapping: hand it to the pool
+    pool.adopt(std::move(region), size);
+    for (std::string_view author : authors)
+        pool.internExisting(author);
+
+    catalog.books = std::move(loaded.books);
+    catalog.members = std::move(loaded.members);
+    return true;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "catalog.h"
+
+// Catalog snapshot files: the whole in-memory catalog (books, members,
+// their loans, and the text they point at) in one flat, versioned file
+// that is memory-mapped at startup instead of re-reading SQLite.
+//
+// A file is stamped with the database's data version (see readDataVersion)
+// and is only used while the database still has that version; any commit
+// in between makes it stale, and the caller falls back to loading from
+// SQLite. Text is used in place from the mapping, which stays mapped for
+// the life of the process.
+
+// Writes `catalog` to `path` (through a temporary file and a rename).
+// Returns false and leaves any existing file alone on failure.
+bool saveSnapshotFile(const std::string& path, const Catalog& catalog, uint64_t dataVersion);
+
+// Fills `catalog` from `path` if the file is intact and was written at
+// `dataVersion`. Otherwise returns false, leaves `catalog` untouched and
+// says why in `reason`.
+bool loadSnapshotFile(const std::string& path, uint64_t dataVersion, Catalog& catalog, std::string& reason);
@@ -0,0 +1,141 @@
+#include "sqlprofile.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <iterator>
+#include <iostream>
+#include <sstream>
+
+SqlProfile& SqlProfile::global()
+{
+    static SqlProfile profile;
+    return profile;
+}
+
+SqlProfile::SqlProfile()
+    : slowMicros(100000)
+{
+    std::unique_ptr<Statement> other(new Statement());
+    other->sql = OTHER_STATEMENTS;
+    std::string_view key = other->sql;
+    statements.emplace(key, std::move(other));
+}
+
+void SqlProfile::attach(sqlite3* db)
+{
+    if (db)
+        sqlite3_trace_v2(db, SQLITE_TRACE_STMT | SQLITE_TRACE_PROFILE, &SqlProfile::onTrace, this);
+}
+
+void SqlProfile::setSlowThreshold(std::chrono::microseconds threshold)
+{
+    slowMicros.store(threshold.count(), std::memory_order_relaxed);
+}
+
+// Statements started on this thread and not finished yet. SQLite's own
+// time comes from the wall clock in whole milliseconds on most platforms,
+// too coarse for statements that take microseconds, so we take our own.
+static thread_local std::vector<std::pair<sqlite3_stmt*, std::chrono::steady_clock::time_point>> running;
+
+int SqlProfile::onTrace(unsigned type, void* context, void* p, void* x)
+{
+    auto stmt = static_cast<sqlite3_stmt*>(p);
+    if (type == SQLITE_TRACE_STMT) {
+        // Also reported again as each trigger starts; the first one counts
+        for (const auto& r : running)
+            if (r.first == stmt)
+                return 0;
+        running.emplace_back(stmt, std::chrono::steady_clock::now());
+    }
+    else if (type == SQLITE_TRACE_PROFILE) {
+        auto nanos = static_cast<uint64_t>(*static_cast<sqlite3_int64*>(x));
+        for (auto it = running.rbegin(); it != running.rend(); ++it) {
+            if (it->first != stmt)
+                continue;
+            auto now = std::chrono::steady_clock::now();
+            nanos = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                now - it->second).count());
+            const char* sql = sqlite3_sql(stmt);
+            if (tracingOn.load(std::memory_order_relaxed) && sql)
+                Tracer::global().record("sql", "statement", it->second, now, sql);
+            running.erase(std::next(it).base());
+            break;
+        }
+        static_cast<SqlProfile*>(context)->record(stmt, nanos);
+    }
+    return 0;
+}
+
+SqlProfile::Statement& SqlProfile::find(std::string_view sql)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = statements.find(sql);
+    if (it != statements.end())
+        return *it->second;
+    if (statements.size() >= MAX_STATEMENTS)
+        return *statements.find(OTHER_STATEMENTS)->second;
+    std::unique_ptr<Statement> entry(new Statement());
+    entry->sql = std::string(sql);
+    std::string_view key = entry->sql;
+    return *statements.emplace(key, std::move(entry)).first->second;
+}
+
+void SqlProfile::record(sqlite3_stmt* stmt, uint64_t nanos)
+{
+    const char* sql = sqlite3_sql(stmt);
+    uint64_t micros = nanos / 1000;
+    // Per run: reading it also clears it for the next one
+    int fullScan = sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_FULLSCAN_STEP, 1);
+
+    Statement& s = find(sql ? sql : "");
+    s.latency.record(micros);
+    s.totalMicros.fetch_add(micros, std::memory_order_relaxed);
+    s.fullScanSteps.fetch_add(static_cast<uint64_t>(fullScan), std::memory_order_relaxed);
+
+    int64_t slow = slowMicros.load(std::memory_order_relaxed);
+    if (slow <= 0 || micros < static_cast<uint64_t>(slow))
+        return;
+    char* expanded = sqlite3_expanded_sql(stmt);
+    std::ostringstream line;
+    line << "Slow SQL (" << micros / 1000 << " ms";
+    if (fullScan > 0)
+        line << ", " << fullScan << " rows scanned";
+    line << "): " << (expanded ? expanded : sql ? sql : "");
+    sqlite3_free(expanded);
+    std::cerr << line.str() << std::endl;
+}
+
+std::vector<StatementStats> SqlProfile::snapshot() const
+{
+    std::vector<StatementStats> out;
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const auto& entry : statements) {
+        const Statement& st = *entry.second;
+        if (st.latency.count() == 0)
+            continue;
+        StatementStats s;
+        s.sql = st.sql;
+        s.count = st.latency.count();
+        s.fullScanSteps = st.fullScanSteps.load(std::memory_order_relaxed);
+        s.total = st.totalMicros.load(std::memory_order_relaxed);
+        s.mean = st.latency.mean();
+        s.p50 = st.latency.quantile(0.50);
+        s.p99 = st.latency.quantile(0.99);
+        s.max = st.latency.max();
+        out.push_back(s);
+    }
+    std::sort(out.begin(), out.end(), [](const StatementStats& a, const StatementStats& b) {
+        return a.total != b.total ? a.total > b.total : a.sql < b.sql;
+    });
+    return out;
+}
+
+void SqlProfile::reset()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto& entry : statements) {
+        entry.second->latency.reset();
+        entry.second->totalMicros.store(0, std::memory_order_relaxed);
+        entry.second->fullScanSteps.store(0, std::memory_order_relaxed);
+    }
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "external/sqlite/sqlite3.h"
+#include "metrics.h"
+
+// Time spent in SQLite, per statement.
+//
+// Every connection opened through openDatabase or openReadConnection
+// reports each statement run here when it finishes (sqlite3_trace_v2).
+// Statements are told apart by their SQL as prepared, with ? for
+// parameters, so one histogram covers every run of a helper in
+// database.cpp.
+//
+// What the time covers: from the first step until it is done or reset, so
+// for a SELECT read row by row it includes our work on each row; a COMMIT
+// (or a write outside a transaction) includes syncing the journal to disk.
+// Set beside the per-method latency (see metrics.h), it tells whether a
+// slow request waited on SQLite, on the disk or on our code.
+//
+// Statements slower than the threshold are also logged to stderr with
+// their parameters filled in.
+
+// One statement's numbers at one moment; times in microseconds
+struct StatementStats {
+    std::string sql;
+    uint64_t count = 0;
+    uint64_t fullScanSteps = 0;     // rows stepped over by full table scans
+    uint64_t total = 0, mean = 0, p50 = 0, p99 = 0, max = 0;
+};
+
+class SqlProfile
+{
+    public:
+
+    // Statements tracked one by one; any further ones share OTHER_STATEMENTS
+    static const size_t MAX_STATEMENTS = 128;
+
+    // The one all connections report to
+    static SqlProfile& global();
+
+    SqlProfile();
+
+    // Starts timing every statement run on `db`
+    void attach(sqlite3* db);
+
+    // Log statements that take longer; zero turns the log off
+    void setSlowThreshold(std::chrono::microseconds threshold);
+
+    // Every statement seen so far, most total time first
+    std::vector<StatementStats> snapshot() const;
+    void reset();
+
+    private:
+
+    struct Statement {
+        LatencyHistogram latency;
+        std::atomic<uint64_t> totalMicros{0};
+        std::atomic<uint64_t> fullScanSteps{0};
+        std::string sql;                // the map's key points into this
+    };
+
+    mutable std::mutex mutex;       // guards the table, not the counters
+    std::unordered_map<std::string_view, std::unique_ptr<Statement>> statements;
+    std::atomic<int64_t> slowMicros;
+
+    Statement& find(std::string_view sql);
+    void record(sqlite3_stmt* stmt, uint64_t nanos);
+    static int onTrace(unsigned type, void* context, void* stmt, void* nanos);
+};
+
+const char* const OTHER_STATEMENTS = "(other)";
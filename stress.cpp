@@ -0,0 +1,442 @@
+// Concurrency stress tests for the in-memory catalog.
+//
+// Usage: sem_project_focp_stress [test...] [--seconds S] [--readers N]
+//                                [--books N] [--members N] [--write-behind MS]
+//                                [--desks N] [--hot N]
+//
+// Tests:
+//   snapshots   one writer thread checks books in and out, adds and deletes
+//               them while reader threads repeatedly take snapshots and
+//               verify that each is internally consistent and never changes
+//               after it was taken. At the end the database must hold
+//               exactly the final catalog (with --write-behind, once flushed),
+//               and the loan history must account for every loan.
+//   checkouts   desk threads, one member each, check books out and in at the
+//               same time, mostly fighting over a few hot books. A desk must
+//               always be able to return what it was issued: if a copy went
+//               out twice, the first holder's return fails. At the end each
+//               member must hold exactly what their desk was issued.
+//
+// Runs against an in-memory SQLite database. Prints one line per test and
+// exits non-zero if any invariant was violated.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "database.h"
+#include "library.h"
+
+namespace {
+
+struct Options {
+    double seconds = 3.0;
+    int readers = 4;
+    int books = 5000;
+    int members = 500;
+    int writeBehindMs = -1;     // off
+    int desks = 8;
+    int hot = 16;               // books most checkouts compete for
+};
+
+// Order-sensitive digest of everything a reader could observe
+uint64_t fingerprint(const Catalog& c)
+{
+    uint64_t h = 1469598103934665603ull;
+    auto mix = [&h](uint64_t v) { h = (h ^ v) * 1099511628211ull; };
+    for (const auto& b : c.books) {
+        mix(static_cast<uint64_t>(b.getID()));
+        mix(b.getBorrowStatus() ? 1u : 0u);
+        mix(static_cast<uint64_t>(b.getIssuedTo()));
+    }
+    for (const auto& m : c.members) {
+        mix(static_cast<uint64_t>(m.getID()));
+        mix(static_cast<uint64_t>(m.getBorrowedBookID()));
+        for (int bookID : m.getLoans())
+            mix(static_cast<uint64_t>(bookID));
+    }
+    mix(static_cast<uint64_t>(c.version));
+    return h;
+}
+
+// Returns a description of the first broken invariant, or "" if none.
+// Every write moves a book and its borrower's loan list together, so a
+// snapshot must never show one side of a checkout without the other.
+std::string checkSnapshot(const Catalog& c)
+{
+    size_t seen = 0, borrowed = 0;
+    int lastId = 0;
+    for (const auto& b : c.books) {
+        if (seen++ && b.getID() <= lastId)
+            return "books out of ID order at " + std::to_string(b.getID());
+        lastId = b.getID();
+
+        if (c.findBook(b.getID()) != &b)
+            return "findBook disagrees with iteration for " + std::to_string(b.getID());
+
+        if (b.getBorrowStatus()) {
+            ++borrowed;
+            const member* m = c.findMember(b.getIssuedTo());
+            if (!m || std::find(m->getLoans().begin(), m->getLoans().end(), b.getID()) == m->getLoans().end())
+                return "book " + std::to_string(b.getID()) + " issued without a matching member";
+        }
+    }
+    // The column store must describe exactly the rows it sits beside
+    std::string columns;
+    c.books.forEachChunk([&](const std::vector<book>& rows, const BookColumns& cols) {
+        if (!columns.empty()) return;
+        if (cols.genre.size() != rows.size())
+            columns = "column store is stale";
+        for (size_t i = 0; columns.empty() && i < rows.size(); ++i) {
+            if (cols.genre[i] != static_cast<uint8_t>(rows[i].getGenre()) ||
+                cols.issuedTo[i] != rows[i].getIssuedTo() ||
+                cols.isAvailable(i) == rows[i].getBorrowStatus())
+                columns = "columns disagree with book " + std::to_string(rows[i].getID());
+        }
+    });
+    if (!columns.empty())
+        return columns;
+
+    if (seen != c.books.size())
+        return "size() says " + std::to_string(c.books.size()) + ", iterated " + std::to_string(seen);
+
+    size_t loans = 0;
+    for (const auto& m : c.members) {
+        const auto& held = m.getLoans();
+        if (m.getBorrowedBookID() != (held.empty() ? 0 : held.back()))
+            return "member " + std::to_string(m.getID()) + " has a stale most-recent loan";
+        for (int bookID : held) {
+            const book* b = c.findBook(bookID);
+            if (!b || !b->getBorrowStatus() || b->getIssuedTo() != m.getID())
+                return "member " + std::to_string(m.getID()) + " holds a book that is not issued to them";
+        }
+        loans += held.size();
+    }
+    if (loans != borrowed)
+        return std::to_string(borrowed) + " books out but members hold " + std::to_string(loans);
+    if (static_cast<size_t>(c.countAvailableBooks()) != c.books.size() - borrowed)
+        return "countAvailableBooks disagrees with the rows";
+    return "";
+}
+
+// Compares what SQLite holds with the catalog; "" if they agree
+std::string checkPersisted(library& lib)
+{
+    lib.flushWrites();
+    auto snap = lib.snapshot();
+    std::vector<book> books;
+    std::vector<member> members;
+    std::vector<Loan> loans;
+    loadBooks(lib.getDb(), books);
+    loadMembers(lib.getDb(), members);
+    loadLoans(lib.getDb(), loans);
+
+    if (books.size() != snap->books.size() || members.size() != snap->members.size())
+        return "database holds " + std::to_string(books.size()) + " books and " + std::to_string(members.size()) +
+               " members, the catalog " + std::to_string(snap->books.size()) + " and " + std::to_string(snap->members.size());
+    for (const auto& b : books) {
+        const book* mem = snap->findBook(b.getID());
+        if (!mem || mem->getBorrowStatus() != b.getBorrowStatus() || mem->getIssuedTo() != b.getIssuedTo())
+            return "book " + std::to_string(b.getID()) + " differs from the database";
+    }
+    for (const auto& m : members) {
+        const member* mem = snap->findMember(m.getID());
+        if (!mem || mem->getBorrowedBookID() != m.getBorrowedBookID())
+            return "member " + std::to_string(m.getID()) + " differs from the database";
+    }
+    size_t held = 0;
+    for (const auto& m : snap->members)
+        held += m.getLoans().size();
+    if (held != loans.size())
+        return std::to_string(loans.size()) + " loans in the database, " + std::to_string(held) + " in the catalog";
+    for (const auto& loan : loans) {
+        const book* b = snap->findBook(loan.bookID);
+        if (!b || b->getIssuedTo() != loan.memberID)
+            return "loan of book " + std::to_string(loan.bookID) + " differs from the catalog";
+    }
+    return "";
+}
+
+// Replays each member's loan history: the books whose last event there is
+// a checkout must be exactly the ones they hold. "" if so.
+std::string checkHistory(const library& lib)
+{
+    auto snap = lib.snapshot();
+    const LoanLog& history = lib.getLoanLog();
+    int checkouts = 0;
+    for (const auto& m : snap->members) {
+        std::unordered_map<int, bool> out;
+        for (const auto& e : history.memberHistory(m.getID(), 0, UINT32_MAX)) {
+            out[e.bookID] = (e.action == LoanAction::checkout);
+            checkouts += (e.action == LoanAction::checkout);
+        }
+        size_t held = 0;
+        for (const auto& entry : out) {
+            if (!entry.second) continue;
+            ++held;
+            if (std::find(m.getLoans().begin(), m.getLoans().end(), entry.first) == m.getLoans().end())
+                return "history says member " + std::to_string(m.getID()) + " still has book " + std::to_string(entry.first);
+        }
+        if (held != m.getLoans().size())
+            return "member " + std::to_string(m.getID()) + " holds books their history never lent them";
+    }
+    int perDay = 0;
+    for (const auto& d : history.perDay(0, UINT32_MAX))
+        perDay += d.checkouts;
+    if (perDay != checkouts)
+        return "loansPerDay counts " + std::to_string(perDay) + " checkouts, member histories " + std::to_string(checkouts);
+    return "";
+}
+
+// Optional write-behind, then opt.books books and `members` members (IDs from 1)
+void populate(library& lib, const Options& opt, int members)
+{
+    if (opt.writeBehindMs >= 0) {
+        WriteBehindOptions wb;
+        wb.maxLag = std::chrono::milliseconds(opt.writeBehindMs);
+        lib.enableWriteBehind(wb);
+    }
+    for (int i = 0; i < opt.books; ++i)
+        lib.addBook("Title " + std::to_string(i), std::to_string(9780000000000LL + i),
+                    "Author " + std::to_string(i % 97), Genre::fiction);
+    for (int i = 0; i < members; ++i)
+        lib.addMember("Member " + std::to_string(i), std::to_string(i) + " Snapshot Lane");
+}
+
+// Random desk traffic; only the writer thread mutates the library
+void writerLoop(library& lib, const std::atomic<bool>& stop, std::atomic<long>& writes)
+{
+    std::mt19937 rng(12345);
+    while (!stop.load(std::memory_order_relaxed))
+    {
+        auto snap = lib.snapshot();
+        std::vector<const member*> everyone, holding;
+        for (const auto& m : snap->members) {
+            everyone.push_back(&m);
+            if (!m.getLoans().empty()) holding.push_back(&m);
+        }
+        std::vector<const book*> available;
+        for (const auto& b : snap->books)
+            if (!b.getBorrowStatus()) available.push_back(&b);
+
+        int action = static_cast<int>(rng() % 100);
+        if (action < 45 && !everyone.empty() && !available.empty()) {
+            const member* m = everyone[rng() % everyone.size()];   // members may hold several books
+            const book* b = available[rng() % available.size()];
+            lib.checkOutBook(b->getID(), m->getID());
+        } else if (action < 90 && !holding.empty()) {
+            const member* m = holding[rng() % holding.size()];
+            lib.returnBook(m->getLoans()[rng() % m->getLoans().size()], m->getID());
+        } else if (action < 95) {
+            lib.addBook("Stress Title " + std::to_string(rng() % 100000), "979", "Stress Author", Genre::fiction);
+        } else if (!available.empty()) {
+            lib.deleteBook(available[rng() % available.size()]->getID());
+        }
+        writes.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+int testSnapshots(const Options& opt)
+{
+    library lib(":memory:");
+    populate(lib, opt, opt.members);
+
+    std::atomic<bool> stop{false};
+    std::atomic<long> writes{0};
+    std::atomic<long> checked{0};
+    std::atomic<long> failures{0};
+
+    auto reader = [&]() {
+        int lastVersion = -1;
+        std::shared_ptr<const Catalog> held;    // re-verified later: must not have changed
+        uint64_t heldPrint = 0;
+
+        while (!stop.load(std::memory_order_relaxed))
+        {
+            auto snap = lib.snapshot();
+            std::string problem = checkSnapshot(*snap);
+            if (problem.empty() && snap->version < lastVersion)
+                problem = "version went backwards";
+            if (problem.empty() && held && fingerprint(*held) != heldPrint)
+                problem = "an older snapshot changed after it was taken";
+
+            if (!problem.empty()) {
+                if (failures.fetch_add(1) < 5)
+                    std::cerr << "snapshots: " << problem << " (version " << snap->version << ")" << std::endl;
+            }
+
+            lastVersion = snap->version;
+            if (checked.fetch_add(1) % 8 == 0) {
+                held = snap;
+                heldPrint = fingerprint(*held);
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < opt.readers; ++i)
+        threads.emplace_back(reader);
+    threads.emplace_back(writerLoop, std::ref(lib), std::cref(stop), std::ref(writes));
+
+    std::this_thread::sleep_for(std::chrono::duration<double>(opt.seconds));
+    stop = true;
+    for (auto& t : threads)
+        t.join();
+
+    std::string final = checkSnapshot(*lib.snapshot());
+    if (!final.empty()) {
+        std::cerr << "snapshots: final state: " << final << std::endl;
+        ++failures;
+    }
+    std::string persisted = checkPersisted(lib);
+    if (persisted.empty())
+        persisted = checkHistory(lib);
+    if (!persisted.empty()) {
+        std::cerr << "snapshots: " << persisted << std::endl;
+        ++failures;
+    }
+
+    std::cout << "snapshots: " << (failures ? "FAIL" : "OK")
+              << " writes=" << writes << " snapshots_checked=" << checked
+              << " readers=" << opt.readers << " violations=" << failures << std::endl;
+    return failures ? 1 : 0;
+}
+
+int testCheckouts(const Options& opt)
+{
+    library lib(":memory:");
+    populate(lib, opt, opt.desks);
+    int hot = std::max(1, std::min(opt.hot, opt.books));
+
+    std::atomic<bool> stop{false};
+    std::atomic<long> issued{0}, refused{0}, returned{0}, checked{0};
+    std::atomic<long> failures{0};
+    auto fail = [&failures](const std::string& problem) {
+        if (failures.fetch_add(1) < 5)
+            std::cerr << "checkouts: " << problem << std::endl;
+    };
+
+    // Desk d serves member d + 1 and remembers what it was issued
+    std::vector<std::vector<int>> held(static_cast<size_t>(opt.desks));
+    auto desk = [&](int d) {
+        std::mt19937 rng(1000 + static_cast<unsigned>(d));
+        int memberID = d + 1;
+        std::vector<int>& mine = held[static_cast<size_t>(d)];
+        while (!stop.load(std::memory_order_relaxed))
+        {
+            if (!mine.empty() && rng() % 2) {
+                size_t pick = rng() % mine.size();
+                int bookID = mine[pick];
+                if (!lib.returnBook(bookID, memberID))
+                    fail("member " + std::to_string(memberID) + " could not return book " + std::to_string(bookID) +
+                         " (issued twice?)");
+                else
+                    ++returned;
+                mine.erase(mine.begin() + static_cast<std::ptrdiff_t>(pick));
+                continue;
+            }
+            // Four in five tries go for a hot book
+            int bookID = 1 + static_cast<int>(rng() % static_cast<unsigned>(rng() % 5 ? hot : opt.books));
+            if (lib.checkOutBook(bookID, memberID)) {
+                if (std::find(mine.begin(), mine.end(), bookID) != mine.end())
+                    fail("book " + std::to_string(bookID) + " issued to member " + std::to_string(memberID) + " twice");
+                mine.push_back(bookID);
+                ++issued;
+            } else {
+                ++refused;
+            }
+        }
+    };
+    auto reader = [&]() {
+        while (!stop.load(std::memory_order_relaxed)) {
+            std::string problem = checkSnapshot(*lib.snapshot());
+            if (!problem.empty())
+                fail(problem);
+            ++checked;
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (int d = 0; d < opt.desks; ++d)
+        threads.emplace_back(desk, d);
+    threads.emplace_back(reader);
+    std::this_thread::sleep_for(std::chrono::duration<double>(opt.seconds));
+    stop = true;
+    for (auto& t : threads)
+        t.join();
+
+    // No book on two desks, and the catalog agrees with every desk
+    auto snap = lib.snapshot();
+    std::unordered_map<int, int> holderOf;
+    for (int d = 0; d < opt.desks; ++d) {
+        std::vector<int> mine = held[static_cast<size_t>(d)];
+        for (int bookID : mine)
+            if (!holderOf.emplace(bookID, d + 1).second)
+                fail("book " + std::to_string(bookID) + " is out to members " + std::to_string(holderOf[bookID]) +
+                     " and " + std::to_string(d + 1));
+        const member* m = snap->findMember(d + 1);
+        std::vector<int> loans = m ? m->getLoans() : std::vector<int>();
+        std::sort(mine.begin(), mine.end());
+        std::sort(loans.begin(), loans.end());
+        if (loans != mine)
+            fail("member " + std::to_string(d + 1) + " holds " + std::to_string(loans.size()) +
+                 " books, their desk was issued " + std::to_string(mine.size()));
+    }
+    std::string final = checkSnapshot(*snap);
+    if (final.empty())
+        final = checkPersisted(lib);
+    if (final.empty())
+        final = checkHistory(lib);
+    if (!final.empty())
+        fail("final state: " + final);
+
+    std::cout << "checkouts: " << (failures ? "FAIL" : "OK")
+              << " desks=" << opt.desks << " hot=" << hot << " issued=" << issued << " refused=" << refused
+              << " returned=" << returned << " snapshots_checked=" << checked
+              << " violations=" << failures << std::endl;
+    return failures ? 1 : 0;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    Options opt;
+    std::vector<std::string> tests;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--seconds" && i + 1 < argc) opt.seconds = std::stod(argv[++i]);
+        else if (arg == "--readers" && i + 1 < argc) opt.readers = std::stoi(argv[++i]);
+        else if (arg == "--books" && i + 1 < argc) opt.books = std::stoi(argv[++i]);
+        else if (arg == "--members" && i + 1 < argc) opt.members = std::stoi(argv[++i]);
+        else if (arg == "--write-behind" && i + 1 < argc) opt.writeBehindMs = std::stoi(argv[++i]);
+        else if (arg == "--desks" && i + 1 < argc) opt.desks = std::stoi(argv[++i]);
+        else if (arg == "--hot" && i + 1 < argc) opt.hot = std::stoi(argv[++i]);
+        else if (arg.rfind("--", 0) == 0) {
+            std::cerr << "Unknown argument: " << arg << std::endl;
+            return 2;
+        }
+        else tests.push_back(arg);
+    }
+    if (tests.empty())
+        tests = {"snapshots", "checkouts"};
+
+    int failed = 0;
+    for (const auto& name : tests) {
+        if (name == "snapshots") failed += testSnapshots(opt);
+        else if (name == "checkouts") failed += testCheckouts(opt);
+        else {
+            std::cerr << "Unknown test: " << name << std::endl;
+            return 2;
+        }
+    }
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,105 @@
+#include "stringpool.h"
+
+#include <cstring>
+
+std::string_view StringPool::copy(std::string_view s)
+{
+    char* dest;
+    if (s.size() > BLOCK_SIZE / 4) {
+        // Large strings get a block of their own rather than wasting the current one
+        large.emplace_back(new char[s.size()]);
+        reserved += s.size();
+        dest = large.back().get();
+    } else {
+        if (used + s.size() > BLOCK_SIZE) {
+            if (!blocks.empty())
+                wasted += BLOCK_SIZE - used;
+            blocks.emplace_back(new char[BLOCK_SIZE]);
+            used = 0;
+            reserved += BLOCK_SIZE;
+        }
+        dest = blocks.back().get() + used;
+        used += s.size();
+    }
+    std::memcpy(dest, s.data(), s.size());
+    ++stored;
+    return std::string_view(dest, s.size());
+}
+
+std::string_view StringPool::store(std::string_view s)
+{
+    if (s.empty())
+        return std::string_view("", 0);
+    std::lock_guard<std::mutex> lock(mutex);
+    return copy(s);
+}
+
+std::string_view StringPool::intern(std::string_view s)
+{
+    if (s.empty())
+        return std::string_view("", 0);
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = interned.find(s);
+    if (it != interned.end())
+        return *it;
+    std::string_view stored = copy(s);
+    interned.insert(stored);
+    return stored;
+}
+
+void StringPool::adopt(std::shared_ptr<const void> region, size_t bytes)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    adopted.push_back(std::move(region));
+    adoptedBytes += bytes;
+}
+
+std::string_view StringPool::internExisting(std::string_view s)
+{
+    if (s.empty())
+        return std::string_view("", 0);
+    std::lock_guard<std::mutex> lock(mutex);
+    return *interned.insert(s).first;
+}
+
+size_t StringPool::bytesReserved() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return reserved;
+}
+
+size_t StringPool::internedCount() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return interned.size();
+}
+
+void StringPool::memoryUsage(std::vector<MemoryItem>& out) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    MemoryItem text;
+    text.name = "stringPool.text";
+    text.count = stored;
+    text.reserved = reserved + (blocks.capacity() + large.capacity()) * sizeof(std::unique_ptr<char[]>);
+    text.used = reserved - wasted - (blocks.empty() ? 0 : BLOCK_SIZE - used);
+    out.push_back(text);
+
+    MemoryItem set;
+    set.name = "stringPool.interned";
+    set.count = interned.size();
+    set.used = interned.size() * sizeof(std::string_view);
+    set.reserved = hashTableBytes(interned);
+    out.push_back(set);
+
+    MemoryItem mapped;
+    mapped.name = "stringPool.mapped";
+    mapped.count = adopted.size();
+    mapped.used = mapped.reserved = adoptedBytes;
+    out.push_back(mapped);
+}
+
+StringPool& StringPool::global()
+{
+    static StringPool pool;
+    return pool;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+#include "memstats.h"
+
+// Append-only arena for catalog text (titles, authors, names, ...).
+//
+// Books and members hold std::string_views into the pool rather than their
+// own std::strings, so copying a record (e.g. when a catalog chunk is
+// copied on write) copies no text. Pool memory is never moved or freed
+// while the process runs, which keeps every view valid in every snapshot
+// that can still reach it; the text of edited or deleted records is only
+// reclaimed on restart.
+class StringPool
+{
+    private:
+
+    static const size_t BLOCK_SIZE = 64 * 1024;
+
+    mutable std::mutex mutex;
+    std::vector<std::unique_ptr<char[]>> blocks;   // BLOCK_SIZE each
+    std::vector<std::unique_ptr<char[]>> large;    // one oversized string each
+    size_t used = BLOCK_SIZE;       // bytes taken in blocks.back()
+    size_t reserved = 0;            // bytes in all blocks
+    size_t wasted = 0;              // block ends left unused
+    size_t stored = 0;              // strings copied in
+    std::unordered_set<std::string_view> interned;
+    std::vector<std::shared_ptr<const void>> adopted;  // e.g. mapped snapshot files
+    size_t adoptedBytes = 0;
+
+    // Copies s into the arena; caller holds the mutex
+    std::string_view copy(std::string_view s);
+
+    public:
+
+    // Copies s into the pool
+    std::string_view store(std::string_view s);
+    // Like store(), but equal strings share a single copy. For text that
+    // repeats across records, such as author names.
+    std::string_view intern(std::string_view s);
+
+    // Keeps `region` (text owned elsewhere, such as a mapped file, of
+    // `bytes` bytes) alive for as long as the pool, so views into it may be
+    // held by records
+    void adopt(std::shared_ptr<const void> region, size_t bytes);
+    // Registers s, which must lie in the pool or an adopted region, as the
+    // interned copy of its text; returns the existing copy if there is one
+    std::string_view internExisting(std::string_view s);
+
+    size_t bytesReserved() const;
+    size_t internedCount() const;
+    // The text, the interning set and the adopted regions (mapped file
+    // pages count towards the resident size only once touched)
+    void memoryUsage(std::vector<MemoryItem>& out) const;
+
+    // The pool used by book and member
+    static StringPool& global();
+};
+
+// Tag for the book and member constructors that take text already held by
+// StringPool::global() (or a region it adopted) instead of copying it
+struct PooledText {};
@@ -0,0 +1,167 @@
+#include "trace.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#ifdef _WIN32
+#include <process.h>
+#define LMS_GETPID _getpid
+#else
+#include <unistd.h>
+#define LMS_GETPID getpid
+#endif
+
+// Name given by nameThread(), kept even while tracing is off so threads
+// started before it is turned on are still named
+static thread_local const char* threadName = nullptr;
+
+Tracer& Tracer::global()
+{
+    static Tracer tracer;
+    return tracer;
+}
+
+void Tracer::start(size_t eventsPerThread)
+{
+    capacity.store(std::max<size_t>(1, eventsPerThread), std::memory_order_relaxed);
+    tracingOn.store(true, std::memory_order_relaxed);
+}
+
+void Tracer::stop()
+{
+    tracingOn.store(false, std::memory_order_relaxed);
+}
+
+void Tracer::nameThread(const char* name)
+{
+    threadName = name;
+}
+
+Tracer::ThreadBuffer& Tracer::buffer()
+{
+    // Shared with `threads`, which keeps it after the thread is gone
+    static thread_local std::shared_ptr<ThreadBuffer> mine;
+    if (!mine) {
+        auto created = std::make_shared<ThreadBuffer>();
+        created->events.resize(capacity.load(std::memory_order_relaxed));
+        std::lock_guard<std::mutex> lock(threadsMutex);
+        created->tid = static_cast<int>(threads.size()) + 1;
+        threads.push_back(created);
+        mine = std::move(created);
+    }
+    return *mine;
+}
+
+void Tracer::record(const char* category, const char* name,
+                    std::chrono::steady_clock::time_point begin,
+                    std::chrono::steady_clock::time_point end,
+                    std::string_view detail)
+{
+    ThreadBuffer& buf = buffer();
+    std::lock_guard<std::mutex> lock(buf.mutex);
+    buf.name = threadName;
+    Event& e = buf.events[buf.next++ % buf.events.size()];
+    e.category = category;
+    e.name = name;
+    e.begin = std::chrono::duration_cast<std::chrono::nanoseconds>(begin - epoch).count();
+    e.duration = std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count();
+    size_t n = std::min(detail.size(), DETAIL_SIZE - 1);
+    std::memcpy(e.detail, detail.data(), n);
+    e.detail[n] = '\0';
+}
+
+// Appends s as a JSON string
+static void appendString(std::string& out, const char* s)
+{
+    out += '"';
+    for (; *s; ++s) {
+        unsigned char c = static_cast<unsigned char>(*s);
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += static_cast<char>(c);
+        } else if (c < 0x20) {
+            char escaped[8];
+            std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            out += escaped;
+        } else {
+            out += static_cast<char>(c);
+        }
+    }
+    out += '"';
+}
+
+// ns as the format's microseconds
+static void appendMicros(std::string& out, int64_t nanos)
+{
+    char text[32];
+    std::snprintf(text, sizeof(text), "%lld.%03lld",
+                  static_cast<long long>(nanos / 1000), static_cast<long long>(nanos % 1000));
+    out += text;
+}
+
+long Tracer::write(const std::string& path) const
+{
+    std::vector<std::shared_ptr<ThreadBuffer>> all;
+    {
+        std::lock_guard<std::mutex> lock(threadsMutex);
+        all = threads;
+    }
+
+    const std::string pid = std::to_string(LMS_GETPID());
+    std::string out = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    long written = 0;
+    bool first = true;
+    std::vector<Event> events;
+    for (const auto& buf : all) {
+        const char* name;
+        {
+            // Copy out, so the thread waits on us only this long
+            std::lock_guard<std::mutex> lock(buf->mutex);
+            size_t size = buf->events.size();
+            size_t count = std::min(buf->next, size);
+            events.clear();
+            for (size_t i = buf->next - count; i < buf->next; ++i)
+                events.push_back(buf->events[i % size]);
+            name = buf->name;
+        }
+        const std::string tid = std::to_string(buf->tid);
+
+        // Metadata event naming the thread's track
+        if (!first)
+            out += ',';
+        first = false;
+        out += "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" + pid + ",\"tid\":" + tid + ",\"args\":{\"name\":";
+        appendString(out, name ? name : ("thread " + tid).c_str());
+        out += "}}";
+
+        for (const Event& e : events) {
+            out += ",{\"name\":";
+            appendString(out, e.name);
+            out += ",\"cat\":";
+            appendString(out, e.category);
+            out += ",\"ph\":\"X\",\"ts\":";
+            appendMicros(out, e.begin);
+            out += ",\"dur\":";
+            appendMicros(out, e.duration);
+            out += ",\"pid\":" + pid + ",\"tid\":" + tid;
+            if (e.detail[0]) {
+                out += ",\"args\":{\"detail\":";
+                appendString(out, e.detail);
+                out += '}';
+            }
+            out += '}';
+            ++written;
+        }
+    }
+    out += "]}\n";
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file || !file.write(out.data(), static_cast<std::streamsize>(out.size()))) {
+        std::cerr << "Cannot write trace to " << path << std::endl;
+        return -1;
+    }
+    return written;
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Request tracing in Chrome's trace event format (load the file in
+// https://ui.perfetto.dev or chrome://tracing).
+//
+// Code marks the steps worth seeing with a TraceSpan: parsing a request,
+// running it, each library mutation, each database helper and each SQL
+// statement. While tracing is off a span costs one relaxed atomic load.
+// While it is on, each finished span goes into a ring buffer of the thread
+// that ran it, so only the latest events per thread are kept; write()
+// turns every thread's buffer into one file.
+//
+// Span names and categories must be string literals (they are stored as
+// pointers); the optional detail, such as the method name, is copied.
+
+// Set by Tracer::start(); read by every span
+inline std::atomic<bool> tracingOn{false};
+
+class Tracer
+{
+    public:
+
+    // Events each thread keeps once tracing is on
+    static const size_t DEFAULT_EVENTS_PER_THREAD = 8192;
+    // Bytes of a span's detail that are kept (enough for most SQL)
+    static const size_t DETAIL_SIZE = 88;
+
+    static Tracer& global();
+
+    // Starts recording; each thread's buffer is allocated when it first
+    // records, so the size applies to threads that haven't yet
+    void start(size_t eventsPerThread = DEFAULT_EVENTS_PER_THREAD);
+    void stop();
+
+    // One finished span, timed by the caller
+    void record(const char* category, const char* name,
+                std::chrono::steady_clock::time_point begin,
+                std::chrono::steady_clock::time_point end,
+                std::string_view detail = {});
+
+    // Writes every thread's events, oldest first, as a JSON trace; returns
+    // the number written, or -1 if the file can't be written
+    long write(const std::string& path) const;
+
+    // Names the calling thread in traces (a string literal)
+    static void nameThread(const char* name);
+
+    private:
+
+    struct Event {
+        const char* category;
+        const char* name;
+        int64_t begin;      // ns since the tracer's epoch
+        int64_t duration;
+        char detail[DETAIL_SIZE];
+    };
+
+    // One thread's events. The owner appends under its own mutex, which is
+    // contended only while write() copies the buffer out.
+    struct ThreadBuffer {
+        std::mutex mutex;
+        int tid = 0;
+        const char* name = nullptr;
+        std::vector<Event> events;  // ring
+        size_t next = 0;            // total appended; next % size is the slot
+    };
+
+    const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+    std::atomic<size_t> capacity{DEFAULT_EVENTS_PER_THREAD};
+    mutable std::mutex threadsMutex;
+    // Kept after their threads exit, so their events still get written
+    std::vector<std::shared_ptr<ThreadBuffer>> threads;
+
+    ThreadBuffer& buffer();
+};
+
+// Times its own scope as one span
+class TraceSpan
+{
+    public:
+
+    TraceSpan(const char* category, const char* name, std::string_view detail = {})
+        : on(tracingOn.load(std::memory_order_relaxed)), category(category), name(name), detail(detail)
+    {
+        if (on)
+            begin = std::chrono::steady_clock::now();
+    }
+
+    ~TraceSpan()
+    {
+        if (on)
+            Tracer::global().record(category, name, begin, std::chrono::steady_clock::now(), detail);
+    }
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+    private:
+
+    bool on;
+    const char* category;
+    const char* name;
+    std::string_view detail;    // must outlive the span
+    std::chrono::steady_clock::time_point begin;
+};
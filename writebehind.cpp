@@ -0,0 +1,131 @@
+#include "writebehind.h"
+
+#include <algorithm>
+#include <iostream>
+#include <iterator>
+#include <unordered_map>
+
+#include "database.h"
+#include "trace.h"
+
+WriteBehindQueue::WriteBehindQueue(sqlite3* connection, bool owns, WriteBehindOptions opt)
+    : db(connection), ownsConnection(owns), options(opt)
+{
+    if (options.maxQueued == 0)
+        options.maxQueued = 1;
+    options.maxBatch = std::max<size_t>(1, std::min(options.maxBatch, options.maxQueued));
+    writer = std::thread(&WriteBehindQueue::writerLoop, this);
+}
+
+WriteBehindQueue::~WriteBehindQueue()
+{
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        stopping = true;
+    }
+    workReady.notify_all();
+    writer.join();
+    if (ownsConnection)
+        closeDatabase(db);
+}
+
+void WriteBehindQueue::push(PersistOp op)
+{
+    {
+        std::unique_lock<std::mutex> lock(queueMutex);
+        if (queue.size() >= options.maxQueued) {
+            ++counters.throttled;
+            flushTarget = counters.pushed;  // no point batching further
+            workReady.notify_all();
+            progress.wait(lock, [this] { return queue.size() < options.maxQueued; });
+        }
+        queue.push_back(std::move(op));
+        ++counters.pushed;
+    }
+    workReady.notify_all();
+}
+
+void WriteBehindQueue::flush()
+{
+    std::unique_lock<std::mutex> lock(queueMutex);
+    uint64_t target = counters.pushed;
+    if (counters.committed >= target)
+        return;
+    flushTarget = std::max(flushTarget, target);
+    workReady.notify_all();
+    progress.wait(lock, [this, target] { return counters.committed >= target; });
+}
+
+WriteBehindQueue::Stats WriteBehindQueue::stats() const
+{
+    std::lock_guard<std::mutex> lock(queueMutex);
+    Stats s = counters;
+    s.queued = queue.size();
+    return s;
+}
+
+void WriteBehindQueue::writerLoop()
+{
+    Tracer::nameThread("write-behind");
+    std::unique_lock<std::mutex> lock(queueMutex);
+    for (;;)
+    {
+        workReady.wait(lock, [this] { return stopping || !queue.empty(); });
+        if (queue.empty())
+            return;     // stopping, and everything is committed
+
+        // Give the first mutation up to maxLag to collect company, unless
+        // someone is waiting on it or the batch is already full
+        auto deadline = std::chrono::steady_clock::now() + options.maxLag;
+        workReady.wait_until(lock, deadline, [this] {
+            return stopping || queue.size() >= options.maxBatch ||
+                   flushTarget > counters.committed;
+        });
+
+        std::vector<PersistOp> batch;
+        if (queue.size() <= options.maxBatch) {
+            batch.swap(queue);
+        } else {
+            auto cut = queue.begin() + static_cast<std::ptrdiff_t>(options.maxBatch);
+            batch.assign(std::make_move_iterator(queue.begin()), std::make_move_iterator(cut));
+            queue.erase(queue.begin(), cut);
+        }
+
+        lock.unlock();
+        progress.notify_all();      // room in the queue again
+        commit(batch);
+        lock.lock();
+
+        counters.committed += batch.size();
+        ++counters.batches;
+        progress.notify_all();
+    }
+}
+
+// One transaction for the whole batch; a keyed step runs only if no later
+// step in the batch overwrites the same row
+void WriteBehindQueue::commit(std::vector<PersistOp>& batch)
+{
+    std::unordered_map<uint64_t, const PersistStep*> last;
+    for (const auto& op : batch)
+        for (const auto& step : op)
+            if (step.key)
+                last[step.key] = &step;
+
+    TraceSpan span("writebehind", "commitBatch");
+    uint64_t skipped = 0;
+    beginTransaction(db);
+    for (const auto& op : batch) {
+        for (const auto& step : op) {
+            if (step.key && last[step.key] != &step) {
+                ++skipped;
+                continue;
+            }
+            step.run(db);
+        }
+    }
+    commitTransaction(db);
+
+    std::lock_guard<std::mutex> lock(queueMutex);
+    counters.coalesced += skipped;
+}
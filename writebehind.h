@@ -0,0 +1,93 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "external/sqlite/sqlite3.h"
+
+// One statement of a persisted mutation. Steps with the same nonzero key
+// set the same row to an absolute value, so when several meet in one
+// batch only the last of them runs.
+struct PersistStep {
+    uint64_t key;
+    std::function<void(sqlite3*)> run;
+};
+
+// Everything one mutation writes; always committed in a single transaction
+using PersistOp = std::vector<PersistStep>;
+
+// Keys for PersistStep: which row a step overwrites
+inline uint64_t bookStatusKey(int bookID) { return (uint64_t(1) << 32) | uint32_t(bookID); }
+inline uint64_t memberBorrowKey(int memberID) { return (uint64_t(2) << 32) | uint32_t(memberID); }
+
+struct WriteBehindOptions {
+    // Longest a queued mutation waits for more to batch with it
+    std::chrono::milliseconds maxLag{20};
+    // Mutations per transaction
+    size_t maxBatch = 1024;
+    // Queue length at which push() blocks until the writer catches up
+    size_t maxQueued = 8192;
+};
+
+// Persists mutations on a background thread (write-behind).
+//
+// The caller has already applied a mutation in memory; push() only queues
+// the statements that persist it and returns. The writer thread commits
+// queued mutations in order, many per transaction, and a mutation is
+// never split between transactions, so the database always holds a
+// prefix of the mutations pushed. A crash loses at most what was queued.
+class WriteBehindQueue
+{
+    public:
+
+    struct Stats {
+        uint64_t pushed = 0;
+        uint64_t committed = 0;
+        uint64_t batches = 0;
+        uint64_t coalesced = 0;     // steps skipped for a later write of the same row
+        uint64_t throttled = 0;     // pushes that waited on a full queue
+        size_t queued = 0;
+    };
+
+    private:
+
+    sqlite3* db;
+    bool ownsConnection;
+    WriteBehindOptions options;
+
+    mutable std::mutex queueMutex;
+    std::condition_variable workReady;  // new mutation, flush request or shutdown
+    std::condition_variable progress;   // a batch committed
+
+    std::vector<PersistOp> queue;
+    uint64_t flushTarget = 0;           // commit without waiting up to here
+    bool stopping = false;
+    Stats counters;
+
+    std::thread writer;
+
+    void writerLoop();
+    void commit(std::vector<PersistOp>& batch);
+
+    public:
+
+    // Commits through `connection`, closing it at the end if `owns`
+    WriteBehindQueue(sqlite3* connection, bool owns, WriteBehindOptions opt);
+    // Commits everything still queued
+    ~WriteBehindQueue();
+
+    WriteBehindQueue(const WriteBehindQueue&) = delete;
+    WriteBehindQueue& operator=(const WriteBehindQueue&) = delete;
+
+    void push(PersistOp op);
+
+    // Blocks until everything pushed so far is committed
+    void flush();
+
+    Stats stats() const;
+};